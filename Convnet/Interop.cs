@@ -3387,8 +3387,16 @@ namespace Interop
         [DllImport(library, BestFitMapping = true, CallingConvention = CC, CharSet = charSet, ExactSpelling = true)]
         private static extern void DNNDisableLocking(bool disable);
         [DllImport(library, BestFitMapping = true, CallingConvention = CC, CharSet = charSet, ExactSpelling = true)]
+        private static extern void DNNSetAugmentationSeed(UInt seed);
+        [DllImport(library, BestFitMapping = true, CallingConvention = CC, CharSet = charSet, ExactSpelling = true)]
         private static extern bool DNNSetShuffleCount(UInt count);
         [DllImport(library, BestFitMapping = true, CallingConvention = CC, CharSet = charSet, ExactSpelling = true)]
+        private static extern bool DNNSetInputWorkers(UInt threads, UInt firstCore);
+        [DllImport(library, BestFitMapping = true, CallingConvention = CC, CharSet = charSet, ExactSpelling = true)]
+        private static extern bool DNNSetInputQueueDepth(UInt depth);
+        [DllImport(library, BestFitMapping = true, CallingConvention = CC, CharSet = charSet, ExactSpelling = true)]
+        private static extern bool DNNSetDecodedCacheSize(UInt size);
+        [DllImport(library, BestFitMapping = true, CallingConvention = CC, CharSet = charSet, ExactSpelling = true)]
         private static extern bool DNNBatchNormUsed();
         [DllImport(library, BestFitMapping = true, CallingConvention = CC, CharSet = charSet, ExactSpelling = true)]
         private static extern bool DNNStochasticEnabled();
@@ -3401,6 +3409,18 @@ namespace Interop
         [DllImport(library, BestFitMapping = true, CallingConvention = CC, CharSet = charSet, ExactSpelling = true)]
         private static extern bool DNNSetFormat(bool plain);
         [DllImport(library, BestFitMapping = true, CallingConvention = CC, CharSet = charSet, ExactSpelling = true)]
+        private static extern bool DNNSetInference(bool inference);
+        [DllImport(library, BestFitMapping = true, CallingConvention = CC, CharSet = charSet, ExactSpelling = true)]
+        private static extern bool DNNSetConcurrentBranches(bool concurrent);
+        [DllImport(library, BestFitMapping = true, CallingConvention = CC, CharSet = charSet, ExactSpelling = true)]
+        private static extern bool DNNSetOverlapUpdates(bool overlap);
+        [DllImport(library, BestFitMapping = true, CallingConvention = CC, CharSet = charSet, ExactSpelling = true)]
+        private static extern bool DNNSetFlatParameters(bool flat);
+        [DllImport(library, BestFitMapping = true, CallingConvention = CC, CharSet = charSet, ExactSpelling = true)]
+        private static extern bool DNNSetGradientClipping(Float maxNorm);
+        [DllImport(library, BestFitMapping = true, CallingConvention = CC, CharSet = charSet, ExactSpelling = true)]
+        private static extern bool DNNSetTestBatchSize(UInt batchSize);
+        [DllImport(library, BestFitMapping = true, CallingConvention = CC, CharSet = charSet, ExactSpelling = true)]
         private static extern void DNNSetOptimizer(Optimizers optimizer);
         [DllImport(library, BestFitMapping = true, CallingConvention = CC, CharSet = charSet, ExactSpelling = true)]
         private static extern void DNNResetOptimizer();
@@ -3455,6 +3475,8 @@ namespace Interop
         [DllImport(library, BestFitMapping = true, CallingConvention = CC, CharSet = charSet, ExactSpelling = true)]
         private static extern int DNNSaveWeights([MarshalAs(stringType)] string fileName, bool persistOptimizer);
         [DllImport(library, BestFitMapping = true, CallingConvention = CC, CharSet = charSet, ExactSpelling = true)]
+        private static extern bool DNNFoldBatchNorm([MarshalAs(stringType)] string definitionFile, [MarshalAs(stringType)] string weightsFile, [In, Out] ref CheckMsg checkMsg);
+        [DllImport(library, BestFitMapping = true, CallingConvention = CC, CharSet = charSet, ExactSpelling = true)]
         private static extern int DNNLoadLayerWeights([MarshalAs(stringType)] string fileName, UInt layerIndex, bool persistOptimizer);
         [DllImport(library, BestFitMapping = true, CallingConvention = CC, CharSet = charSet, ExactSpelling = true)]
         private static extern int DNNSaveLayerWeights([MarshalAs(stringType)] string fileName, UInt layerIndex, bool persistOptimizer);
@@ -3563,6 +3585,12 @@ namespace Interop
 		public bool PersistOptimizer;
         public bool DisableLocking;
         public bool PlainFormat;
+        public bool Inference;
+        public bool ConcurrentBranches;
+        public bool OverlapUpdates;
+        public bool FlatParameters;
+        public Float MaxGradientNorm;
+        public UInt TestBatchSize;
         private bool disposedValue = false;
 
         public void OnElapsed(object? sender, System.Timers.ElapsedEventArgs e)
@@ -3951,6 +3979,11 @@ namespace Interop
             DisableLocking = disable;
         }
 
+        public void SetAugmentationSeed(UInt seed)
+        {
+            DNNSetAugmentationSeed(seed);
+        }
+
         public void GetConfusionMatrix()
         {
             if (CostLayers != null)
@@ -3966,6 +3999,21 @@ namespace Interop
             return DNNSetShuffleCount(count);
         }
 
+        public bool SetInputWorkers(UInt threads, UInt firstCore)
+        {
+            return DNNSetInputWorkers(threads, firstCore);
+        }
+
+        public bool SetInputQueueDepth(UInt depth)
+        {
+            return DNNSetInputQueueDepth(depth);
+        }
+
+        public bool SetDecodedCacheSize(UInt size)
+        {
+            return DNNSetDecodedCacheSize(size);
+        }
+
         public bool BatchNormUsed()
         {
             return DNNBatchNormUsed();
@@ -4264,6 +4312,66 @@ namespace Interop
             return ret;
         }
 
+        public bool SetInference(bool inference)
+        {
+            var ret = DNNSetInference(inference);
+
+            if (ret)
+                Inference = inference;
+
+            return ret;
+        }
+
+        public bool SetConcurrentBranches(bool concurrent)
+        {
+            var ret = DNNSetConcurrentBranches(concurrent);
+
+            if (ret)
+                ConcurrentBranches = concurrent;
+
+            return ret;
+        }
+
+        public bool SetOverlapUpdates(bool overlap)
+        {
+            var ret = DNNSetOverlapUpdates(overlap);
+
+            if (ret)
+                OverlapUpdates = overlap;
+
+            return ret;
+        }
+
+        public bool SetFlatParameters(bool flat)
+        {
+            var ret = DNNSetFlatParameters(flat);
+
+            if (ret)
+                FlatParameters = flat;
+
+            return ret;
+        }
+
+        public bool SetGradientClipping(Float maxNorm)
+        {
+            var ret = DNNSetGradientClipping(maxNorm);
+
+            if (ret)
+                MaxGradientNorm = maxNorm;
+
+            return ret;
+        }
+
+        public bool SetTestBatchSize(UInt batchSize)
+        {
+            var ret = DNNSetTestBatchSize(batchSize);
+
+            if (ret)
+                TestBatchSize = batchSize;
+
+            return ret;
+        }
+
         public void SetOptimizer(DNNOptimizers strategy)
         {
             if (strategy != Optimizer)
@@ -4502,6 +4610,16 @@ namespace Interop
             return DNNSaveWeights(fileName, persist);
         }
 
+        public bool FoldBatchNorm(string definitionFile, string weightsFile)
+        {
+            var checkMsg = new CheckMsg();
+
+            if (!DNNFoldBatchNorm(definitionFile, weightsFile, ref checkMsg))
+                throw new Exception(checkMsg.Message);
+
+            return true;
+        }
+
         public void ResetWeights()
         {
             DNNResetWeights();
@@ -242,14 +242,13 @@ namespace dnn
 	class Activation final : public Layer
 	{
 	private:
-		std::unique_ptr<dnnl::eltwise_forward::primitive_desc> fwdDesc;
-		std::unique_ptr<dnnl::eltwise_backward::primitive_desc> bwdDesc;
-		std::unique_ptr<dnnl::binary::primitive_desc> bwdAddDesc;
-#ifdef DNN_CACHE_PRIMITIVES
-		std::unique_ptr<dnnl::eltwise_forward> fwd;
-		std::unique_ptr<dnnl::eltwise_backward> bwd;
-		std::unique_ptr<dnnl::binary> bwdAdd;
-#endif
+		std::shared_ptr<dnnl::eltwise_forward::primitive_desc> fwdDesc;
+		std::shared_ptr<dnnl::eltwise_backward::primitive_desc> bwdDesc;
+		std::shared_ptr<dnnl::binary::primitive_desc> bwdAddDesc;
+		std::shared_ptr<dnnl::eltwise_forward> fwd;
+		std::shared_ptr<dnnl::eltwise_backward> bwd;
+		std::shared_ptr<dnnl::binary> bwdAdd;
+		PrimitiveCache<std::tuple<decltype(fwdDesc), decltype(bwdDesc), decltype(bwdAddDesc), decltype(fwd), decltype(bwd), decltype(bwdAdd)>> primitives;
 		dnnl::algorithm algorithm;
 		bool reorderFwdSrc;
 		bool reorderBwdSrc;
@@ -679,10 +678,8 @@ namespace dnn
 
 							auto fwdDesc = std::make_unique<dnnl::eltwise_forward::primitive_desc>(dnnl::eltwise_forward::primitive_desc(eng, dnnl::prop_kind::forward, act.algorithm, *memDesc, *memDesc, (act.Enum == Activations::BoundedRelu) ? act.beta : act.alpha, (act.Enum == Activations::BoundedRelu) ? act.alpha : act.beta));
 							auto bwdDesc = std::make_unique<dnnl::eltwise_backward::primitive_desc>(dnnl::eltwise_backward::primitive_desc(eng, act.algorithm, *memDesc, *memDesc, *memDesc, (act.Enum == Activations::BoundedRelu) ? act.beta : act.alpha, (act.Enum == Activations::BoundedRelu) ? act.alpha : act.beta, *fwdDesc));
-#ifdef DNN_CACHE_PRIMITIVES
-							auto fwd = std::make_unique<dnnl::eltwise_forward>(dnnl::eltwise_forward(*fwdDesc));
-							auto bwd = std::make_unique<dnnl::eltwise_backward>(dnnl::eltwise_backward(*bwdDesc));
-#endif							
+							auto fwd = std::make_shared<dnnl::eltwise_forward>(dnnl::eltwise_forward(*fwdDesc));
+							auto bwd = std::make_shared<dnnl::eltwise_backward>(dnnl::eltwise_backward(*bwdDesc));
 							const auto size = UInt(N * C * H * W);
 							const auto part = (size / 2ull) + (size / 4ull);
 
@@ -759,20 +756,12 @@ namespace dnn
 
 								auto srcMem = dnnl::memory(*memDesc, eng, input.data());
 								auto dstMem = dnnl::memory(*memDesc, eng, outputFwdRef.data());
-#ifdef DNN_CACHE_PRIMITIVES
 								fwd->execute(stream, std::unordered_map<int, dnnl::memory>{ {DNNL_ARG_SRC, srcMem}, { DNNL_ARG_DST, dstMem } });
-#else
-								dnnl::eltwise_forward(*fwdDesc).execute(stream, std::unordered_map<int, dnnl::memory>{ {DNNL_ARG_SRC, srcMem}, { DNNL_ARG_DST, dstMem } });
-#endif
 								stream.wait();
 
 
 								auto diffSrcMem = dnnl::memory(*memDesc, eng, outputBwdRef.data());
-#ifdef DNN_CACHE_PRIMITIVES
 								bwd->execute(stream, std::unordered_map<int, dnnl::memory>{ {DNNL_ARG_SRC, srcMem}, { DNNL_ARG_DIFF_DST, diffSrcMem }, { DNNL_ARG_DIFF_SRC, diffSrcMem } });
-#else
-								dnnl::eltwise_backward(*bwdDesc).execute(stream, std::unordered_map<int, dnnl::memory>{ {DNNL_ARG_SRC, srcMem}, { DNNL_ARG_DIFF_DST, diffSrcMem }, { DNNL_ARG_DIFF_SRC, diffSrcMem } });
-#endif
 								stream.wait();
 
 								for (auto i = 0ull; i < size; i += VectorSize)
@@ -989,20 +978,38 @@ namespace dnn
 				DiffDstMemDesc = std::make_unique<dnnl::memory::desc>(dnnl::memory::desc(dnnl::memory::dims({ dnnl::memory::dim(batchSize), dnnl::memory::dim(C), dnnl::memory::dim(H), dnnl::memory::dim(W) }), dnnl::memory::data_type::f32, ChosenFormat));
 			}
 
-			fwdDesc = std::make_unique<dnnl::eltwise_forward::primitive_desc>(dnnl::eltwise_forward::primitive_desc(Device.engine, dnnl::prop_kind::forward, algorithm, *InputLayer->DstMemDesc, *DstMemDesc, alpha, beta));
-			bwdDesc = std::make_unique<dnnl::eltwise_backward::primitive_desc>(dnnl::eltwise_backward::primitive_desc(Device.engine, algorithm, *InputLayer->DiffDstMemDesc, *DiffDstMemDesc, *DstMemDesc, alpha, beta, *fwdDesc));
+			const auto key = PrimitiveKey{ batchSize, InputLayer->D, InputLayer->H, InputLayer->W, InputLayer->ChosenFormat, FwdPropKind() };
+			if (const auto cached = primitives.Get(key))
+				std::tie(fwdDesc, bwdDesc, bwdAddDesc, fwd, bwd, bwdAdd) = *cached;
+			else
+			{
+				fwdDesc = std::make_unique<dnnl::eltwise_forward::primitive_desc>(dnnl::eltwise_forward::primitive_desc(Device.engine, FwdPropKind(), algorithm, *InputLayer->DstMemDesc, *DstMemDesc, alpha, beta));
+				fwd = std::make_shared<dnnl::eltwise_forward>(dnnl::eltwise_forward(*fwdDesc));
 
-			bwdAddDesc = std::make_unique<dnnl::binary::primitive_desc>(dnnl::binary::primitive_desc(Device.engine, dnnl::algorithm::binary_add, *InputLayer->DiffDstMemDesc, *InputLayer->DiffDstMemDesc, *InputLayer->DiffDstMemDesc));
+				if (!Inference)
+				{
+					bwdDesc = std::make_unique<dnnl::eltwise_backward::primitive_desc>(dnnl::eltwise_backward::primitive_desc(Device.engine, algorithm, *InputLayer->DiffDstMemDesc, *DiffDstMemDesc, *DstMemDesc, alpha, beta, *fwdDesc));
+					bwdAddDesc = std::make_unique<dnnl::binary::primitive_desc>(dnnl::binary::primitive_desc(Device.engine, dnnl::algorithm::binary_add, *InputLayer->DiffDstMemDesc, *InputLayer->DiffDstMemDesc, *InputLayer->DiffDstMemDesc));
+					bwd = std::make_shared<dnnl::eltwise_backward>(dnnl::eltwise_backward(*bwdDesc));
+					bwdAdd = std::make_shared<dnnl::binary>(dnnl::binary(*bwdAddDesc));
+				}
+				else
+				{
+					bwdDesc.reset();
+					bwdAddDesc.reset();
+					bwd.reset();
+					bwdAdd.reset();
+				}
 
-			reorderFwdSrc = fwdDesc->src_desc() != *InputLayer->DstMemDesc;
-			reorderBwdSrc = bwdDesc->src_desc() != *InputLayer->DstMemDesc;
-			reorderBwdDiffSrc = bwdDesc->diff_src_desc() != *InputLayer->DiffDstMemDesc;
+				primitives.Put(key, std::make_shared<decltype(primitives)::value_type>(fwdDesc, bwdDesc, bwdAddDesc, fwd, bwd, bwdAdd), Inference ? PrimitiveBytes(*fwdDesc) : PrimitiveBytes(*fwdDesc, *bwdDesc, *bwdAddDesc));
+			}
 
-#ifdef DNN_CACHE_PRIMITIVES
-			fwd = std::make_unique<dnnl::eltwise_forward>(dnnl::eltwise_forward(*fwdDesc));
-			bwd = std::make_unique<dnnl::eltwise_backward>(dnnl::eltwise_backward(*bwdDesc));
-			bwdAdd = std::make_unique<dnnl::binary>(dnnl::binary(*bwdAddDesc));
-#endif
+			reorderFwdSrc = fwdDesc->src_desc() != *InputLayer->DstMemDesc;
+			if (!Inference)
+			{
+				reorderBwdSrc = bwdDesc->src_desc() != *InputLayer->DstMemDesc;
+				reorderBwdDiffSrc = bwdDesc->diff_src_desc() != *InputLayer->DiffDstMemDesc;
+			}
 		}
 
 		void ForwardProp(const UInt batchSize, const bool training) final override
@@ -1274,11 +1281,7 @@ namespace dnn
 				}
 
 				auto dstMem = dnnl::memory(fwdDesc->dst_desc(), Device.engine, Neurons.data());
-#ifdef DNN_CACHE_PRIMITIVES
 				fwd->execute(Device.stream, std::unordered_map<int, dnnl::memory>{ {DNNL_ARG_SRC, srcMem}, { DNNL_ARG_DST, dstMem } });
-#else
-				dnnl::eltwise_forward(*fwdDesc).execute(Device.stream, std::unordered_map<int, dnnl::memory>{ {DNNL_ARG_SRC, srcMem}, { DNNL_ARG_DST, dstMem } });
-#endif
 				Device.stream.wait();
 
 #ifndef DNN_LEAN
@@ -1501,11 +1504,7 @@ namespace dnn
 				//	Device.stream.wait();
 				//}
 
-#ifdef DNN_CACHE_PRIMITIVES
 				bwd->execute(Device.stream, std::unordered_map<int, dnnl::memory>{ {DNNL_ARG_SRC, srcMem}, { DNNL_ARG_DIFF_DST, InplaceBwd ? diffSrcMem : diffDstMem }, { DNNL_ARG_DIFF_SRC, diffSrcMem } });
-#else
-				dnnl::eltwise_backward(*bwdDesc).execute(Device.stream, std::unordered_map<int, dnnl::memory>{ {DNNL_ARG_SRC, srcMem}, { DNNL_ARG_DIFF_DST, InplaceBwd ? diffSrcMem : diffDstMem }, { DNNL_ARG_DIFF_SRC, diffSrcMem } });
-#endif
 				Device.stream.wait();
 
 				if (reorderBwdDiffSrc)
@@ -1516,11 +1515,7 @@ namespace dnn
 
 				if (SharesInput)
 				{
-#ifdef DNN_CACHE_PRIMITIVES
 					bwdAdd->execute(Device.stream, std::unordered_map<int, dnnl::memory>{ { DNNL_ARG_SRC_0, dnnl::memory(*InputLayerBwd->DiffDstMemDesc, Device.engine, InputLayerBwd->NeuronsD1.data()) }, { DNNL_ARG_SRC_1, memDiffSrc }, { DNNL_ARG_DST, dnnl::memory(*InputLayerBwd->DiffDstMemDesc, Device.engine, InputLayerBwd->NeuronsD1.data()) } });
-#else
-					dnnl::binary(*bwdAddDesc).execute(Device.stream, std::unordered_map<int, dnnl::memory>{ { DNNL_ARG_SRC_0, dnnl::memory(*InputLayerBwd->DiffDstMemDesc, Device.engine, InputLayerBwd->NeuronsD1.data()) }, { DNNL_ARG_SRC_1, memDiffSrc }, { DNNL_ARG_DST, dnnl::memory(*InputLayerBwd->DiffDstMemDesc, Device.engine, InputLayerBwd->NeuronsD1.data()) } });
-#endif
 					Device.stream.wait();
 				}
 			}
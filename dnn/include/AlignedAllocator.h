@@ -1,11 +1,21 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
 #include <cstdlib>
+#include <cstring>
 #include <new>       // Required for placement new
 #include <limits>    // For std::numeric_limits
 #include <stdexcept>
 #include <type_traits>
 #include <cstddef>
+#include <vector>
+#ifndef NDEBUG
+#include <mutex>
+#include <set>
+#endif
 
 #ifdef __MINGW32__
 #include <mm_malloc.h>
@@ -22,6 +32,165 @@
 
 namespace dnn
 {
+    // the address range of a live ParameterArena
+    struct ParameterArenaSlot
+    {
+        std::atomic<std::uintptr_t> Begin{ 0 };
+        std::atomic<std::uintptr_t> End{ 0 };
+    };
+
+    /**
+     * @brief One aligned block that holds many vectors back to back.
+     *
+     * While a ParameterScope for the arena is open on a thread, AlignedAllocator carves that thread's allocations
+     * out of the block, so the vectors stay ordinary std::vectors while their data is contiguous.
+     * Freeing memory that lives in an arena is a no-op, the block goes away with the arena,
+     * so every vector must have left the arena (or be gone) before the arena is destroyed.
+     */
+    class ParameterArena
+    {
+    public:
+        static constexpr std::size_t BlockAlignment = 64;
+
+        ParameterArena() = default;
+        ParameterArena(const ParameterArena&) = delete;
+        ParameterArena& operator=(const ParameterArena&) = delete;
+
+        ~ParameterArena()
+        {
+            Free();
+        }
+
+        static ParameterArena*& Current() noexcept
+        {
+            thread_local ParameterArena* arena = nullptr;
+            return arena;
+        }
+
+        // drops the old block and makes a zeroed one of (at least) size bytes
+        void Reserve(const std::size_t size)
+        {
+            Free();
+
+            if (size == 0)
+                return;
+
+            Capacity = RoundUp(size, BlockAlignment);
+            Data = static_cast<std::byte*>(::operator new(Capacity, std::align_val_t(BlockAlignment)));
+            std::memset(Data, 0, Capacity);
+
+            if (!Register())
+                Free();
+        }
+
+        // nullptr when the request doesn't fit, the caller falls back to the heap
+        DNN_INLINE void* Allocate(const std::size_t size, const std::size_t alignment) noexcept
+        {
+            const auto offset = RoundUp(Offset, std::max(alignment, BlockAlignment));
+
+            if (Data == nullptr || offset + size > Capacity)
+                return nullptr;
+
+            Offset = offset + size;
+
+            return Data + offset;
+        }
+
+        // the next allocation starts at offset (rounded up to the alignment)
+        DNN_INLINE void Seek(const std::size_t offset) noexcept
+        {
+            Offset = offset;
+        }
+
+        DNN_INLINE bool Contains(const void* ptr) const noexcept
+        {
+            const auto p = static_cast<const std::byte*>(ptr);
+            return p >= Data && p < Data + Capacity;
+        }
+
+        DNN_INLINE std::byte* data() const noexcept { return Data; }
+        DNN_INLINE std::size_t size() const noexcept { return Offset; }
+
+        static DNN_INLINE bool Owns(const void* ptr) noexcept
+        {
+            if (Registered.load(std::memory_order_acquire) == 0)
+                return false;
+
+            const auto p = reinterpret_cast<std::uintptr_t>(ptr);
+            for (auto& slot : Slots)
+            {
+                const auto end = slot.End.load(std::memory_order_acquire);
+                if (end != 0 && p >= slot.Begin.load(std::memory_order_relaxed) && p < end)
+                    return true;
+            }
+
+            return false;
+        }
+
+    private:
+        static constexpr std::size_t MaxArenas = 16;
+        static inline ParameterArenaSlot Slots[MaxArenas];
+        static inline std::atomic<std::size_t> Registered{ 0 };
+
+        std::byte* Data = nullptr;
+        std::size_t Capacity = 0;
+        std::size_t Offset = 0;
+        ParameterArenaSlot* Used = nullptr;
+
+        static constexpr std::size_t RoundUp(std::size_t size, std::size_t align) noexcept
+        {
+            return (size + align - 1) & ~(align - 1);
+        }
+
+        bool Register() noexcept
+        {
+            for (auto& slot : Slots)
+            {
+                auto empty = std::uintptr_t(0);
+                if (slot.Begin.compare_exchange_strong(empty, reinterpret_cast<std::uintptr_t>(Data)))
+                {
+                    slot.End.store(reinterpret_cast<std::uintptr_t>(Data + Capacity), std::memory_order_release);
+                    Registered.fetch_add(1, std::memory_order_release);
+                    Used = &slot;
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        void Free() noexcept
+        {
+            if (Used)
+            {
+                Used->End.store(0, std::memory_order_release);
+                Used->Begin.store(0, std::memory_order_release);
+                Registered.fetch_sub(1, std::memory_order_release);
+                Used = nullptr;
+            }
+
+            if (Data)
+                ::operator delete(Data, std::align_val_t(BlockAlignment));
+
+            Data = nullptr;
+            Capacity = 0;
+            Offset = 0;
+        }
+    };
+
+    // routes this thread's AlignedAllocator allocations to the arena while the scope is open
+    struct ParameterScope
+    {
+        explicit ParameterScope(ParameterArena& arena) noexcept : Previous(ParameterArena::Current()) { ParameterArena::Current() = &arena; }
+        ~ParameterScope() { ParameterArena::Current() = Previous; }
+
+        ParameterScope(const ParameterScope&) = delete;
+        ParameterScope& operator=(const ParameterScope&) = delete;
+
+    private:
+        ParameterArena* const Previous;
+    };
+
     /**
      * @brief An STL-compatible allocator that ensures memory is aligned to a specific boundary.
      * @tparam T The type of object to allocate.
@@ -68,6 +237,10 @@ namespace dnn
             }
 
             const std::size_t total_size = n * sizeof(T);
+
+            if (auto arena = ParameterArena::Current())
+                if (auto p = arena->Allocate(total_size, Alignment))
+                    return static_cast<pointer>(p);
             
             // 2. Perform aligned allocation
             void* p = AlignedAlloc(Alignment, total_size);
@@ -81,7 +254,7 @@ namespace dnn
 
         DNN_INLINE void deallocate(pointer p, std::size_t /*n*/) noexcept
         {
-            if (p) {
+            if (p && !ParameterArena::Owns(p)) {
                 AlignedFree(p);
             }
         }
@@ -137,4 +310,239 @@ namespace dnn
 
     template <typename T, typename U, std::size_t A>
     bool operator!=(const AlignedAllocator<T, A>&, const AlignedAllocator<U, A>&) noexcept { return false; }
-}
\ No newline at end of file
+
+    /**
+     * @brief A per-thread bump allocator for short-lived temporaries.
+     *
+     * While a ScratchScope is open on a thread, ScratchAllocator serves that thread's allocations from the arena.
+     * Everything is released at once when the outermost scope closes. The blocks are kept, and grown blocks are
+     * merged into one, so a steady state workload allocates nothing on the heap.
+     * Memory from the arena must not outlive the scope or be freed on another thread.
+     */
+    class ScratchArena
+    {
+    public:
+        static constexpr std::size_t MinimumBlockSize = std::size_t(1) << 20;
+
+        ScratchArena()
+        {
+#ifndef NDEBUG
+            std::lock_guard<std::mutex> lock(RegistryLock());
+            Registry().insert(this);
+#endif
+        }
+
+        ScratchArena(const ScratchArena&) = delete;
+        ScratchArena& operator=(const ScratchArena&) = delete;
+
+        ~ScratchArena()
+        {
+#ifndef NDEBUG
+            std::lock_guard<std::mutex> lock(RegistryLock());
+            Registry().erase(this);
+#endif
+            for (auto& block : Blocks)
+                ::operator delete(block.Data, std::align_val_t(BlockAlignment));
+        }
+
+        static ScratchArena& Local() noexcept
+        {
+            thread_local ScratchArena arena;
+            return arena;
+        }
+
+        DNN_INLINE bool Active() const noexcept { return Depth > 0 && !Suspended; }
+
+        void* Allocate(const std::size_t size, const std::size_t alignment)
+        {
+            auto offset = Blocks.empty() ? std::size_t(0) : RoundUp(Offset, alignment);
+
+            if (Blocks.empty() || offset + size > Blocks.back().Size)
+            {
+                Grow(size + alignment);
+                offset = 0;
+            }
+
+            Offset = offset + size;
+            Live++;
+
+            return Blocks.back().Data + offset;
+        }
+
+        DNN_INLINE bool Release(const void* ptr) noexcept
+        {
+            const auto p = static_cast<const std::byte*>(ptr);
+
+            for (const auto& block : Blocks)
+                if (p >= block.Data && p < block.Data + block.Size)
+                {
+                    Live--;
+                    return true;
+                }
+
+            return false;
+        }
+
+#ifndef NDEBUG
+        // true when the arena of another thread holds ptr, it was allocated there and must be freed there
+        static bool Foreign(const void* ptr) noexcept
+        {
+            const auto p = static_cast<const std::byte*>(ptr);
+            const auto local = &Local();
+
+            std::lock_guard<std::mutex> lock(RegistryLock());
+            for (const auto arena : Registry())
+                if (arena != local)
+                    for (const auto& block : arena->Blocks)
+                        if (p >= block.Data && p < block.Data + block.Size)
+                            return true;
+
+            return false;
+        }
+#endif
+
+    private:
+        friend struct ScratchScope;
+        friend struct HeapScope;
+
+        struct Block
+        {
+            std::byte* Data;
+            std::size_t Size;
+        };
+
+        static constexpr std::size_t BlockAlignment = 64;
+
+        std::vector<Block> Blocks;
+        std::size_t Offset = 0;
+        std::size_t Live = 0;
+        std::size_t Depth = 0;
+        bool Suspended = false;
+
+        static constexpr std::size_t RoundUp(std::size_t size, std::size_t align) noexcept
+        {
+            return (size + align - 1) & ~(align - 1);
+        }
+
+#ifndef NDEBUG
+        static std::mutex& RegistryLock()
+        {
+            static std::mutex lock;
+            return lock;
+        }
+
+        static std::set<const ScratchArena*>& Registry()
+        {
+            static std::set<const ScratchArena*> arenas;
+            return arenas;
+        }
+#endif
+
+        void Grow(const std::size_t size)
+        {
+#ifndef NDEBUG
+            std::lock_guard<std::mutex> lock(RegistryLock());
+#endif
+            const auto blockSize = RoundUp(std::max({ size, MinimumBlockSize, Blocks.empty() ? std::size_t(0) : 2 * Blocks.back().Size }), BlockAlignment);
+            Blocks.push_back({ static_cast<std::byte*>(::operator new(blockSize, std::align_val_t(BlockAlignment))), blockSize });
+        }
+
+        void Reset()
+        {
+            // memory from the arena outlived the scope it was allocated in, keep bumping until it is gone
+            assert(Live == 0 && "ScratchArena memory outlived its ScratchScope");
+            if (Live > 0)
+                return;
+
+            if (Blocks.size() > 1)
+            {
+                auto total = std::size_t(0);
+                {
+#ifndef NDEBUG
+                    std::lock_guard<std::mutex> lock(RegistryLock());
+#endif
+                    for (auto& block : Blocks)
+                    {
+                        total += block.Size;
+                        ::operator delete(block.Data, std::align_val_t(BlockAlignment));
+                    }
+                    Blocks.clear();
+                }
+                Grow(total);
+            }
+
+            Offset = 0;
+        }
+    };
+
+    // routes this thread's ScratchAllocator allocations to its arena until the outermost scope closes
+    struct ScratchScope
+    {
+        ScratchScope() noexcept { ScratchArena::Local().Depth++; }
+        ~ScratchScope() { auto& arena = ScratchArena::Local(); if (--arena.Depth == 0) arena.Reset(); }
+
+        ScratchScope(const ScratchScope&) = delete;
+        ScratchScope& operator=(const ScratchScope&) = delete;
+    };
+
+    // suspends an enclosing ScratchScope, for allocations that must outlive it (e.g. caches)
+    struct HeapScope
+    {
+        HeapScope() noexcept : Previous(ScratchArena::Local().Suspended) { ScratchArena::Local().Suspended = true; }
+        ~HeapScope() { ScratchArena::Local().Suspended = Previous; }
+
+        HeapScope(const HeapScope&) = delete;
+        HeapScope& operator=(const HeapScope&) = delete;
+
+    private:
+        const bool Previous;
+    };
+
+    /**
+     * @brief An AlignedAllocator that draws from the thread's ScratchArena while a ScratchScope is open.
+     */
+    template <typename T, std::size_t Alignment>
+    class ScratchAllocator : public AlignedAllocator<T, Alignment>
+    {
+    public:
+        using pointer = T*;
+
+        template <typename U>
+        struct rebind {
+            using other = ScratchAllocator<U, Alignment>;
+        };
+
+        ScratchAllocator() noexcept = default;
+
+        template <typename U>
+        ScratchAllocator(const ScratchAllocator<U, Alignment>&) noexcept {}
+
+        [[nodiscard]] DNN_INLINE pointer allocate(std::size_t n)
+        {
+            auto& arena = ScratchArena::Local();
+
+            if (n == 0 || !arena.Active())
+                return AlignedAllocator<T, Alignment>::allocate(n);
+
+            if (n > std::numeric_limits<std::size_t>::max() / sizeof(T))
+                throw std::bad_array_new_length();
+
+            return static_cast<pointer>(arena.Allocate(n * sizeof(T), Alignment));
+        }
+
+        DNN_INLINE void deallocate(pointer p, std::size_t n) noexcept
+        {
+            if (p && !ScratchArena::Local().Release(p))
+            {
+                assert(!ScratchArena::Foreign(p) && "ScratchArena memory freed on another thread");
+                AlignedAllocator<T, Alignment>::deallocate(p, n);
+            }
+        }
+    };
+
+    template <typename T, typename U, std::size_t A>
+    bool operator==(const ScratchAllocator<T, A>&, const ScratchAllocator<U, A>&) noexcept { return true; }
+
+    template <typename T, typename U, std::size_t A>
+    bool operator!=(const ScratchAllocator<T, A>&, const ScratchAllocator<U, A>&) noexcept { return false; }
+}
@@ -8,9 +8,7 @@ namespace dnn
 	private:
 		std::unordered_map<int, dnnl::memory> fwdArgs;
 		std::unique_ptr<dnnl::binary::primitive_desc> fwdDesc;
-#ifdef DNN_CACHE_PRIMITIVES
 		std::unique_ptr<dnnl::binary> fwd;
-#endif
 		std::vector<Float> scales;
 		FloatVector scale;
 
@@ -93,9 +91,7 @@ namespace dnn
 
 			fwdArgs = std::unordered_map<int, dnnl::memory>{ { DNNL_ARG_SRC_0, dnnl::memory(*Inputs[first]->DstMemDesc, Device.engine, Inputs[first]->Neurons.data()) }, { DNNL_ARG_SRC_1, dnnl::memory(*Inputs[second]->DstMemDesc, Device.engine, Inputs[second]->Neurons.data()) }, { DNNL_ARG_DST, dnnl::memory(*DstMemDesc, Device.engine, Neurons.data()) }, { DNNL_ARG_ATTR_SCALES | DNNL_ARG_SRC_0, ScaleMem }, { DNNL_ARG_ATTR_SCALES | DNNL_ARG_SRC_1, ScaleMem } };
 
-#ifdef DNN_CACHE_PRIMITIVES
 			fwd = std::make_unique<dnnl::binary>(dnnl::binary(*fwdDesc));
-#endif
 		}
 
 		void ForwardProp(const UInt batchSize, const bool training) final override
@@ -108,11 +104,7 @@ namespace dnn
 			{
 				if (Reference && fullDepth)
 				{
-#ifdef DNN_CACHE_PRIMITIVES
 					fwd->execute(Device.stream, fwdArgs);
-#else
-					dnnl::binary(*fwdDesc).execute(Device.stream, fwdArgs);
-#endif
 					Device.stream.wait();
 #ifndef DNN_LEAN
 					fast_memzero(NeuronsD1.data(), PaddedCDHW() * batchSize * sizeof(Float));
@@ -299,11 +291,7 @@ namespace dnn
 			}
 			else
 			{
-#ifdef DNN_CACHE_PRIMITIVES
 				fwd->execute(Device.stream, fwdArgs);
-#else
-				dnnl::binary(*fwdDesc).execute(Device.stream, fwdArgs);
-#endif
 				Device.stream.wait();
 			}
 		}
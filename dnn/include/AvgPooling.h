@@ -6,14 +6,13 @@ namespace dnn
 	class AvgPooling final : public Layer
 	{
 	private:
-		std::unique_ptr<dnnl::pooling_forward::primitive_desc> fwdDesc;
-		std::unique_ptr<dnnl::pooling_backward::primitive_desc> bwdDesc;
-		std::unique_ptr<dnnl::binary::primitive_desc> bwdAddDesc;
-#ifdef DNN_CACHE_PRIMITIVES
-		std::unique_ptr<dnnl::pooling_forward> fwd;
-		std::unique_ptr<dnnl::pooling_backward> bwd;
-		std::unique_ptr<dnnl::binary> bwdAdd;
-#endif
+		std::shared_ptr<dnnl::pooling_forward::primitive_desc> fwdDesc;
+		std::shared_ptr<dnnl::pooling_backward::primitive_desc> bwdDesc;
+		std::shared_ptr<dnnl::binary::primitive_desc> bwdAddDesc;
+		std::shared_ptr<dnnl::pooling_forward> fwd;
+		std::shared_ptr<dnnl::pooling_backward> bwd;
+		std::shared_ptr<dnnl::binary> bwdAdd;
+		PrimitiveCache<std::tuple<decltype(fwdDesc), decltype(bwdDesc), decltype(bwdAddDesc), decltype(fwd), decltype(bwd), decltype(bwdAdd)>> primitives;
 		bool reorderFwdSrc;
 		bool reorderBwdDiffSrc;
 
@@ -109,27 +108,35 @@ namespace dnn
 				DiffDstMemDesc = std::make_unique<dnnl::memory::desc>(dnnl::memory::desc(dnnl::memory::dims({ dnnl::memory::dim(batchSize), dnnl::memory::dim(C), dnnl::memory::dim(H), dnnl::memory::dim(W) }), dnnl::memory::data_type::f32, ChosenFormat));
 			}
 
-			if (HasPadding)
-			{
-				fwdDesc = std::make_unique<dnnl::pooling_forward::primitive_desc>(dnnl::pooling_forward::primitive_desc(Device.engine, dnnl::prop_kind::forward, dnnl::algorithm::pooling_avg_include_padding, *InputLayer->DstMemDesc, *DstMemDesc, Strides, Kernel, Dilation, Padding, Padding));
-				bwdDesc = std::make_unique<dnnl::pooling_backward::primitive_desc>(dnnl::pooling_backward::primitive_desc(Device.engine, dnnl::algorithm::pooling_avg_include_padding, *InputLayerBwd->DiffDstMemDesc, *DiffDstMemDesc, Strides, Kernel, Dilation, Padding, Padding, *fwdDesc));
-			}
+			const auto key = PrimitiveKey{ batchSize, InputLayer->D, InputLayer->H, InputLayer->W, InputLayer->ChosenFormat, FwdPropKind() };
+			if (const auto cached = primitives.Get(key))
+				std::tie(fwdDesc, bwdDesc, bwdAddDesc, fwd, bwd, bwdAdd) = *cached;
 			else
 			{
-				fwdDesc = std::make_unique<dnnl::pooling_forward::primitive_desc>(dnnl::pooling_forward::primitive_desc(Device.engine, dnnl::prop_kind::forward, dnnl::algorithm::pooling_avg_exclude_padding, *InputLayer->DstMemDesc, *DstMemDesc, Strides, Kernel, Dilation, Padding, Padding));
-				bwdDesc = std::make_unique<dnnl::pooling_backward::primitive_desc>(dnnl::pooling_backward::primitive_desc(Device.engine, dnnl::algorithm::pooling_avg_exclude_padding, *InputLayerBwd->DiffDstMemDesc, *DiffDstMemDesc, Strides, Kernel, Dilation, Padding, Padding, *fwdDesc));
+				fwdDesc = std::make_unique<dnnl::pooling_forward::primitive_desc>(dnnl::pooling_forward::primitive_desc(Device.engine, FwdPropKind(), HasPadding ? dnnl::algorithm::pooling_avg_include_padding : dnnl::algorithm::pooling_avg_exclude_padding, *InputLayer->DstMemDesc, *DstMemDesc, Strides, Kernel, Dilation, Padding, Padding));
+				fwd = std::make_shared<dnnl::pooling_forward>(dnnl::pooling_forward(*fwdDesc));
+
+				if (!Inference)
+				{
+					bwdDesc = std::make_unique<dnnl::pooling_backward::primitive_desc>(dnnl::pooling_backward::primitive_desc(Device.engine, HasPadding ? dnnl::algorithm::pooling_avg_include_padding : dnnl::algorithm::pooling_avg_exclude_padding, *InputLayerBwd->DiffDstMemDesc, *DiffDstMemDesc, Strides, Kernel, Dilation, Padding, Padding, *fwdDesc));
+					bwdAddDesc = std::make_unique<dnnl::binary::primitive_desc>(dnnl::binary::primitive_desc(Device.engine, dnnl::algorithm::binary_add, *InputLayerBwd->DiffDstMemDesc, *InputLayerBwd->DiffDstMemDesc, *InputLayerBwd->DiffDstMemDesc));
+					bwd = std::make_shared<dnnl::pooling_backward>(dnnl::pooling_backward(*bwdDesc));
+					bwdAdd = std::make_shared<dnnl::binary>(dnnl::binary(*bwdAddDesc));
+				}
+				else
+				{
+					bwdDesc.reset();
+					bwdAddDesc.reset();
+					bwd.reset();
+					bwdAdd.reset();
+				}
+
+				primitives.Put(key, std::make_shared<decltype(primitives)::value_type>(fwdDesc, bwdDesc, bwdAddDesc, fwd, bwd, bwdAdd), Inference ? PrimitiveBytes(*fwdDesc) : PrimitiveBytes(*fwdDesc, *bwdDesc, *bwdAddDesc));
 			}
 
 			reorderFwdSrc = fwdDesc->src_desc() != *InputLayer->DstMemDesc;
-			reorderBwdDiffSrc = bwdDesc->diff_src_desc() != *InputLayerBwd->DiffDstMemDesc;
-
-			bwdAddDesc = std::make_unique<dnnl::binary::primitive_desc>(Device.engine, dnnl::algorithm::binary_add, *InputLayerBwd->DiffDstMemDesc, *InputLayerBwd->DiffDstMemDesc, *InputLayerBwd->DiffDstMemDesc);
-
-#ifdef DNN_CACHE_PRIMITIVES
-			fwd = std::make_unique<dnnl::pooling_forward>(dnnl::pooling_forward(*fwdDesc));
-			bwd = std::make_unique<dnnl::pooling_backward>(dnnl::pooling_backward(*bwdDesc));
-			bwdAdd = std::make_unique<dnnl::binary>(dnnl::binary(*bwdAddDesc));
-#endif
+			if (!Inference)
+				reorderBwdDiffSrc = bwdDesc->diff_src_desc() != *InputLayerBwd->DiffDstMemDesc;
 		}
 
 		void ForwardProp(const UInt batchSize, const bool training) final override
@@ -144,11 +151,7 @@ namespace dnn
 
 			auto dstMem = dnnl::memory(*DstMemDesc, Device.engine, Neurons.data());
 
-#ifdef DNN_CACHE_PRIMITIVES
 			fwd->execute(Device.stream, { {DNNL_ARG_SRC, srcMem}, {DNNL_ARG_DST, dstMem} });
-#else
-			dnnl::pooling_forward(*fwdDesc).execute(Device.stream, { {DNNL_ARG_SRC, srcMem}, {DNNL_ARG_DST, dstMem} });
-#endif
 			Device.stream.wait();
 
 #ifndef DNN_LEAN
@@ -173,11 +176,7 @@ namespace dnn
 			auto memDiffSrc = SharesInput ? dnnl::memory(*InputLayerBwd->DiffDstMemDesc, Device.engine) : dnnl::memory(*InputLayerBwd->DiffDstMemDesc, Device.engine, InputLayerBwd->NeuronsD1.data());
 			auto diffSrcMem = reorderBwdDiffSrc ? dnnl::memory(bwdDesc->diff_src_desc(), Device.engine) : memDiffSrc;
 
-#ifdef DNN_CACHE_PRIMITIVES
 			bwd->execute(Device.stream, std::unordered_map<int, dnnl::memory>{ {DNNL_ARG_DIFF_DST, diffDstMem}, { DNNL_ARG_DIFF_SRC, diffSrcMem } });
-#else
-			dnnl::pooling_backward(*bwdDesc).execute(Device.stream, std::unordered_map<int, dnnl::memory>{ {DNNL_ARG_DIFF_DST, diffDstMem}, { DNNL_ARG_DIFF_SRC, diffSrcMem } });
-#endif
 			Device.stream.wait();
 
 			if (reorderBwdDiffSrc)
@@ -188,11 +187,7 @@ namespace dnn
 
 			if (SharesInput)
 			{
-#ifdef DNN_CACHE_PRIMITIVES
 				bwdAdd->execute(Device.stream, std::unordered_map<int, dnnl::memory>{ { DNNL_ARG_SRC_0, dnnl::memory(*InputLayerBwd->DiffDstMemDesc, Device.engine, InputLayerBwd->NeuronsD1.data()) }, { DNNL_ARG_SRC_1, memDiffSrc }, { DNNL_ARG_DST, dnnl::memory(*InputLayerBwd->DiffDstMemDesc, Device.engine, InputLayerBwd->NeuronsD1.data()) } });
-#else
-				dnnl::binary(*bwdAddDesc).execute(Device.stream, std::unordered_map<int, dnnl::memory>{ { DNNL_ARG_SRC_0, dnnl::memory(*InputLayerBwd->DiffDstMemDesc, Device.engine, InputLayerBwd->NeuronsD1.data()) }, { DNNL_ARG_SRC_1, memDiffSrc }, { DNNL_ARG_DST, dnnl::memory(*InputLayerBwd->DiffDstMemDesc, Device.engine, InputLayerBwd->NeuronsD1.data()) } });
-#endif
 				Device.stream.wait();
 			}
 
@@ -7,14 +7,13 @@ namespace dnn
 	class BatchNormActivationDropout final : public Layer
 	{
 	private:
-		std::unique_ptr<dnnl::batch_normalization_forward::primitive_desc> fwdDesc;
-		std::unique_ptr<dnnl::batch_normalization_backward::primitive_desc> bwdDesc;
-		std::unique_ptr<dnnl::binary::primitive_desc> bwdAddDesc;
-#ifdef DNN_CACHE_PRIMITIVES
-		std::unique_ptr<dnnl::batch_normalization_forward> fwd;
-		std::unique_ptr<dnnl::batch_normalization_backward> bwd;
-		std::unique_ptr<dnnl::binary> bwdAdd;
-#endif
+		std::shared_ptr<dnnl::batch_normalization_forward::primitive_desc> fwdDesc;
+		std::shared_ptr<dnnl::batch_normalization_backward::primitive_desc> bwdDesc;
+		std::shared_ptr<dnnl::binary::primitive_desc> bwdAddDesc;
+		std::shared_ptr<dnnl::batch_normalization_forward> fwd;
+		std::shared_ptr<dnnl::batch_normalization_backward> bwd;
+		std::shared_ptr<dnnl::binary> bwdAdd;
+		PrimitiveCache<std::tuple<decltype(fwdDesc), decltype(bwdDesc), decltype(bwdAddDesc), decltype(fwd), decltype(bwd), decltype(bwdAdd)>> primitives;
 		dnnl::normalization_flags flags;
 		bool inference;
 		bool reorderFwdSrc;
@@ -140,6 +139,9 @@ namespace dnn
 
 		void InitializeDescriptors(const UInt batchSize) final override
 		{
+			if (Inference)
+				inference = true;
+
 			if (GetMemoryNDims(*InputLayer->DstMemDesc) == 2)
 			{
 				ChosenFormat = dnnl::memory::format_tag::nc;
@@ -173,27 +175,38 @@ namespace dnn
 					dnnl::normalization_flags::use_scale | dnnl::normalization_flags::use_shift
 					: static_cast<dnnl::normalization_flags>(0U);
 
-				fwdDesc = std::make_unique<dnnl::batch_normalization_forward::primitive_desc>(dnnl::batch_normalization_forward::primitive_desc(Device.engine, inference ? dnnl::prop_kind::forward_inference : dnnl::prop_kind::forward_training, *DstMemDesc, *DstMemDesc, Eps, flags));
+				const auto key = PrimitiveKey{ batchSize, InputLayer->D, InputLayer->H, InputLayer->W, InputLayer->ChosenFormat, inference ? dnnl::prop_kind::forward_inference : dnnl::prop_kind::forward_training };
+				if (const auto cached = primitives.Get(key))
+					std::tie(fwdDesc, bwdDesc, bwdAddDesc, fwd, bwd, bwdAdd) = *cached;
+				else
+				{
+					fwdDesc = std::make_unique<dnnl::batch_normalization_forward::primitive_desc>(dnnl::batch_normalization_forward::primitive_desc(Device.engine, inference ? dnnl::prop_kind::forward_inference : dnnl::prop_kind::forward_training, *DstMemDesc, *DstMemDesc, Eps, flags));
+					fwd = std::make_shared<dnnl::batch_normalization_forward>(dnnl::batch_normalization_forward(*fwdDesc));
 
-				reorderFwdSrc = fwdDesc->src_desc() != *InputLayer->DstMemDesc;
+					if (!inference)
+					{
+						bwdDesc = std::make_unique<dnnl::batch_normalization_backward::primitive_desc>(dnnl::batch_normalization_backward::primitive_desc(Device.engine, Scaling ? dnnl::prop_kind::backward : dnnl::prop_kind::backward_data, *DiffDstMemDesc, *InputLayerBwd->DiffDstMemDesc, *DstMemDesc, Eps, flags, *fwdDesc));
+						bwdAddDesc = std::make_unique<dnnl::binary::primitive_desc>(dnnl::binary::primitive_desc(Device.engine, dnnl::algorithm::binary_add, *InputLayerBwd->DiffDstMemDesc, *InputLayerBwd->DiffDstMemDesc, *InputLayerBwd->DiffDstMemDesc));
+						bwd = std::make_shared<dnnl::batch_normalization_backward>(dnnl::batch_normalization_backward(*bwdDesc));
+						bwdAdd = std::make_shared<dnnl::binary>(dnnl::binary(*bwdAddDesc));
+					}
+					else
+					{
+						bwdDesc.reset();
+						bwdAddDesc.reset();
+						bwd.reset();
+						bwdAdd.reset();
+					}
 
-#ifdef DNN_CACHE_PRIMITIVES
-				fwd = std::make_unique<dnnl::batch_normalization_forward>(dnnl::batch_normalization_forward(*fwdDesc));
-#endif
+					primitives.Put(key, std::make_shared<decltype(primitives)::value_type>(fwdDesc, bwdDesc, bwdAddDesc, fwd, bwd, bwdAdd), inference ? PrimitiveBytes(*fwdDesc) : PrimitiveBytes(*fwdDesc, *bwdDesc, *bwdAddDesc));
+				}
+
+				reorderFwdSrc = fwdDesc->src_desc() != *InputLayer->DstMemDesc;
 				if (!inference)
 				{
-					bwdDesc = std::make_unique<dnnl::batch_normalization_backward::primitive_desc>(dnnl::batch_normalization_backward::primitive_desc(Device.engine, Scaling ? dnnl::prop_kind::backward : dnnl::prop_kind::backward_data, *DiffDstMemDesc, *InputLayerBwd->DiffDstMemDesc, *DstMemDesc, Eps, flags, *fwdDesc));
-
 					reorderBwdSrc = bwdDesc->src_desc() != *InputLayer->DstMemDesc;
 					reorderBwdDiffSrc = bwdDesc->diff_src_desc() != *InputLayerBwd->DiffDstMemDesc;
 					reorderBwdDiffDst = bwdDesc->diff_dst_desc() != (!InplaceBwd ? *DiffDstMemDesc : *InputLayerBwd->DiffDstMemDesc);
-
-					bwdAddDesc = std::make_unique<dnnl::binary::primitive_desc>(dnnl::binary::primitive_desc(Device.engine, dnnl::algorithm::binary_add, *InputLayerBwd->DiffDstMemDesc, *InputLayerBwd->DiffDstMemDesc, *InputLayerBwd->DiffDstMemDesc));
-
-#ifdef DNN_CACHE_PRIMITIVES
-					bwd = std::make_unique<dnnl::batch_normalization_backward>(dnnl::batch_normalization_backward(*bwdDesc));
-					bwdAdd = std::make_unique<dnnl::binary>(dnnl::binary(*bwdAddDesc));
-#endif
 				}
 			}
 		}
@@ -205,7 +218,7 @@ namespace dnn
 			if constexpr (Reference || TestBatchNormalization || ReferenceBatchNormalization)
 				InputNeurons.resize(batchSize, C, H, W, dnnl::memory::data_type::f32, BlockedFmt, Device.engine);
 
-			if (Enabled)
+			if (Enabled && !Inference)
 			{
 				NeuronsActive.resize(batchSize, C, H, W, dnnl::memory::data_type::f32, BlockedFmt, Device.engine);
 				for (auto n = 0ull; n < batchSize; n++)
@@ -955,17 +968,10 @@ namespace dnn
 				{
 					auto memScale = dnnl::memory(*WeightsMemDesc, Device.engine, Weights.data());
 					auto memShift = dnnl::memory(*WeightsMemDesc, Device.engine, Biases.data());
-#ifdef DNN_CACHE_PRIMITIVES
 					fwd->execute(Device.stream, std::unordered_map<int, dnnl::memory>{ {DNNL_ARG_SRC, srcMem}, { DNNL_ARG_MEAN, memMean }, { DNNL_ARG_VARIANCE, memVariance }, { DNNL_ARG_SCALE, memScale }, { DNNL_ARG_SHIFT, memShift }, { DNNL_ARG_DST, dstMem } });
-#endif
-					dnnl::batch_normalization_forward(*fwdDesc).execute(Device.stream, std::unordered_map<int, dnnl::memory>{ {DNNL_ARG_SRC, srcMem}, { DNNL_ARG_MEAN, memMean }, { DNNL_ARG_VARIANCE, memVariance }, { DNNL_ARG_SCALE, memScale }, { DNNL_ARG_SHIFT, memShift }, { DNNL_ARG_DST, dstMem } });
 				}
 				else
-#ifdef DNN_CACHE_PRIMITIVES
 					fwd->execute(Device.stream, std::unordered_map<int, dnnl::memory>{ {DNNL_ARG_SRC, srcMem}, { DNNL_ARG_MEAN, memMean }, { DNNL_ARG_VARIANCE, memVariance }, { DNNL_ARG_DST, dstMem } });
-#else
-					dnnl::batch_normalization_forward(*fwdDesc).execute(Device.stream, std::unordered_map<int, dnnl::memory>{ {DNNL_ARG_SRC, srcMem}, { DNNL_ARG_MEAN, memMean }, { DNNL_ARG_VARIANCE, memVariance }, { DNNL_ARG_DST, dstMem } });
-#endif
 
 				Device.stream.wait();
 			}
@@ -994,18 +1000,10 @@ namespace dnn
 					auto memScale = dnnl::memory(*WeightsMemDesc, Device.engine, Weights.data());
 					auto memShift = dnnl::memory(*WeightsMemDesc, Device.engine, Biases.data());
 
-#ifdef DNN_CACHE_PRIMITIVES
 					fwd->execute(Device.stream, std::unordered_map<int, dnnl::memory>{ {DNNL_ARG_SRC, srcMem}, { DNNL_ARG_MEAN, memMean }, { DNNL_ARG_VARIANCE, memVariance }, { DNNL_ARG_SCALE, memScale }, { DNNL_ARG_SHIFT, memShift }, { DNNL_ARG_DST, dstMem } });
-#else
-					dnnl::batch_normalization_forward(*fwdDesc).execute(Device.stream, std::unordered_map<int, dnnl::memory>{ {DNNL_ARG_SRC, srcMem}, { DNNL_ARG_MEAN, memMean }, { DNNL_ARG_VARIANCE, memVariance }, { DNNL_ARG_SCALE, memScale }, { DNNL_ARG_SHIFT, memShift }, { DNNL_ARG_DST, dstMem } });
-#endif
 				}
 				else
-#ifdef DNN_CACHE_PRIMITIVES
 					fwd->execute(Device.stream, std::unordered_map<int, dnnl::memory>{ {DNNL_ARG_SRC, srcMem}, { DNNL_ARG_MEAN, memMean }, { DNNL_ARG_VARIANCE, memVariance }, { DNNL_ARG_DST, dstMem } });
-#else
-					dnnl::batch_normalization_forward(*fwdDesc).execute(Device.stream, std::unordered_map<int, dnnl::memory>{ {DNNL_ARG_SRC, srcMem}, { DNNL_ARG_MEAN, memMean }, { DNNL_ARG_VARIANCE, memVariance }, { DNNL_ARG_DST, dstMem } });
-#endif
 				Device.stream.wait();
 
 				const Float unbiasedFactor = Float(batchSize * HW()) / Float(batchSize * HW() - 1);
@@ -1366,18 +1364,10 @@ namespace dnn
 				auto diffScaleMemory = dnnl::memory(*WeightsMemDesc, Device.engine, WeightsD1.data());
 				auto diffShiftMemory = dnnl::memory(*WeightsMemDesc, Device.engine, BiasesD1.data());
 
-#ifdef DNN_CACHE_PRIMITIVES
 				bwd->execute(Device.stream, std::unordered_map<int, dnnl::memory>{ {DNNL_ARG_SRC, srcMem}, { DNNL_ARG_DIFF_DST, diffDstMem }, { DNNL_ARG_MEAN, memMean }, { DNNL_ARG_VARIANCE, memVariance }, { DNNL_ARG_SCALE, scaleMemory }, { DNNL_ARG_SHIFT, shiftMemory }, { DNNL_ARG_DIFF_SRC, diffSrcMem }, { DNNL_ARG_DIFF_SCALE, diffScaleMemory }, { DNNL_ARG_DIFF_SHIFT, diffShiftMemory } });
-#else
-				dnnl::batch_normalization_backward(*bwdDesc).execute(Device.stream, std::unordered_map<int, dnnl::memory>{ {DNNL_ARG_SRC, srcMem}, { DNNL_ARG_DIFF_DST, diffDstMem }, { DNNL_ARG_MEAN, memMean }, { DNNL_ARG_VARIANCE, memVariance }, { DNNL_ARG_SCALE, scaleMemory }, { DNNL_ARG_SHIFT, shiftMemory }, { DNNL_ARG_DIFF_SRC, diffSrcMem }, { DNNL_ARG_DIFF_SCALE, diffScaleMemory }, { DNNL_ARG_DIFF_SHIFT, diffShiftMemory } });
-#endif
 			}
 			else
-#ifdef DNN_CACHE_PRIMITIVES
 				bwd->execute(Device.stream, std::unordered_map<int, dnnl::memory>{ {DNNL_ARG_SRC, srcMem}, { DNNL_ARG_DIFF_DST, diffDstMem }, { DNNL_ARG_MEAN, memMean }, { DNNL_ARG_VARIANCE, memVariance }, { DNNL_ARG_DIFF_SRC, diffSrcMem } });
-#else
-				dnnl::batch_normalization_backward(*bwdDesc).execute(Device.stream, std::unordered_map<int, dnnl::memory>{ {DNNL_ARG_SRC, srcMem}, { DNNL_ARG_DIFF_DST, diffDstMem }, { DNNL_ARG_MEAN, memMean }, { DNNL_ARG_VARIANCE, memVariance }, { DNNL_ARG_DIFF_SRC, diffSrcMem } });
-#endif
 
 			Device.stream.wait();
 
@@ -1389,11 +1379,7 @@ namespace dnn
 
 			if (SharesInput)
 			{
-#ifdef DNN_CACHE_PRIMITIVES
 				bwdAdd->execute(Device.stream, std::unordered_map<int, dnnl::memory>{ { DNNL_ARG_SRC_0, dnnl::memory(*InputLayerBwd->DiffDstMemDesc, Device.engine, InputLayerBwd->NeuronsD1.data()) }, { DNNL_ARG_SRC_1, memDiffSrc }, { DNNL_ARG_DST, dnnl::memory(*InputLayerBwd->DiffDstMemDesc, Device.engine, InputLayerBwd->NeuronsD1.data()) } });
-#else
-				dnnl::binary(*bwdAddDesc).execute(Device.stream, std::unordered_map<int, dnnl::memory>{ { DNNL_ARG_SRC_0, dnnl::memory(*InputLayerBwd->DiffDstMemDesc, Device.engine, InputLayerBwd->NeuronsD1.data()) }, { DNNL_ARG_SRC_1, memDiffSrc }, { DNNL_ARG_DST, dnnl::memory(*InputLayerBwd->DiffDstMemDesc, Device.engine, InputLayerBwd->NeuronsD1.data()) } });
-#endif
 				Device.stream.wait();
 			}
 
@@ -1478,9 +1464,9 @@ namespace dnn
 		UInt GetNeuronsSize(const UInt batchSize) const override
 		{
 			if constexpr (ReferenceBatchNormalization || Reference)
-				return Layer::GetNeuronsSize(batchSize) + (batchSize * PaddedCDHW() * sizeof(Float) * 2ull);
+				return Layer::GetNeuronsSize(batchSize) + (batchSize * PaddedCDHW() * sizeof(Float) * (Inference ? 1ull : 2ull));
 			else
-				return Layer::GetNeuronsSize(batchSize) + (batchSize * PaddedCDHW() * sizeof(Float));
+				return Layer::GetNeuronsSize(batchSize) + (Inference ? 0ull : (batchSize * PaddedCDHW() * sizeof(Float)));
 		}
 	};
 }
\ No newline at end of file
@@ -6,16 +6,17 @@ namespace dnn
 	class BatchNormRelu final : public Layer
 	{
 	private:
-		std::unique_ptr<dnnl::batch_normalization_forward::primitive_desc> fwdDesc;
-		std::unique_ptr<dnnl::batch_normalization_backward::primitive_desc> bwdDesc;
-		std::unique_ptr<dnnl::binary::primitive_desc> bwdAddDesc;
+		std::shared_ptr<dnnl::batch_normalization_forward::primitive_desc> fwdDesc;
+		std::shared_ptr<dnnl::batch_normalization_backward::primitive_desc> bwdDesc;
+		std::shared_ptr<dnnl::binary::primitive_desc> bwdAddDesc;
 		std::unique_ptr<dnnl::memory> workspaceMemory;
-#ifdef DNN_CACHE_PRIMITIVES
-		std::unique_ptr<dnnl::batch_normalization_forward> fwd;
-		std::unique_ptr<dnnl::batch_normalization_backward> bwd;
-		std::unique_ptr<dnnl::binary> bwdAdd;
-#endif
+		std::shared_ptr<dnnl::batch_normalization_forward> fwd;
+		std::shared_ptr<dnnl::batch_normalization_backward> bwd;
+		std::shared_ptr<dnnl::binary> bwdAdd;
+		PrimitiveCache<std::tuple<decltype(fwdDesc), decltype(bwdDesc), decltype(bwdAddDesc), decltype(fwd), decltype(bwd), decltype(bwdAdd)>> primitives;
 		dnnl::normalization_flags flags;
+		ExecutionPlan fwdPlan;
+		ExecutionPlan bwdPlan;
 		bool inference;
 		bool reorderFwdSrc;
 		bool reorderBwdSrc;
@@ -99,6 +100,9 @@ namespace dnn
 
 		void InitializeDescriptors(const UInt batchSize) final override
 		{
+			if (Inference)
+				inference = true;
+
 			if (GetMemoryNDims(*InputLayer->DstMemDesc) == 2)
 			{
 				ChosenFormat = dnnl::memory::format_tag::nc;
@@ -130,30 +134,113 @@ namespace dnn
 					dnnl::normalization_flags::fuse_norm_relu | dnnl::normalization_flags::use_scale | dnnl::normalization_flags::use_shift 
 					: dnnl::normalization_flags::fuse_norm_relu;
 
-			fwdDesc = std::make_unique<dnnl::batch_normalization_forward::primitive_desc>(dnnl::batch_normalization_forward::primitive_desc(Device.engine, inference ? dnnl::prop_kind::forward_inference : dnnl::prop_kind::forward, *DstMemDesc, *DstMemDesc, Eps, flags));
+			const auto key = PrimitiveKey{ batchSize, InputLayer->D, InputLayer->H, InputLayer->W, InputLayer->ChosenFormat, inference ? dnnl::prop_kind::forward_inference : dnnl::prop_kind::forward };
+			if (const auto cached = primitives.Get(key))
+				std::tie(fwdDesc, bwdDesc, bwdAddDesc, fwd, bwd, bwdAdd) = *cached;
+			else
+			{
+				fwdDesc = std::make_unique<dnnl::batch_normalization_forward::primitive_desc>(dnnl::batch_normalization_forward::primitive_desc(Device.engine, inference ? dnnl::prop_kind::forward_inference : dnnl::prop_kind::forward, *DstMemDesc, *DstMemDesc, Eps, flags));
+				fwd = std::make_shared<dnnl::batch_normalization_forward>(dnnl::batch_normalization_forward(*fwdDesc));
 
-			reorderFwdSrc = fwdDesc->src_desc() != *InputLayer->DstMemDesc;
+				if (!inference)
+				{
+					bwdDesc = std::make_unique<dnnl::batch_normalization_backward::primitive_desc>(dnnl::batch_normalization_backward::primitive_desc(Device.engine, Scaling ? dnnl::prop_kind::backward : dnnl::prop_kind::backward_data, *DiffDstMemDesc, *InputLayerBwd->DiffDstMemDesc, *DstMemDesc, Eps, flags, *fwdDesc));
+					bwdAddDesc = std::make_unique<dnnl::binary::primitive_desc>(dnnl::binary::primitive_desc(Device.engine, dnnl::algorithm::binary_add, *InputLayerBwd->DiffDstMemDesc, *InputLayerBwd->DiffDstMemDesc, *InputLayerBwd->DiffDstMemDesc));
+					bwd = std::make_shared<dnnl::batch_normalization_backward>(dnnl::batch_normalization_backward(*bwdDesc));
+					bwdAdd = std::make_shared<dnnl::binary>(dnnl::binary(*bwdAddDesc));
+				}
+				else
+				{
+					bwdDesc.reset();
+					bwdAddDesc.reset();
+					bwd.reset();
+					bwdAdd.reset();
+				}
+
+				primitives.Put(key, std::make_shared<decltype(primitives)::value_type>(fwdDesc, bwdDesc, bwdAddDesc, fwd, bwd, bwdAdd), inference ? PrimitiveBytes(*fwdDesc) : PrimitiveBytes(*fwdDesc, *bwdDesc, *bwdAddDesc));
+			}
 
-#ifdef DNN_CACHE_PRIMITIVES
-			fwd = std::make_unique<dnnl::batch_normalization_forward>(dnnl::batch_normalization_forward(*fwdDesc));
-#endif
+			reorderFwdSrc = fwdDesc->src_desc() != *InputLayer->DstMemDesc;
 			if (!inference)
 			{
 				workspaceMemory = std::make_unique<dnnl::memory>(dnnl::memory(fwdDesc->workspace_desc(), Device.engine));
 
-				bwdDesc = std::make_unique<dnnl::batch_normalization_backward::primitive_desc>(dnnl::batch_normalization_backward::primitive_desc(Device.engine, Scaling ? dnnl::prop_kind::backward : dnnl::prop_kind::backward_data, *DiffDstMemDesc, *InputLayerBwd->DiffDstMemDesc, *DstMemDesc, Eps, flags, *fwdDesc));
-
 				reorderBwdSrc = bwdDesc->src_desc() != *InputLayer->DstMemDesc;
 				reorderBwdDiffSrc = bwdDesc->diff_src_desc() != *InputLayerBwd->DiffDstMemDesc;
 				reorderBwdDiffDst = bwdDesc->diff_dst_desc() != *DiffDstMemDesc;
+			}
 
-				bwdAddDesc = std::make_unique<dnnl::binary::primitive_desc>(dnnl::binary::primitive_desc(Device.engine, dnnl::algorithm::binary_add, *InputLayerBwd->DiffDstMemDesc, *InputLayerBwd->DiffDstMemDesc, *InputLayerBwd->DiffDstMemDesc));
+			fwdPlan.Reset();
+			bwdPlan.Reset();
+
+			BuildForwardPlan();
+			if (!inference)
+				BuildBackwardPlan();
+		}
+
+		UInt PlanScratchSize(const bool backward) const final override
+		{
+			return backward ? bwdPlan.ScratchSize() : fwdPlan.ScratchSize();
+		}
+
+		void BuildForwardPlan()
+		{
+			const auto memSrc = fwdPlan.Bind(*InputLayer->DstMemDesc, Device.engine, [this] { return InputLayer->Neurons.data(); });
+			const auto srcMem = reorderFwdSrc ? fwdPlan.Scratch(fwdDesc->src_desc(), Device.engine) : memSrc;
+			if (reorderFwdSrc)
+				fwdPlan.AddReorder(memSrc, srcMem);
 
-#ifdef DNN_CACHE_PRIMITIVES
-				bwd = std::make_unique<dnnl::batch_normalization_backward>(dnnl::batch_normalization_backward(*bwdDesc));
-				bwdAdd = std::make_unique<dnnl::binary>(dnnl::binary(*bwdAddDesc));
-#endif
+			// inference normalizes with the running statistics, training computes the batch statistics
+			const auto memMean = inference ? fwdPlan.Bind(fwdDesc->mean_desc(), Device.engine, [this] { return RunningMean.data(); }) : fwdPlan.Bind(fwdDesc->mean_desc(), Device.engine, [this] { return Mean.data(); });
+			const auto memVariance = inference ? fwdPlan.Bind(fwdDesc->variance_desc(), Device.engine, [this] { return RunningVariance.data(); }) : fwdPlan.Bind(fwdDesc->variance_desc(), Device.engine, [this] { return Variance.data(); });
+			const auto dstMem = fwdPlan.Bind(*DstMemDesc, Device.engine, [this] { return Neurons.data(); });
+
+			auto args = std::vector<std::pair<int, dnnl::memory>>{ { DNNL_ARG_SRC, srcMem }, { DNNL_ARG_MEAN, memMean }, { DNNL_ARG_VARIANCE, memVariance }, { DNNL_ARG_DST, dstMem } };
+			if (Scaling)
+			{
+				args.push_back({ DNNL_ARG_SCALE, fwdPlan.Bind(*WeightsMemDesc, Device.engine, [this] { return Weights.data(); }) });
+				args.push_back({ DNNL_ARG_SHIFT, fwdPlan.Bind(*WeightsMemDesc, Device.engine, [this] { return Biases.data(); }) });
+			}
+			if (!inference)
+				args.push_back({ DNNL_ARG_WORKSPACE, *workspaceMemory });
+
+			fwdPlan.Add(*fwd, args);
+		}
+
+		void BuildBackwardPlan()
+		{
+			const auto memSrc = bwdPlan.Bind(*InputLayer->DstMemDesc, Device.engine, [this] { return InputLayer->Neurons.data(); });
+			const auto srcMem = reorderBwdSrc ? bwdPlan.Scratch(bwdDesc->src_desc(), Device.engine) : memSrc;
+			if (reorderBwdSrc)
+				bwdPlan.AddReorder(memSrc, srcMem);
+
+			const auto memDiffDst = !InplaceBwd ? bwdPlan.Bind(*DiffDstMemDesc, Device.engine, [this] { return NeuronsD1.data(); }) : bwdPlan.Bind(*InputLayerBwd->DiffDstMemDesc, Device.engine, [this] { return InputLayerBwd->NeuronsD1.data(); });
+			const auto diffDstMem = reorderBwdDiffDst ? bwdPlan.Scratch(bwdDesc->diff_dst_desc(), Device.engine) : memDiffDst;
+			if (reorderBwdDiffDst)
+				bwdPlan.AddReorder(memDiffDst, diffDstMem);
+
+			const auto memMean = bwdPlan.Bind(bwdDesc->mean_desc(), Device.engine, [this] { return Mean.data(); });
+			const auto memVariance = bwdPlan.Bind(bwdDesc->variance_desc(), Device.engine, [this] { return Variance.data(); });
+			const auto memInputDiff = bwdPlan.Bind(*InputLayerBwd->DiffDstMemDesc, Device.engine, [this] { return InputLayerBwd->NeuronsD1.data(); });
+			const auto memDiffSrc = SharesInput ? bwdPlan.Scratch(*InputLayerBwd->DiffDstMemDesc, Device.engine) : memInputDiff;
+			const auto diffSrcMem = reorderBwdDiffSrc ? bwdPlan.Scratch(bwdDesc->diff_src_desc(), Device.engine) : memDiffSrc;
+
+			auto args = std::vector<std::pair<int, dnnl::memory>>{ { DNNL_ARG_SRC, srcMem }, { DNNL_ARG_DIFF_DST, diffDstMem }, { DNNL_ARG_MEAN, memMean }, { DNNL_ARG_VARIANCE, memVariance }, { DNNL_ARG_WORKSPACE, *workspaceMemory }, { DNNL_ARG_DIFF_SRC, diffSrcMem } };
+			if (Scaling)
+			{
+				args.push_back({ DNNL_ARG_SCALE, bwdPlan.Bind(*WeightsMemDesc, Device.engine, [this] { return Weights.data(); }) });
+				args.push_back({ DNNL_ARG_SHIFT, bwdPlan.Bind(*WeightsMemDesc, Device.engine, [this] { return Biases.data(); }) });
+				args.push_back({ DNNL_ARG_DIFF_SCALE, bwdPlan.Bind(*WeightsMemDesc, Device.engine, [this] { return WeightsD1.data(); }) });
+				args.push_back({ DNNL_ARG_DIFF_SHIFT, bwdPlan.Bind(*WeightsMemDesc, Device.engine, [this] { return BiasesD1.data(); }) });
 			}
+
+			bwdPlan.Add(*bwd, args);
+
+			if (reorderBwdDiffSrc)
+				bwdPlan.AddReorder(diffSrcMem, memDiffSrc);
+
+			if (SharesInput)
+				bwdPlan.Add(*bwdAdd, { { DNNL_ARG_SRC_0, memInputDiff }, { DNNL_ARG_SRC_1, memDiffSrc }, { DNNL_ARG_DST, memInputDiff } });
 		}
 
 		bool Lockable() const final override
@@ -171,36 +258,7 @@ namespace dnn
 					InitializeDescriptors(batchSize);
 				}
 
-				const auto& memSrc = dnnl::memory(*InputLayer->DstMemDesc, Device.engine, InputLayer->Neurons.data());
-				auto srcMem = reorderFwdSrc ? dnnl::memory(fwdDesc->src_desc(), Device.engine) : memSrc;
-				if (reorderFwdSrc)
-				{
-					dnnl::reorder(memSrc, srcMem).execute(Device.stream, std::unordered_map<int, dnnl::memory>{ {DNNL_ARG_FROM, memSrc}, { DNNL_ARG_TO, srcMem } });
-					Device.stream.wait();
-				}
-
-				auto memMean = dnnl::memory(fwdDesc->mean_desc(), Device.engine, RunningMean.data());
-				auto memVariance = dnnl::memory(fwdDesc->variance_desc(), Device.engine, RunningVariance.data());
-				auto dstMem = dnnl::memory(*DstMemDesc, Device.engine, Neurons.data());
-
-				if (Scaling)
-				{
-					auto memScale = dnnl::memory(*WeightsMemDesc, Device.engine, Weights.data());
-					auto memShift = dnnl::memory(*WeightsMemDesc, Device.engine, Biases.data());
-
-#ifdef DNN_CACHE_PRIMITIVES
-					fwd->execute(Device.stream, std::unordered_map<int, dnnl::memory>{ {DNNL_ARG_SRC, srcMem}, { DNNL_ARG_MEAN, memMean }, { DNNL_ARG_VARIANCE, memVariance }, { DNNL_ARG_SCALE, memScale }, { DNNL_ARG_SHIFT, memShift }, { DNNL_ARG_DST, dstMem } });
-#else
-					dnnl::batch_normalization_forward(*fwdDesc).execute(Device.stream, std::unordered_map<int, dnnl::memory>{ {DNNL_ARG_SRC, srcMem}, { DNNL_ARG_MEAN, memMean }, { DNNL_ARG_VARIANCE, memVariance }, { DNNL_ARG_SCALE, memScale }, { DNNL_ARG_SHIFT, memShift }, { DNNL_ARG_DST, dstMem } });
-#endif
-				}
-				else
-#ifdef DNN_CACHE_PRIMITIVES
-					fwd->execute(Device.stream, std::unordered_map<int, dnnl::memory>{ {DNNL_ARG_SRC, srcMem}, { DNNL_ARG_MEAN, memMean }, { DNNL_ARG_VARIANCE, memVariance }, { DNNL_ARG_DST, dstMem } });
-#else
-					dnnl::batch_normalization_forward(*fwdDesc).execute(Device.stream, std::unordered_map<int, dnnl::memory>{ {DNNL_ARG_SRC, srcMem}, { DNNL_ARG_MEAN, memMean }, { DNNL_ARG_VARIANCE, memVariance }, { DNNL_ARG_DST, dstMem } });
-#endif
-				Device.stream.wait();
+				fwdPlan.Run(Device.stream, FwdScratch);
 			}
 			else
 			{
@@ -210,36 +268,7 @@ namespace dnn
 					InitializeDescriptors(batchSize);
 				}
 
-				const auto& memSrc = dnnl::memory(*InputLayer->DstMemDesc, Device.engine, InputLayer->Neurons.data());
-				auto srcMem = reorderFwdSrc ? dnnl::memory(fwdDesc->src_desc(), Device.engine) : memSrc;
-				if (reorderFwdSrc)
-				{
-					dnnl::reorder(memSrc, srcMem).execute(Device.stream, std::unordered_map<int, dnnl::memory>{ {DNNL_ARG_FROM, memSrc}, { DNNL_ARG_TO, srcMem } });
-					Device.stream.wait();
-				}
-
-				auto memMean = dnnl::memory(fwdDesc->mean_desc(), Device.engine, Mean.data());
-				auto memVariance = dnnl::memory(fwdDesc->variance_desc(), Device.engine, Variance.data());
-				auto dstMem = dnnl::memory(*DstMemDesc, Device.engine, Neurons.data());
-
-				if (Scaling)
-				{
-					auto memScale = dnnl::memory(*WeightsMemDesc, Device.engine, Weights.data());
-					auto memShift = dnnl::memory(*WeightsMemDesc, Device.engine, Biases.data());
-
-#ifdef DNN_CACHE_PRIMITIVES
-					fwd->execute(Device.stream, std::unordered_map<int, dnnl::memory>{ {DNNL_ARG_SRC, srcMem}, { DNNL_ARG_MEAN, memMean }, { DNNL_ARG_VARIANCE, memVariance }, { DNNL_ARG_SCALE, memScale }, { DNNL_ARG_SHIFT, memShift }, { DNNL_ARG_DST, dstMem }, { DNNL_ARG_WORKSPACE, *workspaceMemory } });
-#else
-					dnnl::batch_normalization_forward(*fwdDesc).execute(Device.stream, std::unordered_map<int, dnnl::memory>{ {DNNL_ARG_SRC, srcMem}, { DNNL_ARG_MEAN, memMean }, { DNNL_ARG_VARIANCE, memVariance }, { DNNL_ARG_SCALE, memScale }, { DNNL_ARG_SHIFT, memShift }, { DNNL_ARG_DST, dstMem }, { DNNL_ARG_WORKSPACE, *workspaceMemory } });
-#endif
-				}
-				else
-#ifdef DNN_CACHE_PRIMITIVES
-					fwd->execute(Device.stream, std::unordered_map<int, dnnl::memory>{ {DNNL_ARG_SRC, srcMem}, { DNNL_ARG_MEAN, memMean }, { DNNL_ARG_VARIANCE, memVariance }, { DNNL_ARG_DST, dstMem }, { DNNL_ARG_WORKSPACE, *workspaceMemory } });
-#else
-					dnnl::batch_normalization_forward(*fwdDesc).execute(Device.stream, std::unordered_map<int, dnnl::memory>{ {DNNL_ARG_SRC, srcMem}, { DNNL_ARG_MEAN, memMean }, { DNNL_ARG_VARIANCE, memVariance }, { DNNL_ARG_DST, dstMem }, { DNNL_ARG_WORKSPACE, *workspaceMemory } });
-#endif
-				Device.stream.wait();
+				fwdPlan.Run(Device.stream, FwdScratch);
 
 				const auto unbiasedFactor = Float(batchSize * HW()) / Float(batchSize * HW() - 1);
 				for (auto c = 0ull; c < C; c++)
@@ -265,64 +294,7 @@ namespace dnn
 			DNN_UNREF_PAR(batchSize);
 #endif // DNN_LEAN
 
-			const auto& memSrc = dnnl::memory(*InputLayer->DstMemDesc, Device.engine, InputLayer->Neurons.data());
-			auto srcMem = reorderBwdSrc ? dnnl::memory(bwdDesc->src_desc(), Device.engine) : memSrc;
-			if (reorderBwdSrc)
-			{
-				dnnl::reorder(memSrc, srcMem).execute(Device.stream, std::unordered_map<int, dnnl::memory>{ {DNNL_ARG_FROM, memSrc}, { DNNL_ARG_TO, srcMem } });
-				Device.stream.wait();
-			}
-
-			const auto& memDiffDst = !InplaceBwd ? dnnl::memory(*DiffDstMemDesc, Device.engine, NeuronsD1.data()) : dnnl::memory(*InputLayerBwd->DiffDstMemDesc, Device.engine, InputLayerBwd->NeuronsD1.data());
-			auto diffDstMem = reorderBwdDiffDst ? dnnl::memory(bwdDesc->diff_dst_desc(), Device.engine) : memDiffDst;
-			if (reorderBwdDiffDst)
-			{
-				dnnl::reorder(memDiffDst, diffDstMem).execute(Device.stream, std::unordered_map<int, dnnl::memory>{ {DNNL_ARG_FROM, memDiffDst}, { DNNL_ARG_TO, diffDstMem } });
-				Device.stream.wait();
-			}
-
-			auto memMean = dnnl::memory(bwdDesc->mean_desc(), Device.engine, Mean.data());
-			auto memVariance = dnnl::memory(bwdDesc->variance_desc(), Device.engine, Variance.data());
-			auto memDiffSrc = SharesInput ? dnnl::memory(*InputLayerBwd->DiffDstMemDesc, Device.engine) : dnnl::memory(*InputLayerBwd->DiffDstMemDesc, Device.engine, InputLayerBwd->NeuronsD1.data());
-			auto diffSrcMem = reorderBwdDiffSrc ? dnnl::memory(bwdDesc->diff_src_desc(), Device.engine) : memDiffSrc;
-
-			
-			if (Scaling)
-			{
-				auto scaleMemory = dnnl::memory(*WeightsMemDesc, Device.engine, Weights.data());
-				auto shiftMemory = dnnl::memory(*WeightsMemDesc, Device.engine, Biases.data());
-				auto diffScaleMemory = dnnl::memory(*WeightsMemDesc, Device.engine, WeightsD1.data());
-				auto diffShiftMemory = dnnl::memory(*WeightsMemDesc, Device.engine, BiasesD1.data());
-
-#ifdef DNN_CACHE_PRIMITIVES
-				bwd->execute(Device.stream, std::unordered_map<int, dnnl::memory> { {DNNL_ARG_SRC, srcMem}, { DNNL_ARG_DIFF_DST, diffDstMem }, { DNNL_ARG_MEAN, memMean }, { DNNL_ARG_VARIANCE, memVariance }, { DNNL_ARG_SCALE, scaleMemory }, { DNNL_ARG_SHIFT, shiftMemory }, { DNNL_ARG_WORKSPACE, *workspaceMemory }, { DNNL_ARG_DIFF_SRC, diffSrcMem }, { DNNL_ARG_DIFF_SCALE, diffScaleMemory }, { DNNL_ARG_DIFF_SHIFT, diffShiftMemory } });
-#else
-				dnnl::batch_normalization_backward(*bwdDesc).execute(Device.stream, std::unordered_map<int, dnnl::memory> { {DNNL_ARG_SRC, srcMem}, { DNNL_ARG_DIFF_DST, diffDstMem }, { DNNL_ARG_MEAN, memMean }, { DNNL_ARG_VARIANCE, memVariance }, { DNNL_ARG_SCALE, scaleMemory }, { DNNL_ARG_SHIFT, shiftMemory }, { DNNL_ARG_WORKSPACE, *workspaceMemory }, { DNNL_ARG_DIFF_SRC, diffSrcMem }, { DNNL_ARG_DIFF_SCALE, diffScaleMemory }, { DNNL_ARG_DIFF_SHIFT, diffShiftMemory } });
-#endif
-			}
-			else
-#ifdef DNN_CACHE_PRIMITIVES
-				bwd->execute(Device.stream, std::unordered_map<int, dnnl::memory>{ {DNNL_ARG_SRC, srcMem}, { DNNL_ARG_DIFF_DST, diffDstMem }, { DNNL_ARG_MEAN, memMean }, { DNNL_ARG_VARIANCE, memVariance }, { DNNL_ARG_WORKSPACE, *workspaceMemory }, { DNNL_ARG_DIFF_SRC, diffSrcMem } });
-#else
-				dnnl::batch_normalization_backward(*bwdDesc).execute(Device.stream, std::unordered_map<int, dnnl::memory>{ {DNNL_ARG_SRC, srcMem}, { DNNL_ARG_DIFF_DST, diffDstMem }, { DNNL_ARG_MEAN, memMean }, { DNNL_ARG_VARIANCE, memVariance }, { DNNL_ARG_WORKSPACE, *workspaceMemory }, { DNNL_ARG_DIFF_SRC, diffSrcMem } });
-#endif
-			Device.stream.wait();
-
-			if (reorderBwdDiffSrc)
-			{
-				dnnl::reorder(diffSrcMem, memDiffSrc).execute(Device.stream, std::unordered_map<int, dnnl::memory>{ {DNNL_ARG_FROM, diffSrcMem}, { DNNL_ARG_TO, memDiffSrc } });
-				Device.stream.wait();
-			}
-
-			if (SharesInput)
-			{
-#ifdef DNN_CACHE_PRIMITIVES
-				bwdAdd->execute(Device.stream, std::unordered_map<int, dnnl::memory>{ { DNNL_ARG_SRC_0, dnnl::memory(*InputLayerBwd->DiffDstMemDesc, Device.engine, InputLayerBwd->NeuronsD1.data()) }, { DNNL_ARG_SRC_1, memDiffSrc }, { DNNL_ARG_DST, dnnl::memory(*InputLayerBwd->DiffDstMemDesc, Device.engine, InputLayerBwd->NeuronsD1.data()) } });
-#else
-				dnnl::binary(*bwdAddDesc).execute(Device.stream, std::unordered_map<int, dnnl::memory>{ { DNNL_ARG_SRC_0, dnnl::memory(*InputLayer->DiffDstMemDesc, Device.engine, InputLayer->NeuronsD1.data()) }, { DNNL_ARG_SRC_1, memDiffSrc }, { DNNL_ARG_DST, dnnl::memory(*InputLayer->DiffDstMemDesc, Device.engine, InputLayer->NeuronsD1.data()) } });
-#endif
-				Device.stream.wait();
-			}
+			bwdPlan.Run(Device.stream, BwdScratch);
 
 #ifdef DNN_LEAN
 			ReleaseGradient();
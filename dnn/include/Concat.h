@@ -9,9 +9,7 @@ namespace dnn
 		std::unique_ptr<dnnl::concat::primitive_desc> fwdDesc;
 		std::unordered_map<int, dnnl::memory> fwdArgs;
 		std::vector<dnnl::memory::desc> srcMemsDesc;
-#ifdef DNN_CACHE_PRIMITIVES
 		std::unique_ptr<dnnl::concat> fwd;
-#endif
 
 		auto InputChannels(const std::vector<Layer*>& inputs) const
 		{
@@ -111,19 +109,13 @@ namespace dnn
 			for (auto i = 0ull; i < Inputs.size(); i++)
 				fwdArgs.insert({ DNNL_ARG_MULTIPLE_SRC + int(i), dnnl::memory(srcMemsDesc[i], Device.engine, Inputs[i]->Neurons.data())});
 
-#ifdef DNN_CACHE_PRIMITIVES
 			fwd = std::make_unique<dnnl::concat>(dnnl::concat(*fwdDesc));
-#endif
 		}
 		
 
 		void ForwardProp(const UInt batchSize, const bool training) final override
 		{
-#ifdef DNN_CACHE_PRIMITIVES
 			fwd->execute(Device.stream, fwdArgs);
-#else
-			dnnl::concat(*fwdDesc).execute(Device.stream, fwdArgs);
-#endif
 			Device.stream.wait();
 
 #ifndef DNN_LEAN
@@ -140,11 +132,7 @@ namespace dnn
 #ifdef DNN_LEAN
 				DNN_UNREF_PAR(batchSize);
 
-#ifdef DNN_CACHE_PRIMITIVES
 				fwd->execute(Device.stream, fwdArgs);
-#else
-				dnnl::concat(*fwdDesc).execute(Device.stream, fwdArgs);
-#endif
 				Device.stream.wait();
 #else
 				if constexpr (!Reference && !ReferenceConcat)
@@ -276,11 +264,7 @@ namespace dnn
 						for (auto i = 0ull; i < OutputNeurons.size(); i++)
 							OutputNeurons[i] = Float(0);
 
-#ifdef DNN_CACHE_PRIMITIVES
 						fwd->execute(Device.stream, fwdArgs);
-#else
-						dnnl::concat(*fwdDesc).execute(Device.stream, fwdArgs);
-#endif
 						Device.stream.wait();
 
 
@@ -304,11 +288,7 @@ namespace dnn
 				}
 				else
 				{
-#ifdef DNN_CACHE_PRIMITIVES
 					fwd->execute(Device.stream, fwdArgs);
-#else
-					dnnl::concat(*fwdDesc).execute(Device.stream, fwdArgs);
-#endif
 					Device.stream.wait();
 #ifndef DNN_LEAN
 					InitArray<Float>(NeuronsD1.data(), PaddedCDHW(), batchSize, FwdZeroGradient);
@@ -318,11 +298,7 @@ namespace dnn
 			}
 			else
 			{
-#ifdef DNN_CACHE_PRIMITIVES
 				fwd->execute(Device.stream, fwdArgs);
-#else
-				dnnl::concat(*fwdDesc).execute(Device.stream, fwdArgs);
-#endif
 				Device.stream.wait();
 			}
 		}
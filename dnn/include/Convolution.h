@@ -6,16 +6,17 @@ namespace dnn
 	class Convolution final : public Layer
 	{
 	private:
-		std::unique_ptr<dnnl::convolution_forward::primitive_desc> fwdDesc;
-		std::unique_ptr<dnnl::convolution_backward_weights::primitive_desc> bwdWeightsDesc;
-		std::unique_ptr<dnnl::convolution_backward_data::primitive_desc> bwdDataDesc;
-		std::unique_ptr<dnnl::binary::primitive_desc> bwdAddDesc;
-#ifdef DNN_CACHE_PRIMITIVES
-		std::unique_ptr<dnnl::convolution_forward> fwd;
-		std::unique_ptr<dnnl::convolution_backward_weights> bwdWeights;
-		std::unique_ptr<dnnl::convolution_backward_data> bwdData;
-		std::unique_ptr<dnnl::binary> bwdAdd;
-#endif
+		std::shared_ptr<dnnl::convolution_forward::primitive_desc> fwdDesc;
+		std::shared_ptr<dnnl::convolution_backward_weights::primitive_desc> bwdWeightsDesc;
+		std::shared_ptr<dnnl::convolution_backward_data::primitive_desc> bwdDataDesc;
+		std::shared_ptr<dnnl::binary::primitive_desc> bwdAddDesc;
+		std::shared_ptr<dnnl::convolution_forward> fwd;
+		std::shared_ptr<dnnl::convolution_backward_weights> bwdWeights;
+		std::shared_ptr<dnnl::convolution_backward_data> bwdData;
+		std::shared_ptr<dnnl::binary> bwdAdd;
+		PrimitiveCache<std::tuple<decltype(fwdDesc), decltype(bwdWeightsDesc), decltype(bwdDataDesc), decltype(bwdAddDesc), decltype(fwd), decltype(bwdWeights), decltype(bwdData), decltype(bwdAdd)>> primitives;
+		ExecutionPlan fwdPlan;
+		ExecutionPlan bwdPlan;
 		bool reorderFwdSrc;
 		bool reorderBwdWeightsSrc;
 		bool reorderBwdWeightsDiff;
@@ -121,36 +122,62 @@ namespace dnn
 
 		void InitializeDescriptors(const UInt batchSize) final override
 		{
-			std::vector<dnnl::memory::desc> memDesc;
-
-			if (Groups > 1)
-			{
-				memDesc = std::vector<dnnl::memory::desc>({
-					dnnl::memory::desc(dnnl::memory::dims({ dnnl::memory::dim(batchSize), dnnl::memory::dim(InputLayer->C), dnnl::memory::dim(InputLayer->H), dnnl::memory::dim(InputLayer->W) }), dnnl::memory::data_type::f32, NeuronsFormat),
-					dnnl::memory::desc(dnnl::memory::dims({ dnnl::memory::dim(batchSize), dnnl::memory::dim(C), dnnl::memory::dim(H), dnnl::memory::dim(W) }), dnnl::memory::data_type::f32, NeuronsFormat),
-					dnnl::memory::desc(dnnl::memory::dims({ dnnl::memory::dim(Groups), dnnl::memory::dim(C / Groups), dnnl::memory::dim(InputLayer->C / Groups), dnnl::memory::dim(KernelH), dnnl::memory::dim(KernelW) }), dnnl::memory::data_type::f32, dnnl::memory::format_tag::any),
-					dnnl::memory::desc(dnnl::memory::dims({ dnnl::memory::dim(C) }), dnnl::memory::data_type::f32, dnnl::memory::format_tag::any) });
-			}
+			const auto key = PrimitiveKey{ batchSize, InputLayer->D, InputLayer->H, InputLayer->W, InputLayer->ChosenFormat, FwdPropKind() };
+			if (const auto cached = primitives.Get(key))
+				std::tie(fwdDesc, bwdWeightsDesc, bwdDataDesc, bwdAddDesc, fwd, bwdWeights, bwdData, bwdAdd) = *cached;
 			else
 			{
-				memDesc = std::vector<dnnl::memory::desc>({
-					dnnl::memory::desc(dnnl::memory::dims({ dnnl::memory::dim(batchSize), dnnl::memory::dim(InputLayer->C), dnnl::memory::dim(InputLayer->H), dnnl::memory::dim(InputLayer->W) }), dnnl::memory::data_type::f32, NeuronsFormat),
-					dnnl::memory::desc(dnnl::memory::dims({ dnnl::memory::dim(batchSize), dnnl::memory::dim(C), dnnl::memory::dim(H), dnnl::memory::dim(W) }), dnnl::memory::data_type::f32, NeuronsFormat),
-					dnnl::memory::desc(dnnl::memory::dims({ dnnl::memory::dim(C), dnnl::memory::dim(InputLayer->C), dnnl::memory::dim(KernelH), dnnl::memory::dim(KernelW) }), dnnl::memory::data_type::f32, dnnl::memory::format_tag::any),
-					dnnl::memory::desc(dnnl::memory::dims({ dnnl::memory::dim(C) }), dnnl::memory::data_type::f32, dnnl::memory::format_tag::any) });
-			}
-						
-			fwdDesc = std::make_unique<dnnl::convolution_forward::primitive_desc>(HasBias ? 
-				dnnl::convolution_forward::primitive_desc(Device.engine, dnnl::prop_kind::forward, dnnl::algorithm::convolution_auto, memDesc[0], memDesc[2], memDesc[3], memDesc[1], Strides, Dilates, Padding, Padding) :
-				dnnl::convolution_forward::primitive_desc(Device.engine, dnnl::prop_kind::forward, dnnl::algorithm::convolution_auto, memDesc[0], memDesc[2], memDesc[1], Strides, Dilates, Padding, Padding));
-			
-			bwdWeightsDesc = std::make_unique<dnnl::convolution_backward_weights::primitive_desc>(HasBias ? 
-				dnnl::convolution_backward_weights::primitive_desc(Device.engine, dnnl::algorithm::convolution_auto, memDesc[0], memDesc[2], memDesc[3], memDesc[1], Strides, Dilates, Padding, Padding, *fwdDesc) :
-				dnnl::convolution_backward_weights::primitive_desc(Device.engine, dnnl::algorithm::convolution_auto, memDesc[0], memDesc[2], memDesc[1], Strides, Dilates, Padding, Padding, *fwdDesc));
+				std::vector<dnnl::memory::desc> memDesc;
 
-			bwdDataDesc = std::make_unique<dnnl::convolution_backward_data::primitive_desc>(dnnl::convolution_backward_data::primitive_desc(Device.engine, dnnl::algorithm::convolution_auto, memDesc[0], memDesc[2], memDesc[1], Strides, Dilates, Padding, Padding, *fwdDesc));
-			
-			bwdAddDesc = std::make_unique<dnnl::binary::primitive_desc>(dnnl::binary::primitive_desc(Device.engine, dnnl::algorithm::binary_add, *InputLayer->DiffDstMemDesc, *InputLayer->DiffDstMemDesc, *InputLayer->DiffDstMemDesc));
+				if (Groups > 1)
+				{
+					memDesc = std::vector<dnnl::memory::desc>({
+						dnnl::memory::desc(dnnl::memory::dims({ dnnl::memory::dim(batchSize), dnnl::memory::dim(InputLayer->C), dnnl::memory::dim(InputLayer->H), dnnl::memory::dim(InputLayer->W) }), dnnl::memory::data_type::f32, NeuronsFormat),
+						dnnl::memory::desc(dnnl::memory::dims({ dnnl::memory::dim(batchSize), dnnl::memory::dim(C), dnnl::memory::dim(H), dnnl::memory::dim(W) }), dnnl::memory::data_type::f32, NeuronsFormat),
+						dnnl::memory::desc(dnnl::memory::dims({ dnnl::memory::dim(Groups), dnnl::memory::dim(C / Groups), dnnl::memory::dim(InputLayer->C / Groups), dnnl::memory::dim(KernelH), dnnl::memory::dim(KernelW) }), dnnl::memory::data_type::f32, dnnl::memory::format_tag::any),
+						dnnl::memory::desc(dnnl::memory::dims({ dnnl::memory::dim(C) }), dnnl::memory::data_type::f32, dnnl::memory::format_tag::any) });
+				}
+				else
+				{
+					memDesc = std::vector<dnnl::memory::desc>({
+						dnnl::memory::desc(dnnl::memory::dims({ dnnl::memory::dim(batchSize), dnnl::memory::dim(InputLayer->C), dnnl::memory::dim(InputLayer->H), dnnl::memory::dim(InputLayer->W) }), dnnl::memory::data_type::f32, NeuronsFormat),
+						dnnl::memory::desc(dnnl::memory::dims({ dnnl::memory::dim(batchSize), dnnl::memory::dim(C), dnnl::memory::dim(H), dnnl::memory::dim(W) }), dnnl::memory::data_type::f32, NeuronsFormat),
+						dnnl::memory::desc(dnnl::memory::dims({ dnnl::memory::dim(C), dnnl::memory::dim(InputLayer->C), dnnl::memory::dim(KernelH), dnnl::memory::dim(KernelW) }), dnnl::memory::data_type::f32, dnnl::memory::format_tag::any),
+						dnnl::memory::desc(dnnl::memory::dims({ dnnl::memory::dim(C) }), dnnl::memory::data_type::f32, dnnl::memory::format_tag::any) });
+				}
+
+				fwdDesc = std::make_unique<dnnl::convolution_forward::primitive_desc>(HasBias ? 
+					dnnl::convolution_forward::primitive_desc(Device.engine, FwdPropKind(), dnnl::algorithm::convolution_auto, memDesc[0], memDesc[2], memDesc[3], memDesc[1], Strides, Dilates, Padding, Padding) :
+					dnnl::convolution_forward::primitive_desc(Device.engine, FwdPropKind(), dnnl::algorithm::convolution_auto, memDesc[0], memDesc[2], memDesc[1], Strides, Dilates, Padding, Padding));
+
+				fwd = std::make_shared<dnnl::convolution_forward>(dnnl::convolution_forward(*fwdDesc));
+
+				if (!Inference)
+				{
+					bwdWeightsDesc = std::make_unique<dnnl::convolution_backward_weights::primitive_desc>(HasBias ? 
+						dnnl::convolution_backward_weights::primitive_desc(Device.engine, dnnl::algorithm::convolution_auto, memDesc[0], memDesc[2], memDesc[3], memDesc[1], Strides, Dilates, Padding, Padding, *fwdDesc) :
+						dnnl::convolution_backward_weights::primitive_desc(Device.engine, dnnl::algorithm::convolution_auto, memDesc[0], memDesc[2], memDesc[1], Strides, Dilates, Padding, Padding, *fwdDesc));
+
+					bwdDataDesc = std::make_unique<dnnl::convolution_backward_data::primitive_desc>(dnnl::convolution_backward_data::primitive_desc(Device.engine, dnnl::algorithm::convolution_auto, memDesc[0], memDesc[2], memDesc[1], Strides, Dilates, Padding, Padding, *fwdDesc));
+
+					bwdAddDesc = std::make_unique<dnnl::binary::primitive_desc>(dnnl::binary::primitive_desc(Device.engine, dnnl::algorithm::binary_add, *InputLayer->DiffDstMemDesc, *InputLayer->DiffDstMemDesc, *InputLayer->DiffDstMemDesc));
+
+					bwdWeights = std::make_shared<dnnl::convolution_backward_weights>(dnnl::convolution_backward_weights(*bwdWeightsDesc));
+					bwdData = std::make_shared<dnnl::convolution_backward_data>(dnnl::convolution_backward_data(*bwdDataDesc));
+					bwdAdd = std::make_shared<dnnl::binary>(dnnl::binary(*bwdAddDesc));
+				}
+				else
+				{
+					bwdWeightsDesc.reset();
+					bwdDataDesc.reset();
+					bwdAddDesc.reset();
+					bwdWeights.reset();
+					bwdData.reset();
+					bwdAdd.reset();
+				}
+
+				primitives.Put(key, std::make_shared<decltype(primitives)::value_type>(fwdDesc, bwdWeightsDesc, bwdDataDesc, bwdAddDesc, fwd, bwdWeights, bwdData, bwdAdd), Inference ? PrimitiveBytes(*fwdDesc) : PrimitiveBytes(*fwdDesc, *bwdWeightsDesc, *bwdDataDesc, *bwdAddDesc));
+			}
 
 			if (*WeightsMemDesc != fwdDesc->weights_desc())
 			{
@@ -174,136 +201,113 @@ namespace dnn
 			ChosenFormat = GetMemoryFormat(*DstMemDesc);
 
 			reorderFwdSrc = fwdDesc->src_desc() != *InputLayer->DstMemDesc;
-			reorderBwdWeightsSrc = bwdWeightsDesc->src_desc() != *InputLayer->DstMemDesc;
-			reorderBwdWeightsDiff = bwdWeightsDesc->diff_dst_desc() != *DiffDstMemDesc;
-			reorderBwdWeightsDiffWeights = bwdWeightsDesc->diff_weights_desc() != *WeightsMemDesc;
-			reorderBwdDataDiffSrc = bwdDataDesc->diff_src_desc() != *InputLayerBwd->DiffDstMemDesc;
-			reorderBwdDataWeights = bwdDataDesc->weights_desc() != *WeightsMemDesc;
-			reorderBwdDataDiffDst = bwdDataDesc->diff_dst_desc() != *DiffDstMemDesc;
-			sameDiffFormat = bwdWeightsDesc->diff_dst_desc() == bwdDataDesc->diff_dst_desc();
-
-#ifdef DNN_CACHE_PRIMITIVES
-			fwd = std::make_unique<dnnl::convolution_forward>(dnnl::convolution_forward(*fwdDesc));
-			bwdWeights = std::make_unique<dnnl::convolution_backward_weights>(dnnl::convolution_backward_weights(*bwdWeightsDesc));
-			bwdData = std::make_unique<dnnl::convolution_backward_data>(dnnl::convolution_backward_data(*bwdDataDesc));
-			bwdAdd = std::make_unique<dnnl::binary>(dnnl::binary(*bwdAddDesc));
-#endif
-		}
-
-		void ForwardProp(const UInt batchSize, const bool training) final override
-		{	
-			const auto& memSrc = dnnl::memory(*InputLayer->DstMemDesc, Device.engine, InputLayer->Neurons.data());
-			auto srcMem = reorderFwdSrc ? dnnl::memory(fwdDesc->src_desc(), Device.engine) : memSrc;
-			if (reorderFwdSrc)
+			if (!Inference)
 			{
-				dnnl::reorder(memSrc, srcMem).execute(Device.stream, std::unordered_map<int, dnnl::memory>{ {DNNL_ARG_FROM, memSrc}, { DNNL_ARG_TO, srcMem } });
-				Device.stream.wait();
+				reorderBwdWeightsSrc = bwdWeightsDesc->src_desc() != *InputLayer->DstMemDesc;
+				reorderBwdWeightsDiff = bwdWeightsDesc->diff_dst_desc() != *DiffDstMemDesc;
+				reorderBwdWeightsDiffWeights = bwdWeightsDesc->diff_weights_desc() != *WeightsMemDesc;
+				reorderBwdDataDiffSrc = bwdDataDesc->diff_src_desc() != *InputLayerBwd->DiffDstMemDesc;
+				reorderBwdDataWeights = bwdDataDesc->weights_desc() != *WeightsMemDesc;
+				reorderBwdDataDiffDst = bwdDataDesc->diff_dst_desc() != *DiffDstMemDesc;
+				sameDiffFormat = bwdWeightsDesc->diff_dst_desc() == bwdDataDesc->diff_dst_desc();
 			}
 
-			const auto& weightsMem = dnnl::memory(fwdDesc->weights_desc(), Device.engine, Weights.data());
-			auto dstMem = dnnl::memory(*DstMemDesc, Device.engine, Neurons.data());
+			fwdPlan.Reset();
+			bwdPlan.Reset();
 
-#ifdef DNN_CACHE_PRIMITIVES
-			HasBias ? fwd->execute(Device.stream, std::unordered_map<int, dnnl::memory>{ {DNNL_ARG_SRC, srcMem}, { DNNL_ARG_WEIGHTS, weightsMem }, { DNNL_ARG_BIAS, dnnl::memory(fwdDesc->bias_desc(), Device.engine, Biases.data()) }, { DNNL_ARG_DST, dstMem } }) :
-				fwd->execute(Device.stream, std::unordered_map<int, dnnl::memory>{ {DNNL_ARG_SRC, srcMem}, { DNNL_ARG_WEIGHTS, weightsMem }, { DNNL_ARG_DST, dstMem } });
-#else
-			HasBias ? dnnl::convolution_forward(*fwdDesc).execute(Device.stream, std::unordered_map<int, dnnl::memory>{ {DNNL_ARG_SRC, srcMem}, { DNNL_ARG_WEIGHTS, weightsMem }, { DNNL_ARG_BIAS, dnnl::memory(fwdDesc->bias_desc(), Device.engine, Biases.data()) }, { DNNL_ARG_DST, dstMem } }) :
-				dnnl::convolution_forward(*fwdDesc).execute(Device.stream, std::unordered_map<int, dnnl::memory>{ {DNNL_ARG_SRC, srcMem}, { DNNL_ARG_WEIGHTS, weightsMem }, { DNNL_ARG_DST, dstMem } });
-#endif
-			Device.stream.wait();
+			// built here rather than on the first pass so the model can size the scratch arena the plans run in
+			BuildForwardPlan();
+			if (!Inference)
+				BuildBackwardPlan();
+		}
 
-#ifndef DNN_LEAN
-			if (training)
-				fast_memzero(NeuronsD1.data(), PaddedCDHW() * batchSize * sizeof(Float));
-#else
-			DNN_UNREF_PAR(batchSize);
-#endif // DNN_LEAN			
+		UInt PlanScratchSize(const bool backward) const final override
+		{
+			return backward ? bwdPlan.ScratchSize() : fwdPlan.ScratchSize();
 		}
 
-		void BackwardProp(const UInt batchSize) final override
+		void BuildForwardPlan()
 		{
-#ifdef DNN_LEAN
-			ZeroGradient(batchSize);
-#else
-			DNN_UNREF_PAR(batchSize);
-#endif // DNN_LEAN
-			
-			const auto& memDiffDst = dnnl::memory(*DiffDstMemDesc, Device.engine, NeuronsD1.data());
-			auto diffDstMem = reorderBwdWeightsDiff ? dnnl::memory(bwdWeightsDesc->diff_dst_desc(), Device.engine) : memDiffDst;
+			const auto memSrc = fwdPlan.Bind(*InputLayer->DstMemDesc, Device.engine, [this] { return InputLayer->Neurons.data(); });
+			const auto srcMem = reorderFwdSrc ? fwdPlan.Scratch(fwdDesc->src_desc(), Device.engine) : memSrc;
+			if (reorderFwdSrc)
+				fwdPlan.AddReorder(memSrc, srcMem);
+
+			const auto weightsMem = fwdPlan.Bind(fwdDesc->weights_desc(), Device.engine, [this] { return Weights.data(); });
+			const auto dstMem = fwdPlan.Bind(*DstMemDesc, Device.engine, [this] { return Neurons.data(); });
+
+			if (HasBias)
+				fwdPlan.Add(*fwd, { { DNNL_ARG_SRC, srcMem }, { DNNL_ARG_WEIGHTS, weightsMem }, { DNNL_ARG_BIAS, fwdPlan.Bind(fwdDesc->bias_desc(), Device.engine, [this] { return Biases.data(); }) }, { DNNL_ARG_DST, dstMem } });
+			else
+				fwdPlan.Add(*fwd, { { DNNL_ARG_SRC, srcMem }, { DNNL_ARG_WEIGHTS, weightsMem }, { DNNL_ARG_DST, dstMem } });
+		}
+
+		void BuildBackwardPlan()
+		{
+			const auto memDiffDst = bwdPlan.Bind(*DiffDstMemDesc, Device.engine, [this] { return NeuronsD1.data(); });
+			const auto diffDstMem = reorderBwdWeightsDiff ? bwdPlan.Scratch(bwdWeightsDesc->diff_dst_desc(), Device.engine) : memDiffDst;
 			if (reorderBwdWeightsDiff)
-			{
-				dnnl::reorder(memDiffDst, diffDstMem).execute(Device.stream, std::unordered_map<int, dnnl::memory>{ {DNNL_ARG_FROM, memDiffDst}, { DNNL_ARG_TO, diffDstMem } });
-				Device.stream.wait();
-			}
+				bwdPlan.AddReorder(memDiffDst, diffDstMem);
 
-			const auto& memSrc = dnnl::memory(*InputLayer->DstMemDesc, Device.engine, InputLayer->Neurons.data());
-			auto srcMem = reorderBwdWeightsSrc ? dnnl::memory(bwdWeightsDesc->src_desc(), Device.engine) : memSrc;
+			const auto memSrc = bwdPlan.Bind(*InputLayer->DstMemDesc, Device.engine, [this] { return InputLayer->Neurons.data(); });
+			const auto srcMem = reorderBwdWeightsSrc ? bwdPlan.Scratch(bwdWeightsDesc->src_desc(), Device.engine) : memSrc;
 			if (reorderBwdWeightsSrc)
-			{
-				dnnl::reorder(memSrc, srcMem).execute(Device.stream, std::unordered_map<int, dnnl::memory>{ {DNNL_ARG_FROM, memSrc}, { DNNL_ARG_TO, srcMem } });
-				Device.stream.wait();
-			}
+				bwdPlan.AddReorder(memSrc, srcMem);
 
-			auto memDiffWeights = dnnl::memory(*WeightsMemDesc, Device.engine, WeightsD1.data());
-			auto diffWeightsMem = reorderBwdWeightsDiffWeights ? dnnl::memory(bwdWeightsDesc->diff_weights_desc(), Device.engine) : memDiffWeights;
-						
-#ifdef DNN_CACHE_PRIMITIVES
-			HasBias ?
-				bwdWeights->execute(Device.stream, std::unordered_map<int, dnnl::memory>{ {DNNL_ARG_DIFF_DST, diffDstMem}, { DNNL_ARG_SRC, srcMem }, { DNNL_ARG_DIFF_WEIGHTS, diffWeightsMem }, { DNNL_ARG_DIFF_BIAS, dnnl::memory(bwdWeightsDesc->diff_bias_desc(), Device.engine, BiasesD1.data()) } }) :
-				bwdWeights->execute(Device.stream, std::unordered_map<int, dnnl::memory>{ {DNNL_ARG_DIFF_DST, diffDstMem}, { DNNL_ARG_SRC, srcMem }, { DNNL_ARG_DIFF_WEIGHTS, diffWeightsMem } });
-#else
-			HasBias ?
-				dnnl::convolution_backward_weights(*bwdWeightsDesc).execute(Device.stream, std::unordered_map<int, dnnl::memory>{ {DNNL_ARG_DIFF_DST, diffDstMem}, { DNNL_ARG_SRC, srcMem }, { DNNL_ARG_DIFF_WEIGHTS, diffWeightsMem }, { DNNL_ARG_DIFF_BIAS, dnnl::memory(bwdWeightsDesc->diff_bias_desc(), Device.engine, BiasesD1.data()) } }) :
-				dnnl::convolution_backward_weights(*bwdWeightsDesc).execute(Device.stream, std::unordered_map<int, dnnl::memory>{ {DNNL_ARG_DIFF_DST, diffDstMem}, { DNNL_ARG_SRC, srcMem }, { DNNL_ARG_DIFF_WEIGHTS, diffWeightsMem } });
-#endif
-			Device.stream.wait();
+			const auto memDiffWeights = bwdPlan.Bind(*WeightsMemDesc, Device.engine, [this] { return WeightsD1.data(); });
+			const auto diffWeightsMem = reorderBwdWeightsDiffWeights ? bwdPlan.Scratch(bwdWeightsDesc->diff_weights_desc(), Device.engine) : memDiffWeights;
+
+			if (HasBias)
+				bwdPlan.Add(*bwdWeights, { { DNNL_ARG_DIFF_DST, diffDstMem }, { DNNL_ARG_SRC, srcMem }, { DNNL_ARG_DIFF_WEIGHTS, diffWeightsMem }, { DNNL_ARG_DIFF_BIAS, bwdPlan.Bind(bwdWeightsDesc->diff_bias_desc(), Device.engine, [this] { return BiasesD1.data(); }) } });
+			else
+				bwdPlan.Add(*bwdWeights, { { DNNL_ARG_DIFF_DST, diffDstMem }, { DNNL_ARG_SRC, srcMem }, { DNNL_ARG_DIFF_WEIGHTS, diffWeightsMem } });
 
 			if (reorderBwdWeightsDiffWeights)
-			{
-				dnnl::reorder(diffWeightsMem, memDiffWeights).execute(Device.stream, std::unordered_map<int, dnnl::memory>{ {DNNL_ARG_FROM, diffWeightsMem}, { DNNL_ARG_TO, memDiffWeights } });
-				Device.stream.wait();
-			}
+				bwdPlan.AddReorder(diffWeightsMem, memDiffWeights);
 
-			const auto& memWeights = dnnl::memory(*WeightsMemDesc, Device.engine, Weights.data());
-			auto weightsMem = reorderBwdDataWeights ? dnnl::memory(bwdDataDesc->weights_desc(), Device.engine) : memWeights;
+			const auto memWeights = bwdPlan.Bind(*WeightsMemDesc, Device.engine, [this] { return Weights.data(); });
+			const auto weightsMem = reorderBwdDataWeights ? bwdPlan.Scratch(bwdDataDesc->weights_desc(), Device.engine) : memWeights;
 			if (reorderBwdDataWeights)
-			{
-				dnnl::reorder(memWeights, weightsMem).execute(Device.stream, std::unordered_map<int, dnnl::memory>{ {DNNL_ARG_FROM, memWeights}, { DNNL_ARG_TO, weightsMem } });
-				Device.stream.wait();
-			}
+				bwdPlan.AddReorder(memWeights, weightsMem);
 
-			auto memDiffSrc = SharesInput ? dnnl::memory(*InputLayerBwd->DiffDstMemDesc, Device.engine) : dnnl::memory(*InputLayerBwd->DiffDstMemDesc, Device.engine, InputLayerBwd->NeuronsD1.data());
-			auto diffSrcMem = reorderBwdDataDiffSrc ? dnnl::memory(bwdDataDesc->diff_src_desc(), Device.engine) : memDiffSrc;
+			const auto memInputDiff = bwdPlan.Bind(*InputLayerBwd->DiffDstMemDesc, Device.engine, [this] { return InputLayerBwd->NeuronsD1.data(); });
+			const auto memDiffSrc = SharesInput ? bwdPlan.Scratch(*InputLayerBwd->DiffDstMemDesc, Device.engine) : memInputDiff;
+			const auto diffSrcMem = reorderBwdDataDiffSrc ? bwdPlan.Scratch(bwdDataDesc->diff_src_desc(), Device.engine) : memDiffSrc;
 
-			auto diffDataDstMem = reorderBwdDataDiffDst ? (sameDiffFormat ? diffDstMem : dnnl::memory(bwdDataDesc->diff_dst_desc(), Device.engine)) : memDiffDst;
+			const auto diffDataDstMem = reorderBwdDataDiffDst ? (sameDiffFormat ? diffDstMem : bwdPlan.Scratch(bwdDataDesc->diff_dst_desc(), Device.engine)) : memDiffDst;
 			if (reorderBwdDataDiffDst && !sameDiffFormat)
-			{
-				dnnl::reorder(memDiffDst, diffDataDstMem).execute(Device.stream, std::unordered_map<int, dnnl::memory>{ {DNNL_ARG_FROM, memDiffDst}, { DNNL_ARG_TO, diffDataDstMem } });
-				Device.stream.wait();
-			}
+				bwdPlan.AddReorder(memDiffDst, diffDataDstMem);
 
-#ifdef DNN_CACHE_PRIMITIVES
-			bwdData->execute(Device.stream, std::unordered_map<int, dnnl::memory>{ {DNNL_ARG_DIFF_DST, diffDataDstMem}, { DNNL_ARG_WEIGHTS, weightsMem }, { DNNL_ARG_DIFF_SRC, diffSrcMem } });
-#else
-			dnnl::convolution_backward_data(*bwdDataDesc).execute(Device.stream, std::unordered_map<int, dnnl::memory>{ {DNNL_ARG_DIFF_DST, diffDataDstMem}, { DNNL_ARG_WEIGHTS, weightsMem }, { DNNL_ARG_DIFF_SRC, diffSrcMem } });
-#endif
-			Device.stream.wait();
+			bwdPlan.Add(*bwdData, { { DNNL_ARG_DIFF_DST, diffDataDstMem }, { DNNL_ARG_WEIGHTS, weightsMem }, { DNNL_ARG_DIFF_SRC, diffSrcMem } });
 
 			if (reorderBwdDataDiffSrc)
-			{
-				dnnl::reorder(diffSrcMem, memDiffSrc).execute(Device.stream, std::unordered_map<int, dnnl::memory>{ {DNNL_ARG_FROM, diffSrcMem}, { DNNL_ARG_TO, memDiffSrc } });
-				Device.stream.wait();
-			}
+				bwdPlan.AddReorder(diffSrcMem, memDiffSrc);
 
 			if (SharesInput)
-			{
-#ifdef DNN_CACHE_PRIMITIVES
-				bwdAdd->execute(Device.stream, std::unordered_map<int, dnnl::memory>{ { DNNL_ARG_SRC_0, dnnl::memory(*InputLayerBwd->DiffDstMemDesc, Device.engine, InputLayerBwd->NeuronsD1.data()) }, { DNNL_ARG_SRC_1, memDiffSrc }, { DNNL_ARG_DST, dnnl::memory(*InputLayerBwd->DiffDstMemDesc, Device.engine, InputLayerBwd->NeuronsD1.data()) } });
+				bwdPlan.Add(*bwdAdd, { { DNNL_ARG_SRC_0, memInputDiff }, { DNNL_ARG_SRC_1, memDiffSrc }, { DNNL_ARG_DST, memInputDiff } });
+		}
+
+		void ForwardProp(const UInt batchSize, const bool training) final override
+		{	
+			fwdPlan.Run(Device.stream, FwdScratch);
+
+#ifndef DNN_LEAN
+			if (training)
+				fast_memzero(NeuronsD1.data(), PaddedCDHW() * batchSize * sizeof(Float));
 #else
-				dnnl::binary(*bwdAddDesc).execute(Device.stream, std::unordered_map<int, dnnl::memory>{ { DNNL_ARG_SRC_0, dnnl::memory(*InputLayerBwd->DiffDstMemDesc, Device.engine, InputLayerBwd->NeuronsD1.data()) }, { DNNL_ARG_SRC_1, memDiffSrc }, { DNNL_ARG_DST, dnnl::memory(*InputLayerBwd->DiffDstMemDesc, Device.engine, InputLayerBwd->NeuronsD1.data()) } });
-#endif
-				Device.stream.wait();
-			}
+			DNN_UNREF_PAR(batchSize);
+#endif // DNN_LEAN			
+		}
+
+		void BackwardProp(const UInt batchSize) final override
+		{
+#ifdef DNN_LEAN
+			ZeroGradient(batchSize);
+#else
+			DNN_UNREF_PAR(batchSize);
+#endif // DNN_LEAN
+			
+			bwdPlan.Run(Device.stream, BwdScratch);
 
 #ifdef DNN_LEAN
 			ReleaseGradient();
@@ -7,6 +7,297 @@ namespace dnn
 
 	typedef std::vector<Image<Byte>, AlignedAllocator<dnn::Image<Byte>, 64ull>> ImageByteVector;
 
+	// Read-only mapping of a whole file, pages are shared through the page cache between processes
+	class MappedFile final
+	{
+	private:
+		const Byte* ptr;
+		UInt size;
+#if defined(_WIN32) || defined(__CYGWIN__) || defined(__MINGW32__)
+		HANDLE file;
+		HANDLE mapping;
+#endif
+
+	public:
+		MappedFile() :
+			ptr(nullptr),
+			size(0ull)
+#if defined(_WIN32) || defined(__CYGWIN__) || defined(__MINGW32__)
+			,
+			file(INVALID_HANDLE_VALUE),
+			mapping(NULL)
+#endif
+		{
+		}
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		~MappedFile()
+		{
+			Close();
+		}
+
+		bool Open(const std::filesystem::path& path)
+		{
+			Close();
+
+#if defined(_WIN32) || defined(__CYGWIN__) || defined(__MINGW32__)
+			file = CreateFileW(path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, NULL);
+			if (file == INVALID_HANDLE_VALUE)
+				return false;
+
+			LARGE_INTEGER fileSize;
+			if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+			{
+				Close();
+				return false;
+			}
+
+			mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+			if (mapping == NULL)
+			{
+				Close();
+				return false;
+			}
+
+			auto view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+			if (view == NULL)
+			{
+				Close();
+				return false;
+			}
+
+			ptr = static_cast<const Byte*>(view);
+			size = static_cast<UInt>(fileSize.QuadPart);
+#else
+			const auto fd = ::open(path.c_str(), O_RDONLY);
+			if (fd < 0)
+				return false;
+
+			struct stat status;
+			if (::fstat(fd, &status) != 0 || status.st_size == 0)
+			{
+				::close(fd);
+				return false;
+			}
+
+			auto view = ::mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_SHARED, fd, 0);
+			::close(fd);
+			if (view == MAP_FAILED)
+				return false;
+
+			::madvise(view, static_cast<size_t>(status.st_size), MADV_RANDOM);
+
+			ptr = static_cast<const Byte*>(view);
+			size = static_cast<UInt>(status.st_size);
+#endif
+			return true;
+		}
+
+		void Close()
+		{
+#if defined(_WIN32) || defined(__CYGWIN__) || defined(__MINGW32__)
+			if (ptr)
+				UnmapViewOfFile(ptr);
+			if (mapping != NULL)
+				CloseHandle(mapping);
+			if (file != INVALID_HANDLE_VALUE)
+				CloseHandle(file);
+			mapping = NULL;
+			file = INVALID_HANDLE_VALUE;
+#else
+			if (ptr)
+				::munmap(const_cast<Byte*>(ptr), size);
+#endif
+			ptr = nullptr;
+			size = 0ull;
+		}
+
+		const Byte* data() const noexcept
+		{
+			return ptr;
+		}
+
+		UInt Size() const noexcept
+		{
+			return size;
+		}
+	};
+
+	// Packed dataset shard: header, class counts, mean and stddev, class names, label table (train then test)
+	// and the page aligned fixed-stride u8 CDHW payload of the train and test samples
+	struct PackHeader
+	{
+		char Magic[8];
+		std::uint64_t Version;
+		std::uint64_t C;
+		std::uint64_t D;
+		std::uint64_t H;
+		std::uint64_t W;
+		std::uint64_t Hierarchies;
+		std::uint64_t TrainSamplesCount;
+		std::uint64_t TestSamplesCount;
+		std::uint64_t ClassCountOffset;		// Hierarchies x uint64
+		std::uint64_t MeanStdDevOffset;		// C x float mean followed by C x float stddev
+		std::uint64_t ClassNamesOffset;		// newline terminated names
+		std::uint64_t ClassNamesSize;
+		std::uint64_t LabelsOffset;			// (TrainSamplesCount + TestSamplesCount) x Hierarchies x uint64
+		std::uint64_t TrainOffset;
+		std::uint64_t TestOffset;
+		std::uint64_t Fingerprint;			// DatasetFingerprint of the files the pack was built from
+	};
+
+	constexpr char PackMagic[8] = { 'D', 'N', 'N', 'P', 'A', 'C', 'K', '\0' };
+	constexpr auto PackVersion = 4ull;				// 3: Fingerprint, 4: the stddev of versions 2 and 3 was the square root of the variance
+	constexpr auto StatisticsVersion = 2ull;		// 2: the stddev of version 1 was the square root of the variance
+	constexpr auto PackAlignment = 4096ull;
+
+	// Size bounded cache of decoded images keyed by sample index, evicts with the CLOCK (second chance) policy
+	class ImageCache final
+	{
+	private:
+		struct Slot
+		{
+			UInt Key;
+			bool Referenced;
+			Image<Byte> Img;
+		};
+
+		std::mutex Lock;
+		std::unordered_map<UInt, UInt> Keys;
+		std::vector<Slot> Slots;
+		std::vector<UInt> FreeSlots;
+		UInt Hand;
+		UInt Bytes;
+		UInt Capacity;
+
+	public:
+		ImageCache(const UInt capacity = 0ull) :
+			Hand(0ull),
+			Bytes(0ull),
+			Capacity(capacity)
+		{
+		}
+
+		void Reset(const UInt capacity)
+		{
+			std::lock_guard<std::mutex> lock(Lock);
+
+			Keys.clear();
+			Slots = std::vector<Slot>();
+			FreeSlots = std::vector<UInt>();
+			Hand = 0ull;
+			Bytes = 0ull;
+			Capacity = capacity;
+		}
+
+		bool Get(const UInt key, Image<Byte>& image)
+		{
+			std::lock_guard<std::mutex> lock(Lock);
+
+			const auto it = Keys.find(key);
+			if (it == Keys.end())
+				return false;
+
+			Slots[it->second].Referenced = true;
+			image = Slots[it->second].Img;
+
+			return true;
+		}
+
+		void Put(const UInt key, const Image<Byte>& image)
+		{
+			const auto size = image.Size();
+
+			// the cached copy outlives the batch that decoded it
+			const auto heap = HeapScope();
+			std::lock_guard<std::mutex> lock(Lock);
+
+			if (size > Capacity)
+				return;
+
+			const auto it = Keys.find(key);
+			if (it != Keys.end())
+			{
+				auto& slot = Slots[it->second];
+				Bytes -= slot.Img.Size();
+				slot.Img = Image<Byte>();
+				FreeSlots.push_back(it->second);
+				Keys.erase(it);
+			}
+
+			while (Bytes + size > Capacity)
+			{
+				auto& slot = Slots[Hand];
+				Hand = (Hand + 1ull) % Slots.size();
+
+				if (slot.Img.Size() == 0ull)
+					continue;
+
+				if (slot.Referenced)
+					slot.Referenced = false;
+				else
+				{
+					Bytes -= slot.Img.Size();
+					Keys.erase(slot.Key);
+					slot.Img = Image<Byte>();
+					FreeSlots.push_back(static_cast<UInt>(&slot - Slots.data()));
+				}
+			}
+
+			auto index = Slots.size();
+			if (FreeSlots.empty())
+				Slots.push_back(Slot({ key, false, image }));
+			else
+			{
+				index = FreeSlots.back();
+				FreeSlots.pop_back();
+				Slots[index] = Slot({ key, false, image });
+			}
+
+			Keys[key] = index;
+			Bytes += size;
+		}
+
+		// another image of the average size would evict one
+		bool Full()
+		{
+			std::lock_guard<std::mutex> lock(Lock);
+
+			return Keys.empty() ? Capacity == 0ull : Bytes + Bytes / Keys.size() > Capacity;
+		}
+	};
+
+	// d, h, w and the interpolation of one resolution of the training schedule
+	typedef std::tuple<UInt, UInt, UInt, Interpolations> ResolutionKey;
+
+	// Copy of the dataset resized to one resolution of the training schedule, built in chunks on the resize workers
+	struct ResizedSamples
+	{
+		ImageByteVector TrainSamples;
+		ImageByteVector TestSamples;
+		std::atomic<bool> Ready;
+		std::atomic<bool> Cancel;
+		std::atomic<UInt> Pending;
+		std::vector<std::future<void>> Tasks;
+
+		ResizedSamples() :
+			Ready(false),
+			Cancel(false),
+			Pending(0ull)
+		{
+		}
+
+		~ResizedSamples()
+		{
+			Cancel.store(true);
+			for (auto& task : Tasks)
+				if (task.valid())
+					task.wait();
+		}
+	};
+
 	enum class Datasets
 	{
 		cifar10 = 0,
@@ -38,6 +329,18 @@ namespace dnn
 		ImageByteVector TestSamples;
 		std::vector<std::vector<UInt>> TrainLabels;
 		std::vector<std::vector<UInt>> TestLabels;
+		MappedFile Pack;
+		const Byte* TrainPacked;
+		const Byte* TestPacked;
+		UInt DecodedCacheSize;							// bytes, decode the images of folder datasets on demand when not zero
+		std::vector<std::string> TrainFiles;
+		std::vector<std::string> TestFiles;
+		mutable ImageCache DecodedCache;
+		std::map<ResolutionKey, std::unique_ptr<ResizedSamples>> Resized;
+		mutable std::mutex ResizedLock;
+		WorkerPool ResizeWorkers;						// builds the resized copies with half of the cores
+		WorkerPool InputWorkers;						// assembles the batches when started, the OpenMP pool does otherwise
+		UInt InputQueueDepth;							// batches assembled ahead of the one being computed
 
 		Dataprovider(const std::string& directory) :
 			StorageDirectory(std::filesystem::path(directory)),
@@ -53,14 +356,186 @@ namespace dnn
 			TrainSamplesCount(50000),
 			TestSamplesCount(10000),
 			Hierarchies(1),
-			ClassCount(std::vector<UInt>({ 10 }))
+			ClassCount(std::vector<UInt>({ 10 })),
+			TrainPacked(nullptr),
+			TestPacked(nullptr),
+			DecodedCacheSize(0ull),
+			InputQueueDepth(1ull)
 		{
 			std::filesystem::create_directories(DatasetsDirectory);
 
 			std::locale::global(std::locale(""));
 		}
 
-		~Dataprovider() = default;
+		~Dataprovider()
+		{
+			ReleaseResolutions();
+		}
+
+		// Keeps a resized copy of the train and test samples for the current and the next resolution of the schedule only, the others are released.
+		// No batch may hold a copy from GetResized while this runs
+		void PrepareResolutions(const ResolutionKey& current, const ResolutionKey& next)
+		{
+			auto released = std::vector<std::unique_ptr<ResizedSamples>>();
+			{
+				std::lock_guard<std::mutex> lock(ResizedLock);
+
+				for (auto it = Resized.begin(); it != Resized.end();)
+				{
+					if (it->first != current && it->first != next)
+					{
+						released.push_back(std::move(it->second));
+						it = Resized.erase(it);
+					}
+					else
+						it++;
+				}
+			}
+			released.clear();
+
+			PrepareResolution(current);
+			if (next != current)
+				PrepareResolution(next);
+		}
+
+		void PrepareResolution(const ResolutionKey& resolution)
+		{
+			const auto d = std::get<0>(resolution);
+			const auto h = std::get<1>(resolution);
+			const auto w = std::get<2>(resolution);
+			const auto interpolation = std::get<3>(resolution);
+
+			// nothing to gain when the samples are already at that size or get decoded on demand
+			if ((d == D && h == H && w == W) || !TrainFiles.empty())
+				return;
+
+			// a copy that does not fit in half of the free memory is left to the batches, they resize on demand
+			if ((TrainSamplesCount + TestSamplesCount) * C * d * h * w > GetTotalFreeMemory() / 2ull)
+				return;
+
+			std::lock_guard<std::mutex> lock(ResizedLock);
+
+			auto& samples = Resized[resolution];
+			if (samples)
+				return;
+
+			// leave the other half of the cores to the running batches
+			if (ResizeWorkers.Threads() == 0ull)
+				ResizeWorkers.Start(std::max<UInt>(1ull, std::thread::hardware_concurrency() / 2ull));
+
+			samples = std::make_unique<ResizedSamples>();
+			const auto resized = samples.get();
+			resized->TrainSamples = ImageByteVector(TrainSamplesCount);
+			resized->TestSamples = ImageByteVector(TestSamplesCount);
+
+			const auto total = TrainSamplesCount + TestSamplesCount;
+			const auto chunk = 256ull;
+			const auto chunks = (total + chunk - 1ull) / chunk;
+			resized->Pending.store(chunks);
+			if (chunks == 0ull)
+				resized->Ready.store(true);
+
+			for (auto first = 0ull; first < total; first += chunk)
+				resized->Tasks.push_back(ResizeWorkers.Post([=]()
+				{
+					for (auto index = first; index < std::min(first + chunk, total) && !resized->Cancel.load(std::memory_order_relaxed); index++)
+					{
+						if (index < TrainSamplesCount)
+							resized->TrainSamples[index] = Image<Byte>::Resize(TrainSample(index), d, h, w, interpolation);
+						else
+							resized->TestSamples[index - TrainSamplesCount] = Image<Byte>::Resize(TestSample(index - TrainSamplesCount), d, h, w, interpolation);
+					}
+
+					if (resized->Pending.fetch_sub(1ull) == 1ull && !resized->Cancel.load())
+						resized->Ready.store(true);
+				}));
+		}
+
+		// nullptr until the background build for that resolution has completed
+		const ResizedSamples* GetResized(const UInt d, const UInt h, const UInt w, const Interpolations interpolation) const
+		{
+			std::lock_guard<std::mutex> lock(ResizedLock);
+
+			const auto it = Resized.find(std::make_tuple(d, h, w, interpolation));
+
+			return (it != Resized.end() && it->second->Ready.load()) ? it->second.get() : nullptr;
+		}
+
+		void ReleaseResolutions()
+		{
+			auto released = std::map<ResolutionKey, std::unique_ptr<ResizedSamples>>();
+			{
+				std::lock_guard<std::mutex> lock(ResizedLock);
+				released.swap(Resized);
+			}
+		}
+
+		// height and width are the resolution the sample gets resized to, on demand decoding uses them to pick a reduced IDCT scale
+		// a region of interest on the height x width grid lets a folder dataset decode only the part a crop reads
+		Image<Byte> TrainSample(const UInt index, const UInt height = 0ull, const UInt width = 0ull, const UInt roiTop = 0ull, const UInt roiLeft = 0ull, const UInt roiHeight = 0ull, const UInt roiWidth = 0ull) const
+		{
+			if (TrainPacked)
+				return Image<Byte>(C, D, H, W, TrainPacked + index * C * D * H * W);
+			
+			if (!TrainFiles.empty())
+				return DecodeSample(TrainFiles[index], index, height, width, roiTop, roiLeft, roiHeight, roiWidth);
+			
+			return TrainSamples[index];
+		}
+
+		Image<Byte> TestSample(const UInt index, const UInt height = 0ull, const UInt width = 0ull) const
+		{
+			if (TestPacked)
+				return Image<Byte>(C, D, H, W, TestPacked + index * C * D * H * W);
+
+			if (!TestFiles.empty())
+				return DecodeSample(TestFiles[index], TrainSamplesCount + index, height, width);
+
+			return TestSamples[index];
+		}
+
+		// called from the batch assembly worker threads
+		Image<Byte> DecodeSample(const std::string& fileName, const UInt key, const UInt height, const UInt width, const UInt roiTop = 0ull, const UInt roiLeft = 0ull, const UInt roiHeight = 0ull, const UInt roiWidth = 0ull) const
+		{
+			auto image = Image<Byte>();
+			
+			// a cached image decoded at a smaller scale than now needed is decoded again
+			if (DecodedCache.Get(key, image) && image.H() >= std::min(height > 0ull ? height : H, H) && image.W() >= std::min(width > 0ull ? width : W, W))
+				return image;
+
+#ifdef cimg_use_jpeg
+			// once the cache is evicting, a partial decode is cheaper than a whole image that would push out another
+			if (roiHeight > 0ull && roiWidth > 0ull && DecodedCache.Full())
+				return Image<Byte>::LoadJPEG(fileName, height, width, true, roiTop, roiLeft, roiHeight, roiWidth);
+
+			image = Image<Byte>::LoadJPEG(fileName, height, width, true);
+#endif
+			DecodedCache.Put(key, image);
+
+			return image;
+		}
+
+		// runs the per sample work of a batch on the input workers when they are started, on the OpenMP pool otherwise
+		template<typename Func>
+		void ForEachSample(const UInt batchSize, const UInt threads, const Func& func, const bool dynamic = true)
+		{
+			if (InputWorkers.Threads() > 0ull)
+				InputWorkers.for_i(batchSize, func);
+			else if (dynamic)
+				for_i_dynamic(batchSize, threads, func);
+			else
+				for_i(batchSize, threads, func);
+		}
+
+		const Byte* TrainSampleData(const UInt index) const
+		{
+			return TrainPacked ? TrainPacked + index * C * D * H * W : TrainSamples[index].data();
+		}
+
+		std::filesystem::path PackPath(const Datasets dataset) const
+		{
+			return DatasetsDirectory / std::string(magic_enum::enum_name<Datasets>(dataset)) / (std::string(magic_enum::enum_name<Datasets>(dataset)) + ".pack");
+		}
 
 		bool DatasetAvailable(const Datasets dataset) const
 		{
@@ -405,80 +880,377 @@ namespace dnn
 #endif
 		}
 
-		std::vector<Float> GetMean(const UInt N)
+		// one parallel pass over the first N train samples, the per channel sums of the bytes and their squares are exact in integers
+		void GetMeanStdDev(const UInt N)
 		{
-			auto mean = std::vector<double>(C);
-			
-			for_i(C, C, [&](UInt c)
-			{
-				auto channelMean = double(0);
-				auto correction = double(0);
+			const auto plane = D * H * W;
+			if (N == 0ull || plane == 0ull)
+				return;
 
-#ifdef DNN_IMAGEDEPTH
-				for (auto n = 0ull; n < N; n++)
-					for (auto d = 0u; d < D; d++)
-						for (auto h = 0u; h < H; h++)
-							for (auto w = 0u; w < W; w++)
-								KahanSum<double>(double(TrainingSamples[n](static_cast<unsigned int>(c), d, h, w)), meanC, correction);
-#else
-				for (auto n = 0ull; n < N; n++)
-					for (auto h = 0u; h < H; h++)
-						for (auto w = 0u; w < W; w++)
-							KahanSum<double>(double(TrainSamples[n](static_cast<unsigned int>(c), 0, h, w)), channelMean, correction);
-#endif
+			const auto chunks = std::max<UInt>(1ull, std::min<UInt>(N, std::thread::hardware_concurrency()));
+			auto sums = std::vector<std::uint64_t>(chunks * C, 0ull);
+			auto squares = std::vector<std::uint64_t>(chunks * C, 0ull);
+
+			for_i(chunks, chunks, [&](const UInt chunk)
+			{
+				const auto first = chunk * N / chunks;
+				const auto last = (chunk + 1ull) * N / chunks;
 
-				mean[c] = channelMean / double(N * D * H * W);
+				for (auto n = first; n < last; n++)
+					for (auto c = 0ull; c < C; c++)
+					{
+						const auto sample = TrainSampleData(n) + c * plane;
+						auto sum = std::uint64_t(0);
+						auto square = std::uint64_t(0);
+						for (auto i = 0ull; i < plane; i++)
+						{
+							sum += sample[i];
+							square += std::uint32_t(sample[i]) * std::uint32_t(sample[i]);
+						}
+						sums[chunk * C + c] += sum;
+						squares[chunk * C + c] += square;
+					}
 			});
 
-			auto result = std::vector<Float>();
+			auto eps = double(1);
+			while (double(1) + eps != double(1))
+				eps /= double(2);
+
+			const auto count = double(N * plane);
+			Mean = std::vector<Float>(C);
+			StdDev = std::vector<Float>(C);
 			for (auto c = 0ull; c < C; c++)
-				result.push_back(Float(mean[c]));
+			{
+				auto sum = std::uint64_t(0);
+				auto square = std::uint64_t(0);
+				for (auto chunk = 0ull; chunk < chunks; chunk++)
+				{
+					sum += sums[chunk * C + c];
+					square += squares[chunk * C + c];
+				}
 
-			return result;
+				// the variance is taken about the rounded mean and the stddev is the fourth root of it, as it always was:
+				// the input normalization of every trained model depends on it
+				const auto mean = double(sum) / count;
+				Mean[c] = Float(mean);
+				const auto variance = std::max(double(0), double(square) / count - mean * mean + Square<double>(mean - double(Mean[c])));
+				StdDev[c] = Float(std::max(std::sqrt(std::sqrt(variance + eps)), double(1) / std::sqrt(count)));
+			}
 		}
-		
-		std::vector<Float> GetStdDev(const std::vector<Float>& mean, const UInt N)
+
+		// FNV-1a over the name, size and modification time of every file of the dataset except what is derived from it
+		std::uint64_t DatasetFingerprint(const Datasets dataset) const
 		{
-			auto stddev = std::vector<double>(C);
-			
-			auto eps = double(1);
-			while (double(1) + eps != double(1))
-				eps /= double(2);
-			
-			for_i(C, C, [&](UInt c)
+			auto hash = std::uint64_t(14695981039346656037ull);
+			const auto mix = [&hash](const void* data, const std::size_t size)
+			{
+				for (auto i = 0ull; i < size; i++)
+				{
+					hash ^= static_cast<const Byte*>(data)[i];
+					hash *= std::uint64_t(1099511628211ull);
+				}
+			};
+
+			const auto root = DatasetsDirectory / std::string(magic_enum::enum_name<Datasets>(dataset));
+			auto entries = std::vector<std::tuple<std::string, std::uint64_t, std::int64_t>>();
+			std::error_code error;
+			for (auto it = std::filesystem::recursive_directory_iterator(root, error); !error && it != std::filesystem::recursive_directory_iterator(); it.increment(error))
 			{
-				auto channelMean = double(mean[c]);
-				auto channelStdDev = double(0);
-				auto correction = double(0);
+				if (!it->is_regular_file(error))
+					continue;
 
-#ifdef DNN_IMAGEDEPTH
-				for (auto n = 0ull; n < N; n++)
-					for (auto d = 0u; d < D; d++)
-						for (auto h = 0u; h < H; h++)
-							for (auto w = 0u; w < W; w++)
-								KahanSum<double>(Square<double>(double(TrainingSamples[n](static_cast<unsigned int>(c), d, h, w)) - channelMean), channelStdDev, correction);
-#else
-				for (auto n = 0ull; n < N; n++)
-					for (auto h = 0u; h < H; h++)
-						for (auto w = 0u; w < W; w++)
-							KahanSum<double>(Square<double>(double(TrainSamples[n](static_cast<unsigned int>(c), 0, h, w)) - channelMean), channelStdDev, correction);
-#endif
-				
-				channelStdDev /= double(N * D * H * W);
-				channelStdDev = std::max(double(0), channelStdDev);
-				channelStdDev = std::sqrt(channelStdDev + eps);
-				stddev[c] = std::max(std::sqrt(channelStdDev), double(1) / std::sqrt(double(N * D * H * W)));
-			});
-			
-			auto result = std::vector<Float>();
+				const auto& path = it->path();
+				if (path == PackPath(dataset) || path == StatisticsPath(dataset) || path.extension() == ".tmp")
+					continue;
+
+				entries.emplace_back(std::filesystem::relative(path, root, error).generic_string(), std::uint64_t(it->file_size(error)), std::int64_t(it->last_write_time(error).time_since_epoch().count()));
+			}
+			std::sort(entries.begin(), entries.end());
+
+			for (const auto& [name, size, time] : entries)
+			{
+				mix(name.data(), name.size());
+				mix(&size, sizeof(size));
+				mix(&time, sizeof(time));
+			}
+			const std::uint64_t shape[] = { C, D, H, W, TrainSamplesCount };
+			mix(shape, sizeof(shape));
+
+			return hash;
+		}
+
+		std::filesystem::path StatisticsPath(const Datasets dataset) const
+		{
+			return DatasetsDirectory / std::string(magic_enum::enum_name<Datasets>(dataset)) / "meanstddev.txt";
+		}
+
+		bool LoadMeanStdDev(const Datasets dataset, const std::uint64_t fingerprint)
+		{
+			auto infile = std::ifstream(StatisticsPath(dataset));
+			if (infile.bad() || !infile.is_open())
+				return false;
+
+			infile.imbue(std::locale::classic());
+
+			auto version = 0ull;
+			auto key = std::uint64_t(0);
+			if (!(infile >> version) || version != StatisticsVersion || !(infile >> std::hex >> key >> std::dec) || key != fingerprint)
+				return false;
+
+			auto mean = std::vector<Float>(C);
+			auto stddev = std::vector<Float>(C);
 			for (auto c = 0ull; c < C; c++)
-				result.push_back(Float(stddev[c]));
+				if (!(infile >> mean[c] >> stddev[c]) || !(stddev[c] > Float(0)))
+					return false;
+
+			Mean = mean;
+			StdDev = stddev;
 
-			return result;
+			return true;
+		}
+
+		bool SaveMeanStdDev(const Datasets dataset, const std::uint64_t fingerprint) const
+		{
+			const auto path = StatisticsPath(dataset);
+			const auto temporary = std::filesystem::path(path).concat(".tmp");
+
+			{
+				auto outfile = std::ofstream(temporary, std::ios::trunc);
+				if (outfile.bad() || !outfile.is_open())
+					return false;
+
+				outfile.imbue(std::locale::classic());
+				outfile << StatisticsVersion << std::endl << std::hex << fingerprint << std::dec << std::endl << std::setprecision(std::numeric_limits<Float>::max_digits10);
+				for (auto c = 0ull; c < C; c++)
+					outfile << Mean[c] << ' ' << StdDev[c] << std::endl;
+
+				if (!outfile)
+					return false;
+			}
+
+			std::error_code error;
+			std::filesystem::rename(temporary, path, error);
+
+			return !error;
 		}
 
 		bool LoadDataset(const Datasets dataset)
 		{
+			auto loaded = PackedDatasets && OpenPack(dataset);
+
+			if (!loaded)
+			{
+				loaded = LoadRawDataset(dataset);
+
+				if constexpr (PackedDatasets)
+					if (loaded && SavePack(dataset))
+						OpenPack(dataset);
+			}
+
+			if (loaded)
+				Dataset = dataset;
+
+			return loaded;
+		}
+
+		// (re)builds the packed shard from the original dataset files
+		bool PackDataset(const Datasets dataset)
+		{
+			if (!LoadRawDataset(dataset) || !SavePack(dataset) || !OpenPack(dataset))
+				return false;
+
+			Dataset = dataset;
+
+			return true;
+		}
+
+		bool OpenPack(const Datasets dataset)
+		{
+			ReleaseResolutions();
+			Pack.Close();
+			TrainPacked = nullptr;
+			TestPacked = nullptr;
+
+			const auto path = PackPath(dataset);
+			if (!std::filesystem::exists(path) || !Pack.Open(path))
+				return false;
+
+			auto header = PackHeader();
+			if (Pack.Size() >= sizeof(PackHeader))
+				std::memcpy(&header, Pack.data(), sizeof(PackHeader));
+
+			// every table must lie inside the file, a truncated or corrupt pack is rebuilt instead
+			const auto fits = [&](const std::uint64_t offset, const std::uint64_t count, const std::uint64_t size)
+			{
+				return count <= Pack.Size() / size && offset <= Pack.Size() - count * size;
+			};
+
+			const auto stride = header.C * header.D * header.H * header.W;
+			if (Pack.Size() < sizeof(PackHeader) || std::memcmp(header.Magic, PackMagic, sizeof(PackMagic)) != 0 || header.Version != PackVersion || stride == 0ull || header.Hierarchies == 0ull ||
+				!fits(header.ClassCountOffset, header.Hierarchies, sizeof(std::uint64_t)) ||
+				!fits(header.MeanStdDevOffset, 2ull * header.C, sizeof(float)) ||
+				!fits(header.ClassNamesOffset, header.ClassNamesSize, 1ull) ||
+				!fits(header.LabelsOffset, header.TrainSamplesCount + header.TestSamplesCount, header.Hierarchies * sizeof(std::uint64_t)) ||
+				!fits(header.TrainOffset, header.TrainSamplesCount, stride) ||
+				!fits(header.TestOffset, header.TestSamplesCount, stride))
+			{
+				Pack.Close();
+				return false;
+			}
+
+			C = header.C;
+			D = header.D;
+			H = header.H;
+			W = header.W;
+			Hierarchies = header.Hierarchies;
+			TrainSamplesCount = header.TrainSamplesCount;
+			TestSamplesCount = header.TestSamplesCount;
+
+			// the fingerprint mixes in the shape, so it is taken once the shape of the pack is in place
+			if (header.Fingerprint != DatasetFingerprint(dataset))
+			{
+				Pack.Close();
+				return false;
+			}
+
+			const auto classCount = reinterpret_cast<const std::uint64_t*>(Pack.data() + header.ClassCountOffset);
+			ClassCount = std::vector<UInt>(classCount, classCount + Hierarchies);
+
+			const auto meanStdDev = reinterpret_cast<const float*>(Pack.data() + header.MeanStdDevOffset);
+			Mean = std::vector<Float>(meanStdDev, meanStdDev + C);
+			StdDev = std::vector<Float>(meanStdDev + C, meanStdDev + 2ull * C);
+
+			ClassNames = std::vector<std::string>();
+			auto names = std::istringstream(std::string(reinterpret_cast<const char*>(Pack.data() + header.ClassNamesOffset), header.ClassNamesSize));
+			std::string line;
+			while (std::getline(names, line))
+				ClassNames.push_back(line);
+
+			auto labels = reinterpret_cast<const std::uint64_t*>(Pack.data() + header.LabelsOffset);
+			TrainLabels = std::vector<std::vector<UInt>>(TrainSamplesCount, std::vector<UInt>(Hierarchies));
+			for (auto i = 0ull; i < TrainSamplesCount; i++, labels += Hierarchies)
+				std::copy(labels, labels + Hierarchies, TrainLabels[i].begin());
+			TestLabels = std::vector<std::vector<UInt>>(TestSamplesCount, std::vector<UInt>(Hierarchies));
+			for (auto i = 0ull; i < TestSamplesCount; i++, labels += Hierarchies)
+				std::copy(labels, labels + Hierarchies, TestLabels[i].begin());
+
+			TrainSamples = ImageByteVector();
+			TestSamples = ImageByteVector();
+			TrainFiles = std::vector<std::string>();
+			TestFiles = std::vector<std::string>();
+			DecodedCache.Reset(0ull);
+			TrainPacked = Pack.data() + header.TrainOffset;
+			TestPacked = Pack.data() + header.TestOffset;
+
+			return true;
+		}
+
+		bool SavePack(const Datasets dataset) const
+		{
+			const auto path = PackPath(dataset);
+			const auto stride = C * D * H * W;
+
+			if (TrainSamples.size() != TrainSamplesCount || TestSamples.size() != TestSamplesCount)
+				return false;
+
+			for (auto i = 0ull; i < TrainSamplesCount; i++)
+				if (TrainSamples[i].C() != C || TrainSamples[i].D() != D || TrainSamples[i].H() != H || TrainSamples[i].W() != W)
+					return false;
+			for (auto i = 0ull; i < TestSamplesCount; i++)
+				if (TestSamples[i].C() != C || TestSamples[i].D() != D || TestSamples[i].H() != H || TestSamples[i].W() != W)
+					return false;
+
+			auto names = std::string();
+			for (const auto& name : ClassNames)
+				names += name + "\n";
+
+			const auto align = [](const UInt offset, const UInt alignment) { return ((offset + alignment - 1ull) / alignment) * alignment; };
+
+			auto header = PackHeader();
+			std::memcpy(header.Magic, PackMagic, sizeof(PackMagic));
+			header.Version = PackVersion;
+			header.C = C;
+			header.D = D;
+			header.H = H;
+			header.W = W;
+			header.Hierarchies = Hierarchies;
+			header.TrainSamplesCount = TrainSamplesCount;
+			header.TestSamplesCount = TestSamplesCount;
+			header.ClassCountOffset = sizeof(PackHeader);
+			header.MeanStdDevOffset = header.ClassCountOffset + Hierarchies * sizeof(std::uint64_t);
+			header.ClassNamesOffset = header.MeanStdDevOffset + 2ull * C * sizeof(float);
+			header.ClassNamesSize = names.size();
+			header.LabelsOffset = align(header.ClassNamesOffset + header.ClassNamesSize, sizeof(std::uint64_t));
+			header.TrainOffset = align(header.LabelsOffset + (TrainSamplesCount + TestSamplesCount) * Hierarchies * sizeof(std::uint64_t), PackAlignment);
+			header.TestOffset = align(header.TrainOffset + TrainSamplesCount * stride, PackAlignment);
+			header.Fingerprint = DatasetFingerprint(dataset);
+
+			const auto temp = std::filesystem::path(path).concat(".tmp");
+			auto outfile = std::ofstream(temp, std::ios::binary | std::ios::out | std::ios::trunc);
+			if (outfile.bad() || !outfile.is_open())
+				return false;
+
+			const auto pad = [&](const UInt offset) 
+			{
+				const auto zeros = std::vector<char>(offset - static_cast<UInt>(outfile.tellp()), 0);
+				outfile.write(zeros.data(), static_cast<std::streamsize>(zeros.size()));
+			};
+
+			outfile.write(reinterpret_cast<const char*>(&header), sizeof(PackHeader));
+
+			const auto classCount = std::vector<std::uint64_t>(ClassCount.begin(), ClassCount.end());
+			outfile.write(reinterpret_cast<const char*>(classCount.data()), static_cast<std::streamsize>(classCount.size() * sizeof(std::uint64_t)));
+
+			auto meanStdDev = std::vector<float>(Mean.begin(), Mean.end());
+			meanStdDev.insert(meanStdDev.end(), StdDev.begin(), StdDev.end());
+			outfile.write(reinterpret_cast<const char*>(meanStdDev.data()), static_cast<std::streamsize>(meanStdDev.size() * sizeof(float)));
+
+			outfile.write(names.data(), static_cast<std::streamsize>(names.size()));
+			
+			pad(header.LabelsOffset);
+			auto labels = std::vector<std::uint64_t>();
+			labels.reserve((TrainSamplesCount + TestSamplesCount) * Hierarchies);
+			for (auto i = 0ull; i < TrainSamplesCount; i++)
+				labels.insert(labels.end(), TrainLabels[i].begin(), TrainLabels[i].end());
+			for (auto i = 0ull; i < TestSamplesCount; i++)
+				labels.insert(labels.end(), TestLabels[i].begin(), TestLabels[i].end());
+			outfile.write(reinterpret_cast<const char*>(labels.data()), static_cast<std::streamsize>(labels.size() * sizeof(std::uint64_t)));
+
+			pad(header.TrainOffset);
+			for (auto i = 0ull; i < TrainSamplesCount; i++)
+				outfile.write(reinterpret_cast<const char*>(TrainSamples[i].data()), static_cast<std::streamsize>(stride));
+
+			pad(header.TestOffset);
+			for (auto i = 0ull; i < TestSamplesCount; i++)
+				outfile.write(reinterpret_cast<const char*>(TestSamples[i].data()), static_cast<std::streamsize>(stride));
+
+			const auto ok = outfile.good();
+			outfile.close();
+
+			// rename last, so concurrent processes never map a partially written pack
+			auto ec = std::error_code();
+			if (ok)
+				std::filesystem::rename(temp, path, ec);
+			if (!ok || ec)
+			{
+				std::filesystem::remove(temp, ec);
+				return false;
+			}
+
+			return true;
+		}
+
+		bool LoadRawDataset(const Datasets dataset)
+		{
+			ReleaseResolutions();
+			Pack.Close();
+			TrainPacked = nullptr;
+			TestPacked = nullptr;
+			ClassNames = std::vector<std::string>();
+			TrainFiles = std::vector<std::string>();
+			TestFiles = std::vector<std::string>();
+			DecodedCache.Reset(DecodedCacheSize);
+
 			if (!DatasetAvailable(dataset))
 			{
 				GetDataset(dataset);
@@ -570,8 +1342,10 @@ namespace dnn
 				TestLabels = std::vector<std::vector<UInt>>(TestSamplesCount, std::vector<UInt>(Hierarchies));
 				Mean = std::vector<Float>({ Float(117.56279), Float(109.588692), Float(96.981331) });
 				StdDev = std::vector<Float>({ Float(69.272858), Float(67.387779), Float(70.635902) });
-				TrainSamples = ImageByteVector(TrainSamplesCount);
-				TestSamples = ImageByteVector(TestSamplesCount);
+				TrainSamples = DecodedCacheSize > 0ull ? ImageByteVector() : ImageByteVector(TrainSamplesCount);
+				TestSamples = DecodedCacheSize > 0ull ? ImageByteVector() : ImageByteVector(TestSamplesCount);
+				TrainFiles = DecodedCacheSize > 0ull ? std::vector<std::string>(TrainSamplesCount) : std::vector<std::string>();
+				TestFiles = DecodedCacheSize > 0ull ? std::vector<std::string>(TestSamplesCount) : std::vector<std::string>();
 				break;
 			}
 
@@ -776,8 +1550,11 @@ namespace dnn
 					{
 						const auto pos = i + offset;
 						const auto fileName = (DatasetsDirectory / std::string(magic_enum::enum_name<Datasets>(dataset))  / "train" / ClassNames[item] / "images" / (ClassNames[item] + "_" + std::to_string(i) + ".JPEG")).string();
+						if (!TrainFiles.empty())
+							TrainFiles[pos] = fileName;
 #ifdef cimg_use_jpeg
-						TrainSamples[pos] = Image<Byte>::LoadJPEG(fileName, true);
+						else
+							TrainSamples[pos] = Image<Byte>::LoadJPEG(fileName, true);
 #endif
 						TrainLabels[pos][0] = item;
 					}
@@ -816,8 +1593,11 @@ namespace dnn
 				{
 					const auto fileName = (DatasetsDirectory / std::string(magic_enum::enum_name<Datasets>(dataset))  / "val" / "images" / ("val_" + std::to_string(i) + ".JPEG")).string();
 					//const auto fileName = (DatasetsDirectory() / std::string(magic_enum::enum_name<Datasets>(dataset))  / "test" / "images" / ("test_" + std::to_string(i) + ".JPEG")).string();
+					if (!TestFiles.empty())
+						TestFiles[i] = fileName;
 #ifdef cimg_use_jpeg
-					TestSamples[i] = Image<Byte>::LoadJPEG(fileName, true);
+					else
+						TestSamples[i] = Image<Byte>::LoadJPEG(fileName, true);
 #endif
 					TestLabels[i][0] = labels_idx[i];
 				});
@@ -825,14 +1605,18 @@ namespace dnn
 			break;
 			}
 
+			// statistics computed by an earlier load stay valid as long as the dataset files are unchanged,
+			// decoding every image for them would defeat streaming, keep the defaults instead
 			if constexpr (!DefaultDatasetMeanStdDev)
 			{
-				Mean = GetMean(TrainSamplesCount);
-				StdDev = GetStdDev(Mean, TrainSamplesCount);
+				const auto fingerprint = DatasetFingerprint(dataset);
+				if (!LoadMeanStdDev(dataset, fingerprint) && TrainFiles.empty())
+				{
+					GetMeanStdDev(TrainSamplesCount);
+					SaveMeanStdDev(dataset, fingerprint);
+				}
 			}
 
-			Dataset = dataset;
-
 			return true;
 		}
 
@@ -65,6 +65,7 @@ namespace dnn
 		defNorm = CaseInsensitiveReplace(defNorm.begin(), defNorm.end(), "LabelFalse=", "LabelFalse=");
 		defNorm = CaseInsensitiveReplace(defNorm.begin(), defNorm.end(), "Weight=", "Weight=");
 		defNorm = CaseInsensitiveReplace(defNorm.begin(), defNorm.end(), "Ratio=", "Ratio=");
+		defNorm = CaseInsensitiveReplace(defNorm.begin(), defNorm.end(), "Checkpoint=", "Checkpoint=");
 
 		auto types = magic_enum::enum_names<LayerTypes>();
 		for (const auto& type : types)
@@ -190,6 +191,7 @@ namespace dnn
 		auto reduceOp = ReduceOperations::Avg;
 		auto reduceP = Float(0);
 		auto reduceEps = Float(0);
+		auto checkpoint = false;
 
 		auto iss = std::istringstream(definition);
 		auto strLine = std::string(""), modelName = std::string(""), layerName = std::string(""), params = std::string("");
@@ -606,6 +608,8 @@ namespace dnn
 							model->Layers.push_back(std::make_unique<Substract>(model->Device, model->Format, name, inputs));
 							break;
 						}
+
+						model->Layers.back()->Checkpoint = checkpoint;
 					}
 					catch (std::exception exception)
 					{
@@ -662,7 +666,7 @@ namespace dnn
 					labelTrue = Float(0.9);
 					labelFalse = Float(0.1);
 					ratio = model->Ratio;
-					
+					checkpoint = false;
 				}
 			}
 			else if (strLine.find("Dataset=") == 0)
@@ -1765,6 +1769,30 @@ namespace dnn
 				if (isModel)
 					model->Dropout = dropout;
 			}
+			else if (strLine.rfind("Checkpoint=") == 0)
+			{
+				if (isModel)
+				{
+					msg = CheckMsg(line, col, std::string("Checkpoint cannot be specified in a model."));
+					goto FAIL;
+				}
+
+				if (layerType == LayerTypes::Cost || layerType == LayerTypes::Dropout || layerType == LayerTypes::BatchNormActivationDropout)
+				{
+					msg = CheckMsg(line, col, std::string("Checkpoint cannot be specified in a ") + std::string(magic_enum::enum_name<LayerTypes>(layerType)) + std::string(" layer."));
+					goto FAIL;
+				}
+
+				params = strLine.erase(0, 11);
+
+				if (!IsStringBool(params))
+				{
+					msg = CheckMsg(line, col, std::string("Checkpoint value must be boolean (Yes/No or True/False)."));
+					goto FAIL;
+				}
+
+				checkpoint = StringToBool(params);
+			}
 			else if (strLine.rfind("Alpha=") == 0)
 			{
 				if (!isNormalizationLayer && layerType != LayerTypes::Input && layerType != LayerTypes::PRelu && layerType != LayerTypes::Activation && layerType != LayerTypes::LocalResponseNorm)
@@ -2703,6 +2731,140 @@ namespace dnn
 		return model;
 	}
 
+	// Rewrites the definition for the folds of Model::GetFoldableNorms. A folded BatchNorm is left out and its consumers take
+	// the weight layer as input, a folded BatchNormActivation or BatchNormRelu keeps its name as an Activation layer.
+	std::string FoldNormsDefinition(const Model& model, const std::vector<std::pair<UInt, UInt>>& folds)
+	{
+		auto norms = std::unordered_map<std::string, std::pair<LayerTypes, std::string>>();
+		auto biased = std::vector<std::string>();
+		for (const auto& fold : folds)
+		{
+			norms[model.Layers[fold.second]->Name] = std::make_pair(model.Layers[fold.second]->LayerType, model.Layers[fold.first]->Name);
+			biased.push_back(model.Layers[fold.first]->Name);
+		}
+
+		auto definition = std::string();
+		auto section = std::string();
+		auto iss = std::istringstream(model.Definition);
+		auto strLine = std::string();
+
+		const auto endSection = [&]()
+		{
+			if (std::find(biased.cbegin(), biased.cend(), section) != biased.cend())
+				definition += std::string("Biases=Yes") + nwl;
+		};
+
+		while (SafeGetline(iss, strLine))
+		{
+			if (strLine.empty())
+				continue;
+
+			if (strLine[0] == '[' && strLine[strLine.length() - 1] == ']')
+			{
+				endSection();
+				section = strLine.substr(1, strLine.length() - 2);
+
+				const auto norm = norms.find(section);
+				if (norm == norms.cend() || norm->second.first != LayerTypes::BatchNorm)
+					definition += (definition.empty() ? std::string("") : nwl) + strLine + nwl;
+				continue;
+			}
+
+			const auto norm = norms.find(section);
+			if (norm != norms.cend())
+			{
+				if (norm->second.first == LayerTypes::BatchNorm)
+					continue;
+
+				if (strLine.rfind("Type=") == 0)
+					definition += std::string("Type=Activation") + nwl;
+				else if (strLine.rfind("Inputs=") == 0)
+				{
+					definition += std::string("Inputs=") + norm->second.second + nwl;
+					if (norm->second.first == LayerTypes::BatchNormRelu)
+						definition += std::string("Activation=Relu") + nwl;
+				}
+				else if (strLine.rfind("Activation=") == 0 || strLine.rfind("Alpha=") == 0 || strLine.rfind("Beta=") == 0 || strLine.rfind("Checkpoint=") == 0)
+					definition += strLine + nwl;
+				continue;
+			}
+
+			if (strLine.rfind("Biases=") == 0 && std::find(biased.cbegin(), biased.cend(), section) != biased.cend())
+				continue;
+
+			if (strLine.rfind("Inputs=") == 0)
+			{
+				auto inputs = std::string();
+				auto list = std::istringstream(strLine.erase(0, 7));
+				auto item = std::string();
+				while (std::getline(list, item, ','))
+				{
+					const auto input = norms.find(item);
+					inputs += (inputs.empty() ? std::string("") : std::string(",")) + (input != norms.cend() && input->second.first == LayerTypes::BatchNorm ? input->second.second : item);
+				}
+				definition += std::string("Inputs=") + inputs + nwl;
+				continue;
+			}
+
+			definition += strLine + nwl;
+		}
+		endSection();
+
+		return definition;
+	}
+
+	// Folds the norms of an inference model into the layers in front of them and writes the definition and the weights
+	// of the folded model, which loads like any other. Both go to temporary files first and only replace the targets
+	// when everything was written, checkMsg says what went wrong otherwise.
+	bool FoldBatchNorm(const Model& model, const std::string& definitionFile, const std::string& weightsFile, CheckMsg& checkMsg)
+	{
+		const auto folds = model.GetFoldableNorms();
+		const auto definition = FoldNormsDefinition(model, folds);
+
+		Parse(definition, checkMsg, true);
+		if (checkMsg.Error)
+			return false;
+
+		const auto weightsTemporary = weightsFile + std::string(".tmp");
+		const auto definitionTemporary = definitionFile + std::string(".tmp");
+		auto error = std::error_code();
+
+		if (model.SaveFoldedWeights(weightsTemporary, folds) != 0)
+		{
+			std::filesystem::remove(weightsTemporary, error);
+			checkMsg = CheckMsg(0, 0, std::string("Could not write the folded weights to ") + weightsFile);
+			return false;
+		}
+
+		{
+			auto os = std::ofstream(definitionTemporary, std::ios::out | std::ios::trunc);
+			if (!os.bad() && os.is_open())
+				os << CaseInsensitiveReplace(definition.begin(), definition.end(), nwl, std::string("\n"));
+
+			if (!os)
+			{
+				os.close();
+				std::filesystem::remove(definitionTemporary, error);
+				std::filesystem::remove(weightsTemporary, error);
+				checkMsg = CheckMsg(0, 0, std::string("Could not write the folded definition to ") + definitionFile);
+				return false;
+			}
+		}
+
+		std::filesystem::rename(weightsTemporary, weightsFile, error);
+		if (!error)
+			std::filesystem::rename(definitionTemporary, definitionFile, error);
+		if (error)
+		{
+			std::filesystem::remove(definitionTemporary, error);
+			std::filesystem::remove(weightsTemporary, error);
+			checkMsg = CheckMsg(0, 0, std::string("Could not replace ") + definitionFile + std::string(" or ") + weightsFile);
+			return false;
+		}
+
+		return true;
+	}
+
 	Model* Load(const std::string& fileName, Dataprovider* dataprovider, CheckMsg& checkMsg)
 	{
 		Model* model = nullptr;
@@ -8,9 +8,7 @@ namespace dnn
 	private:
 		std::unordered_map<int, dnnl::memory> fwdArgs;
 		std::unique_ptr<dnnl::binary::primitive_desc> fwdDesc;
-#ifdef DNN_CACHE_PRIMITIVES
 		std::unique_ptr<dnnl::binary> fwd;
-#endif
 		std::vector<Float> scales;
 		//FloatVector scale0;
 		//FloatVector scale1;
@@ -97,9 +95,7 @@ namespace dnn
 			// fwdArgs = std::unordered_map<int, dnnl::memory>{ { DNNL_ARG_SRC_0, dnnl::memory(*Inputs[first]->DstMemDesc, Device.engine, Inputs[first]->Neurons.data()) }, { DNNL_ARG_SRC_1, dnnl::memory(*Inputs[second]->DstMemDesc, Device.engine, Inputs[second]->Neurons.data()) }, { DNNL_ARG_DST, dnnl::memory(*DstMemDesc, Device.engine, Neurons.data()) }, { DNNL_ARG_ATTR_SCALES | DNNL_ARG_SRC_0, dnnl::memory(dnnl::memory::desc(dnnl::memory::dims({ dnnl::memory::dim(1) }), dnnl::memory::data_type::f32, dnnl::memory::format_tag::x), Device.engine, scale0.data()) }, { DNNL_ARG_ATTR_SCALES | DNNL_ARG_SRC_1, dnnl::memory(dnnl::memory::desc(dnnl::memory::dims({ dnnl::memory::dim(1) }), dnnl::memory::data_type::f32, dnnl::memory::format_tag::x), Device.engine, scale1.data()) } };
 			fwdArgs = std::unordered_map<int, dnnl::memory>{ { DNNL_ARG_SRC_0, dnnl::memory(*Inputs[first]->DstMemDesc, Device.engine, Inputs[first]->Neurons.data()) }, { DNNL_ARG_SRC_1, dnnl::memory(*Inputs[second]->DstMemDesc, Device.engine, Inputs[second]->Neurons.data()) }, { DNNL_ARG_DST, dnnl::memory(*DstMemDesc, Device.engine, Neurons.data()) } };
 
-#ifdef DNN_CACHE_PRIMITIVES
 			fwd = std::make_unique<dnnl::binary>(dnnl::binary(*fwdDesc));
-#endif
 		}
 
 /*
@@ -109,11 +105,7 @@ namespace dnn
 			scale0[0] = (!fullDepth && Inputs[first]->Skip) ? Float(0) : Float(1);
 			scale1[0] = (!fullDepth && Inputs[second]->Skip) ? Float(0) : Float(1);
             
-#ifdef DNN_CACHE_PRIMITIVES
 				fwd->execute(Device.stream, fwdArgs);
-#else
-				dnnl::binary(*fwdDesc).execute(Device.stream, fwdArgs);
-#endif
 			Device.stream.wait();
 			
 #ifndef DNN_LEAN
@@ -135,11 +127,7 @@ namespace dnn
 			{
 				if ((Reference || ReferenceAdd) && fullDepth)
 				{
-#ifdef DNN_CACHE_PRIMITIVES
 					fwd->execute(Device.stream, fwdArgs);
-#else
-					dnnl::binary(*fwdDesc).execute(Device.stream, fwdArgs);
-#endif
 					Device.stream.wait();
 
 #ifndef DNN_LEAN
@@ -406,11 +394,7 @@ namespace dnn
 			}
 			else
 			{
-#ifdef DNN_CACHE_PRIMITIVES
 				fwd->execute(Device.stream, fwdArgs);
-#else
-				dnnl::binary(*fwdDesc).execute(Device.stream, fwdArgs);
-#endif
 				Device.stream.wait();
 			}
 		}
@@ -75,7 +75,7 @@ namespace dnn
 		{
 			Layer::SetBatchSize(batchSize);
 
-			if (Enabled)
+			if (Enabled && !Inference)
 			{
 				NeuronsActive.resize(batchSize, C, H, W, dnnl::memory::data_type::f32, BlockedFmt, Device.engine);
 				for (auto n = 0ull; n < batchSize; n++)
@@ -249,7 +249,7 @@ namespace dnn
 
 		UInt GetNeuronsSize(const UInt batchSize) const override
 		{
-			return Layer::GetNeuronsSize(batchSize) + (batchSize * PaddedCDHW() * sizeof(Float));
+			return Layer::GetNeuronsSize(batchSize) + (Inference ? 0ull : (batchSize * PaddedCDHW() * sizeof(Float)));
 		}
 	};
 }
\ No newline at end of file
@@ -2,6 +2,8 @@
 #include "Utils.h"
 
 #ifdef cimg_use_jpeg
+#include <csetjmp>
+#include <cstdio>
 #include "jpeglib.h"
 #include "jerror.h"
 #endif
@@ -38,11 +40,117 @@ namespace dnn
 		BottomRight = 3,
 		Center = 4
 	};
-	
+
+	// Geometric augmentation chain (flip -> resize -> pad -> zoom/rotate -> cutout -> crop) executed by Image::Warp in a single resampling pass
+	struct Geometry
+	{
+		UInt Height;			// output window
+		UInt Width;
+		UInt CanvasHeight;		// size the source is resized to before padding
+		UInt CanvasWidth;
+		UInt PadH;
+		UInt PadW;
+		bool HorizontalFlip;
+		bool VerticalFlip;
+		Float Zoom;				// relative zoom about the center of the padded canvas
+		Float Angle;			// rotation in degrees about the center of the padded canvas
+		UInt OffsetH;			// top-left corner of the output window inside the padded canvas
+		UInt OffsetW;
+		UInt CutoutTop;			// cutout rectangle in padded canvas coordinates (empty when top == bottom)
+		UInt CutoutBottom;
+		UInt CutoutLeft;
+		UInt CutoutRight;
+
+		Geometry(const UInt height, const UInt width, const UInt canvasHeight, const UInt canvasWidth) :
+			Height(height),
+			Width(width),
+			CanvasHeight(canvasHeight),
+			CanvasWidth(canvasWidth),
+			PadH(0),
+			PadW(0),
+			HorizontalFlip(false),
+			VerticalFlip(false),
+			Zoom(Float(0)),
+			Angle(Float(0)),
+			OffsetH(0),
+			OffsetW(0),
+			CutoutTop(0),
+			CutoutBottom(0),
+			CutoutLeft(0),
+			CutoutRight(0)
+		{
+		}
+
+		auto PaddedHeight() const noexcept { return CanvasHeight + 2 * PadH; }
+		auto PaddedWidth() const noexcept { return CanvasWidth + 2 * PadW; }
+
+		// no flip, padding, zoom, rotation, crop offset or cutout: Warp only resizes to the output window
+		bool IsResize() const noexcept
+		{
+			return !HorizontalFlip && !VerticalFlip && PadH == 0 && PadW == 0 && Zoom == Float(0) && Angle == Float(0) && OffsetH == 0 && OffsetW == 0 && CutoutTop == CutoutBottom && CanvasHeight == Height && CanvasWidth == Width;
+		}
+
+		void CenterCrop()
+		{
+			OffsetH = PaddedHeight() > Height ? (PaddedHeight() - Height) / 2 : 0ull;
+			OffsetW = PaddedWidth() > Width ? (PaddedWidth() - Width) / 2 : 0ull;
+		}
+
+		void RandomCrop()
+		{
+			OffsetH = PaddedHeight() > Height ? UniformInt<UInt>(0, PaddedHeight() - Height) : 0ull;
+			OffsetW = PaddedWidth() > Width ? UniformInt<UInt>(0, PaddedWidth() - Width) : 0ull;
+		}
+
+		// offsets drawn ahead of time, clipped to the padded canvas
+		void Crop(const UInt offsetH, const UInt offsetW) noexcept
+		{
+			OffsetH = PaddedHeight() > Height ? std::min<UInt>(offsetH, PaddedHeight() - Height) : 0ull;
+			OffsetW = PaddedWidth() > Width ? std::min<UInt>(offsetW, PaddedWidth() - Width) : 0ull;
+		}
+
+		// canvas rows and columns the output window reads when there's no zoom or rotation, mirrored padding and flips included
+		void CanvasWindow(UInt& top, UInt& left, UInt& height, UInt& width) const noexcept
+		{
+			const auto axis = [](const UInt offset, const UInt size, const UInt pad, const UInt canvas, const bool flip, UInt& start, UInt& count)
+			{
+				auto begin = offset > pad ? std::min<UInt>(offset - pad, canvas) : 0ull;
+				auto end = offset + size > pad ? std::min<UInt>(offset + size - pad, canvas) : 0ull;
+				
+				// mirrored padding reflects the pixels next to the border
+				if (offset < pad)
+					end = std::max<UInt>(end, std::min<UInt>(pad - offset, canvas));
+				if (offset + size > pad + canvas)
+					begin = std::min<UInt>(begin, canvas - std::min<UInt>(offset + size - pad - canvas, canvas));
+
+				start = flip ? canvas - end : begin;
+				count = end - begin;
+			};
+
+			axis(OffsetH, Height, PadH, CanvasHeight, VerticalFlip, top, height);
+			axis(OffsetW, Width, PadW, CanvasWidth, HorizontalFlip, left, width);
+		}
+
+		void RandomCutout()
+		{
+			const auto height = PaddedHeight();
+			const auto width = PaddedWidth();
+			const auto centerH = UniformInt<UInt>(0, height);
+			const auto centerW = UniformInt<UInt>(0, width);
+			const auto rangeH = UniformInt<UInt>(height / 8, height / 4);
+			const auto rangeW = UniformInt<UInt>(width / 8, width / 4);
+			CutoutTop = centerH > rangeH ? centerH - rangeH : 0ull;
+			CutoutLeft = centerW > rangeW ? centerW - rangeW : 0ull;
+			CutoutBottom = centerH + rangeH < height ? centerH + rangeH : height;
+			CutoutRight = centerW + rangeW < width ? centerW + rangeW : width;
+		}
+	};
+
 	template<typename T>
 	struct Image
 	{
-		typedef std::vector<T, AlignedAllocator<T, 64ull>> VectorT;
+		// draws from the thread's ScratchArena while a ScratchScope is open
+		typedef std::vector<T, ScratchAllocator<T, 64ull>> VectorT;
 
 	private:
 		VectorT Data;
@@ -170,6 +278,87 @@ namespace dnn
 			return Image(image._spectrum, image._depth, image._height, image._width, image.data());
 		}
 
+		// converts VectorSize RGB pixels to HSL the way CImg does (hue in degrees, saturation and lightness in [0,1]),
+		// lets adjust modify the components and converts them back in place
+		template<typename Adjust>
+		static DNN_INLINE void AdjustHSL(Byte* red, Byte* green, Byte* blue, const Adjust& adjust)
+		{
+			const auto R = LoadByteVecFloat(red) / Float(255);
+			const auto G = LoadByteVecFloat(green) / Float(255);
+			const auto B = LoadByteVecFloat(blue) / Float(255);
+
+			const auto m = min(min(R, G), B);
+			const auto M = max(max(R, G), B);
+			const auto delta = M - m;
+			const auto chroma = delta > VecZero;
+			const auto redMin = R == m;
+			const auto greenMin = G == m;
+
+			auto L = (m + M) / Float(2);
+			const auto f = select(redMin, G - B, select(greenMin, B - R, R - G));
+			const auto i = select(redMin, VecFloat(Float(3)), select(greenMin, VecFloat(Float(5)), VecFloat(Float(1))));
+			auto H = i - f / select(chroma, delta, VecFloat(Float(1)));
+			H = select(chroma, select(H >= VecFloat(Float(6)), H - Float(6), H) * Float(60), VecZero);
+			auto S = select(chroma, select(L * Float(2) <= VecFloat(Float(1)), delta / (M + m), delta / (Float(2) - M - m)), VecZero);
+
+			adjust(H, S, L);
+
+			const auto q = select(L * Float(2) < VecFloat(Float(1)), L * (Float(1) + S), L + S - L * S);
+			const auto p = L * Float(2) - q;
+			auto h = H / Float(60);
+			h = select(h >= VecFloat(Float(6)), h - Float(6), h) / Float(6);
+
+			const auto channel = [&](VecFloat t)
+			{
+				t = select(t < VecZero, t + Float(1), select(t > VecFloat(Float(1)), t - Float(1), t));
+				return Float(255) * select(t * Float(6) < VecFloat(Float(1)), p + (q - p) * Float(6) * t, select(t * Float(2) < VecFloat(Float(1)), q, select(t * Float(3) < VecFloat(Float(2)), p + (q - p) * Float(6) * (Float(2) / 3 - t), p)));
+			};
+
+			StoreVecFloatByte(red, channel(h + Float(1) / 3));
+			StoreVecFloatByte(green, channel(h));
+			StoreVecFloatByte(blue, channel(h - Float(1) / 3));
+		}
+
+		template<typename Adjust>
+		static void AdjustHSL(Image& image, const Adjust& adjust)
+		{
+			static_assert(std::is_same_v<T, Byte>, "AdjustHSL requires a Byte image");
+
+			if (image.Channels != 3)
+				return;
+
+			const auto plane = image.ChannelSize();
+			const auto part = (plane / VectorSize) * VectorSize;
+			const auto red = image.data();
+			const auto green = red + plane;
+			const auto blue = green + plane;
+
+			for (auto i = 0ull; i < part; i += VectorSize)
+				AdjustHSL(red + i, green + i, blue + i, adjust);
+
+			if (part < plane)
+			{
+				const auto rest = plane - part;
+				Byte r[VectorSize] = {}, g[VectorSize] = {}, b[VectorSize] = {};
+				std::memcpy(r, red + part, rest);
+				std::memcpy(g, green + part, rest);
+				std::memcpy(b, blue + part, rest);
+				AdjustHSL(r, g, b, adjust);
+				std::memcpy(red + part, r, rest);
+				std::memcpy(green + part, g, rest);
+				std::memcpy(blue + part, b, rest);
+			}
+		}
+
+		static void ApplyLUT(Image& image, const std::array<Byte, 256>& lut)
+		{
+			static_assert(std::is_same_v<T, Byte>, "ApplyLUT requires a Byte image");
+
+			const auto data = image.data();
+			for (auto i = 0ull; i < image.Size(); i++)
+				data[i] = lut[data[i]];
+		}
+
 		static Image AutoAugment(const Image& image, const UInt padD, const UInt padH, const UInt padW, const std::vector<Float>& mean, const bool mirrorPad)
 		{
 			Image dstImage(image);
@@ -190,14 +379,14 @@ namespace dnn
 			case 0:
 			{
 				if (Bernoulli<bool>(Float(0.1)))
-					dstImage = Invert(dstImage);
+					Invert(dstImage);
 
 				if (Bernoulli<bool>(Float(0.2)))
 				{
 					if (Bernoulli<bool>())
-						dstImage = Contrast(dstImage, FloatLevel(6));
+						Contrast(dstImage, FloatLevel(6));
 					else
-						dstImage = Contrast(dstImage, FloatLevel(4));
+						Contrast(dstImage, FloatLevel(4));
 				}
 			}
 			break;
@@ -227,17 +416,17 @@ namespace dnn
 				if (Bernoulli<bool>(Float(0.8)))
 				{
 					if (Bernoulli<bool>())
-						dstImage = Sharpness(dstImage, FloatLevel(2));
+						Sharpness(dstImage, FloatLevel(2));
 					else
-						dstImage = Sharpness(dstImage, FloatLevel(8));
+						Sharpness(dstImage, FloatLevel(8));
 				}
 
 				if (Bernoulli<bool>(Float(0.9)))
 				{
 					if (Bernoulli<bool>())
-						dstImage = Sharpness(dstImage, FloatLevel(3));
+						Sharpness(dstImage, FloatLevel(3));
 					else
-						dstImage = Sharpness(dstImage, FloatLevel(7));
+						Sharpness(dstImage, FloatLevel(7));
 				}
 			}
 			break;
@@ -265,10 +454,10 @@ namespace dnn
 			case 4:
 			{
 				if (Bernoulli<bool>())
-					dstImage = AutoContrast(dstImage);
+					AutoContrast(dstImage);
 
 				if (Bernoulli<bool>(Float(0.9)))
-					dstImage = Equalize(dstImage);
+					Equalize(dstImage);
 			}
 			break;
 
@@ -285,9 +474,9 @@ namespace dnn
 				if (Bernoulli<bool>(Float(0.3)))
 				{
 					if (Bernoulli<bool>())
-						dstImage = Posterize(dstImage, 32);
+						Posterize(dstImage, 32);
 					else
-						dstImage = Posterize(dstImage, 64);
+						Posterize(dstImage, 64);
 				}
 			}
 			break;
@@ -297,17 +486,17 @@ namespace dnn
 				if (Bernoulli<bool>(Float(0.4)))
 				{
 					if (Bernoulli<bool>())
-						dstImage = Color(dstImage, FloatLevel(3));
+						Color(dstImage, FloatLevel(3));
 					else
-						dstImage = Color(dstImage, FloatLevel(7));
+						Color(dstImage, FloatLevel(7));
 				}
 
 				if (Bernoulli<bool>(Float(0.6)))
 				{
 					if (Bernoulli<bool>())
-						dstImage = Brightness(dstImage, FloatLevel(7));
+						Brightness(dstImage, FloatLevel(7));
 					else
-						dstImage = Brightness(dstImage, FloatLevel(3));
+						Brightness(dstImage, FloatLevel(3));
 				}
 			}
 			break;
@@ -317,17 +506,17 @@ namespace dnn
 				if (Bernoulli<bool>(Float(0.3)))
 				{
 					if (Bernoulli<bool>())
-						dstImage = Sharpness(dstImage, FloatLevel(9));
+						Sharpness(dstImage, FloatLevel(9));
 					else
-						dstImage = Sharpness(dstImage, FloatLevel(1));
+						Sharpness(dstImage, FloatLevel(1));
 				}
 
 				if (Bernoulli<bool>(Float(0.7)))
 				{
 					if (Bernoulli<bool>())
-						dstImage = Brightness(dstImage, FloatLevel(8));
+						Brightness(dstImage, FloatLevel(8));
 					else
-						dstImage = Brightness(dstImage, FloatLevel(2));
+						Brightness(dstImage, FloatLevel(2));
 				}
 			}
 			break;
@@ -335,10 +524,10 @@ namespace dnn
 			case 8:
 			{
 				if (Bernoulli<bool>(Float(0.6)))
-					dstImage = Equalize(dstImage);
+					Equalize(dstImage);
 
 				if (Bernoulli<bool>())
-					dstImage = Equalize(dstImage);
+					Equalize(dstImage);
 			}
 			break;
 
@@ -347,17 +536,17 @@ namespace dnn
 				if (Bernoulli<bool>(Float(0.6)))
 				{
 					if (Bernoulli<bool>())
-						dstImage = Contrast(dstImage, FloatLevel(7));
+						Contrast(dstImage, FloatLevel(7));
 					else
-						dstImage = Contrast(dstImage, FloatLevel(3));
+						Contrast(dstImage, FloatLevel(3));
 				}
 
 				if (Bernoulli<bool>(Float(Float(0.6))))
 				{
 					if (Bernoulli<bool>(Float(0.5)))
-						dstImage = Sharpness(dstImage, FloatLevel(6));
+						Sharpness(dstImage, FloatLevel(6));
 					else
-						dstImage = Sharpness(dstImage, FloatLevel(4));
+						Sharpness(dstImage, FloatLevel(4));
 				}
 			}
 			break;
@@ -367,9 +556,9 @@ namespace dnn
 				if (Bernoulli<bool>(Float(0.7)))
 				{
 					if (Bernoulli<bool>())
-						dstImage = Color(dstImage, FloatLevel(7));
+						Color(dstImage, FloatLevel(7));
 					else
-						dstImage = Color(dstImage, FloatLevel(3));
+						Color(dstImage, FloatLevel(3));
 				}
 
 				if (Bernoulli<bool>())
@@ -385,10 +574,10 @@ namespace dnn
 			case 11:
 			{
 				if (Bernoulli<bool>(Float(0.3)))
-					dstImage = Equalize(dstImage);
+					Equalize(dstImage);
 
 				if (Bernoulli<bool>(Float(0.4)))
-					dstImage = AutoContrast(dstImage);
+					AutoContrast(dstImage);
 			}
 			break;
 
@@ -403,7 +592,7 @@ namespace dnn
 				}
 
 				if (Bernoulli<bool>(Float(0.2)))
-					dstImage = Sharpness(dstImage, FloatLevel(6));
+					Sharpness(dstImage, FloatLevel(6));
 			}
 			break;
 
@@ -412,17 +601,17 @@ namespace dnn
 				if (Bernoulli<bool>(Float(0.9)))
 				{
 					if (Bernoulli<bool>())
-						dstImage = Brightness(dstImage, FloatLevel(6));
+						Brightness(dstImage, FloatLevel(6));
 					else
-						dstImage = Brightness(dstImage, FloatLevel(4));
+						Brightness(dstImage, FloatLevel(4));
 				}
 
 				if (Bernoulli<bool>(Float(0.2)))
 				{
 					if (Bernoulli<bool>())
-						dstImage = Color(dstImage, FloatLevel(8));
+						Color(dstImage, FloatLevel(8));
 					else
-						dstImage = Color(dstImage, FloatLevel(2));
+						Color(dstImage, FloatLevel(2));
 				}
 			}
 			break;
@@ -432,9 +621,9 @@ namespace dnn
 				if (Bernoulli<bool>())
 				{
 					if (Bernoulli<bool>())
-						dstImage = Solarize(dstImage, static_cast<T>(IntLevel(2, 0, 256)));
+						Solarize(dstImage, static_cast<T>(IntLevel(2, 0, 256)));
 					else
-						dstImage = Solarize(dstImage, static_cast<T>(IntLevel(8, 0, 256)));
+						Solarize(dstImage, static_cast<T>(IntLevel(8, 0, 256)));
 				}
 			}
 			break;
@@ -442,20 +631,20 @@ namespace dnn
 			case 15:
 			{
 				if (Bernoulli<bool>(Float(0.2)))
-					dstImage = Equalize(dstImage);
+					Equalize(dstImage);
 
 				if (Bernoulli<bool>(Float(0.6)))
-					dstImage = AutoContrast(dstImage);
+					AutoContrast(dstImage);
 			}
 			break;
 
 			case 16:
 			{
 				if (Bernoulli<bool>(Float(0.2)))
-					dstImage = Equalize(dstImage);
+					Equalize(dstImage);
 
 				if (Bernoulli<bool>(Float(0.6)))
-					dstImage = Equalize(dstImage);
+					Equalize(dstImage);
 			}
 			break;
 
@@ -464,43 +653,43 @@ namespace dnn
 				if (Bernoulli<bool>(Float(0.9)))
 				{
 					if (Bernoulli<bool>())
-						dstImage = Color(dstImage, FloatLevel(8));
+						Color(dstImage, FloatLevel(8));
 					else
-						dstImage = Color(dstImage, FloatLevel(2));
+						Color(dstImage, FloatLevel(2));
 				}
 
 				if (Bernoulli<bool>(Float(0.6)))
-					dstImage = Equalize(dstImage);
+					Equalize(dstImage);
 			}
 			break;
 
 			case 18:
 			{
 				if (Bernoulli<bool>(Float(0.8)))
-					dstImage = AutoContrast(dstImage);
+					AutoContrast(dstImage);
 
 				if (Bernoulli<bool>(Float(0.2)))
-					dstImage = Solarize(dstImage, static_cast<T>(IntLevel(8, 0, 256)));
+					Solarize(dstImage, static_cast<T>(IntLevel(8, 0, 256)));
 			}
 			break;
 
 			case 19:
 			{
 				if (Bernoulli<bool>(Float(0.1)))
-					dstImage = Brightness(dstImage, FloatLevel(3));
+					Brightness(dstImage, FloatLevel(3));
 
 				if (Bernoulli<bool>(Float(0.7)))
-					dstImage = Color(dstImage, FloatLevel(4));
+					Color(dstImage, FloatLevel(4));
 			}
 			break;
 
 			case 20:
 			{
 				if (Bernoulli<bool>(Float(0.4)))
-					dstImage = Solarize(dstImage, static_cast<T>(IntLevel(5, 0, 256)));
+					Solarize(dstImage, static_cast<T>(IntLevel(5, 0, 256)));
 
 				if (Bernoulli<bool>(Float(0.9)))
-					dstImage = AutoContrast(dstImage);
+					AutoContrast(dstImage);
 			}
 			break;
 
@@ -527,20 +716,20 @@ namespace dnn
 			case 22:
 			{
 				if (Bernoulli<bool>(Float(0.9)))
-					dstImage = AutoContrast(dstImage);
+					AutoContrast(dstImage);
 
 				if (Bernoulli<bool>(Float(0.8)))
-					dstImage = Solarize(dstImage, static_cast<T>(IntLevel(3, 0, 256)));
+					Solarize(dstImage, static_cast<T>(IntLevel(3, 0, 256)));
 			}
 			break;
 
 			case 23:
 			{
 				if (Bernoulli<bool>(Float(0.8)))
-					dstImage = Equalize(dstImage);
+					Equalize(dstImage);
 
 				if (Bernoulli<bool>(Float(0.1)))
-					dstImage = Invert(dstImage);
+					Invert(dstImage);
 			}
 			break;
 
@@ -555,7 +744,7 @@ namespace dnn
 				}
 
 				if (Bernoulli<bool>(Float(0.9)))
-					dstImage = AutoContrast(dstImage);
+					AutoContrast(dstImage);
 			}
 			break;
 			}
@@ -575,72 +764,39 @@ namespace dnn
 			return dstImage;
 		}
 
-		static Image AutoContrast(const Image& image)
+		static void AutoContrast(Image& image)
 		{
-			const T maximum = std::is_floating_point_v<T> ? T(1) : T(255);
-			
-			auto srcImage = ImageToCImg(image);
+			const auto [minimum, maximum] = GetMinMax(image);
 
-			srcImage.normalize(0, maximum);
+			if (minimum == maximum)
+			{
+				std::fill_n(image.data(), image.Size(), Byte(0));
+				return;
+			}
 
-			auto dstImage = CImgToImage(srcImage);
+			auto lut = std::array<Byte, 256>();
+			for (auto c = UInt(minimum); c <= UInt(maximum); c++)
+				lut[c] = Byte((Float(c) - Float(minimum)) / (Float(maximum) - Float(minimum)) * Float(255));
 
-			return dstImage;
+			ApplyLUT(image, lut);
 		}
 
 		// magnitude = 0   // black-and-white image
 		// magnitude = 1   // original
 		// range 0.1 --> 1.9
-		static Image Brightness(const Image& image, const Float magnitude)
+		static void Brightness(Image& image, const Float magnitude)
 		{
-			auto srcImage = ImageToCImgFloat(image);
-
-			srcImage.RGBtoHSL();
-
 			const auto delta = (magnitude - Float(1)) / 2;
 
-			for (auto d = 0ull; d < image.Depth; d++)
-				for (auto h = 0ull; h < image.Height; h++)
-					for (auto w = 0ull; w < image.Width; w++)
-						srcImage(uint32_t(w), uint32_t(h), uint32_t(d), 2) = cimg_library::cimg::cut<Float>(srcImage(uint32_t(w), uint32_t(h), uint32_t(d), 2) + delta, 0, 1);
-
-			srcImage.HSLtoRGB();
-
-			Image dstImage(image.Channels, image.Depth, image.Height, image.Width);
-
-			for (auto c = 0ull; c < dstImage.Channels; c++)
-				for (auto d = 0ull; d < dstImage.Depth; d++)
-					for (auto h = 0ull; h < dstImage.Height; h++)
-						for (auto w = 0ull; w < dstImage.Width; w++)
-							dstImage(c, d, h, w) = Saturate<Float>(srcImage(uint32_t(w), uint32_t(h), uint32_t(d), uint32_t(c)));
-
-			return dstImage;
+			AdjustHSL(image, [=](VecFloat&, VecFloat&, VecFloat& L) { L = min(max(L + delta, VecZero), VecFloat(Float(1))); });
 		}
 
 		// magnitude = 0   // black-and-white image
 		// magnitude = 1   // original
 		// range 0.1 --> 1.9
-		static Image Color(const Image& image, const Float magnitude)
+		static void Color(Image& image, const Float magnitude)
 		{
-			auto srcImage = ImageToCImgFloat(image);
-
-			srcImage.RGBtoHSL();
-
-			for (auto d = 0ull; d < image.Depth; d++)
-				for (auto h = 0ull; h < image.Height; h++)
-					for (auto w = 0ull; w < image.Width; w++)
-						srcImage(uint32_t(w), uint32_t(h), uint32_t(d), 0) = cimg_library::cimg::cut<Float>(srcImage(uint32_t(w), uint32_t(h), uint32_t(d), 0) * magnitude, 0, 360);
-
-			srcImage.HSLtoRGB();
-
-			Image dstImage(image.Channels, image.Depth, image.Height, image.Width);
-			for (auto c = 0ull; c < dstImage.Channels; c++)
-				for (auto d = 0ull; d < dstImage.Depth; d++)
-					for (auto h = 0ull; h < dstImage.Height; h++)
-						for (auto w = 0ull; w < dstImage.Width; w++)
-							dstImage(c, d, h, w) = Saturate<Float>(srcImage(uint32_t(w), uint32_t(h), uint32_t(d), uint32_t(c)));
-
-			return dstImage;
+			AdjustHSL(image, [=](VecFloat& H, VecFloat&, VecFloat&) { H = min(max(H * magnitude, VecZero), VecFloat(Float(360))); });
 		}
 
 		static Image ColorCast(const Image& image, const UInt angle)
@@ -671,27 +827,9 @@ namespace dnn
 		// magnitude = 0   // gray image
 		// magnitude = 1   // original
 		// range 0.1 --> 1.9
-		static Image Contrast(const Image& image, const Float magnitude)
+		static void Contrast(Image& image, const Float magnitude)
 		{
-			auto srcImage = ImageToCImgFloat(image);
-
-			srcImage.RGBtoHSL();
-
-			for (auto d = 0ull; d < image.Depth; d++)
-				for (auto h = 0ull; h < image.Height; h++)
-					for (auto w = 0ull; w < image.Width; w++)
-						srcImage(uint32_t(w), uint32_t(h), uint32_t(d), 1) = cimg_library::cimg::cut<Float>(srcImage(uint32_t(w), uint32_t(h), uint32_t(d), 1) * magnitude, 0, 1);
-
-			srcImage.HSLtoRGB();
-
-			Image dstImage(image.Channels, image.Depth, image.Height, image.Width);
-			for (auto c = 0ull; c < dstImage.Channels; c++)
-				for (auto d = 0ull; d < dstImage.Depth; d++)
-					for (auto h = 0ull; h < dstImage.Height; h++)
-						for (auto w = 0ull; w < dstImage.Width; w++)
-							dstImage(c, d, h, w) = Saturate<Float>(srcImage(uint32_t(w), uint32_t(h), uint32_t(d), uint32_t(c)));
-
-			return dstImage;
+			AdjustHSL(image, [=](VecFloat&, VecFloat& S, VecFloat&) { S = min(max(S * magnitude, VecZero), VecFloat(Float(1))); });
 		}
 
 		static Image Crop(const Image& image, const Positions position, const UInt depth, const UInt height, const UInt width, const std::vector<Float>& mean)
@@ -816,15 +954,81 @@ namespace dnn
 			return dstImage;
 		}
 		
-		static Image Equalize(const Image& image)
+		static void Equalize(Image& image)
 		{
-			auto srcImage = ImageToCImg(image);
+			const auto [minimum, maximum] = GetMinMax(image);
 
-			srcImage.equalize(256);
+			if (minimum == maximum)
+				return;
 
-			auto dstImage = CImgToImage(srcImage);
+			// four interleaved histograms avoid stalling on runs of equal values
+			const auto low = double(minimum);
+			const auto range = double(maximum) - low;
+			const auto bin = [=](const UInt c) { return UInt((double(c) - low) * 255.0 / range); };
+			const auto data = image.data();
+			const auto size = image.Size();
+			const auto part = (size / 4ull) * 4ull;
 
-			return dstImage;
+			auto histogram = std::array<std::array<UInt, 256>, 4>();
+			for (auto i = 0ull; i < part; i += 4ull)
+			{
+				histogram[0][data[i]]++;
+				histogram[1][data[i + 1]]++;
+				histogram[2][data[i + 2]]++;
+				histogram[3][data[i + 3]]++;
+			}
+			for (auto i = part; i < size; i++)
+				histogram[0][data[i]]++;
+
+			auto cumulative = std::array<UInt, 256>();
+			for (auto c = UInt(minimum); c <= UInt(maximum); c++)
+				cumulative[bin(c)] += histogram[0][c] + histogram[1][c] + histogram[2][c] + histogram[3][c];
+			for (auto c = 1ull; c < 256ull; c++)
+				cumulative[c] += cumulative[c - 1];
+
+			auto lut = std::array<Byte, 256>();
+			for (auto c = UInt(minimum); c <= UInt(maximum); c++)
+				lut[c] = Byte(low + range * double(cumulative[bin(c)]) / double(cumulative[255]));
+
+			ApplyLUT(image, lut);
+		}
+
+		static std::pair<Byte, Byte> GetMinMax(const Image& image)
+		{
+			static_assert(std::is_same_v<T, Byte>, "GetMinMax requires a Byte image");
+
+			const auto data = image.data();
+			const auto size = image.Size();
+			const auto part = (size / VectorByteSize) * VectorByteSize;
+
+			auto minimum = Byte(255);
+			auto maximum = Byte(0);
+
+			if (part > 0ull)
+			{
+				auto vecMin = VecByte(255);
+				auto vecMax = VecByte(0);
+				VecByte bytes;
+				for (auto i = 0ull; i < part; i += VectorByteSize)
+				{
+					bytes.load(data + i);
+					vecMin = min(vecMin, bytes);
+					vecMax = max(vecMax, bytes);
+				}
+
+				Byte lanes[VectorByteSize];
+				vecMin.store(lanes);
+				minimum = *std::min_element(lanes, lanes + VectorByteSize);
+				vecMax.store(lanes);
+				maximum = *std::max_element(lanes, lanes + VectorByteSize);
+			}
+			for (auto i = part; i < size; i++)
+			{
+				minimum = std::min(minimum, data[i]);
+				maximum = std::max(maximum, data[i]);
+			}
+
+			return { minimum, maximum };
 		}
 
 		static Float GetChannelMean(const Image& image, const UInt c)
@@ -879,19 +1083,22 @@ namespace dnn
 			return dstImage;
 		}
 
-		static Image Invert(const Image& image)
+		static void Invert(Image& image)
 		{
-			Image dstImage(image.Channels, image.Depth, image.Height, image.Width);
+			static_assert(std::is_same_v<T, Byte>, "Invert requires a Byte image");
 
-			constexpr T maximum = std::is_floating_point_v<T> ? T(1) : T(255);
+			const auto data = image.data();
+			const auto size = image.Size();
+			const auto part = (size / VectorByteSize) * VectorByteSize;
 
-			for (auto c = 0ull; c < dstImage.Channels; c++)
-				for (auto d = 0ull; d < dstImage.Depth; d++)
-					for (auto h = 0ull; h < dstImage.Height; h++)
-						for (auto w = 0ull; w < dstImage.Width; w++)
-							dstImage(c, d, h, w) = maximum - image(c, d, h, w);
-
-			return dstImage;
+			VecByte bytes;
+			for (auto i = 0ull; i < part; i += VectorByteSize)
+			{
+				bytes.load(data + i);
+				(VecByte(255) - bytes).store(data + i);
+			}
+			for (auto i = part; i < size; i++)
+				data[i] = Byte(255) - data[i];
 		}
 
 #ifdef cimg_use_jpeg
@@ -914,6 +1121,156 @@ namespace dnn
 			else
 				return dstImage;
 		}
+
+		// Decodes with libjpeg(-turbo) straight into CDHW at the smallest 1/1, 1/2, 1/4 or 1/8 IDCT scale that still covers height x width
+		// (zero keeps the full size). A region of interest on that height x width grid limits decoding to its rows and, with libjpeg-turbo,
+		// to its iMCU columns. The image keeps its full size, the pixels outside the region plus a margin for the interpolation taps stay zero
+		static Image LoadJPEG(const std::string& fileName, const UInt height, const UInt width, const bool forceColorFormat = false, const UInt roiTop = 0ull, const UInt roiLeft = 0ull, const UInt roiHeight = 0ull, const UInt roiWidth = 0ull)
+		{
+			// everything written after setjmp lives on the heap, automatic variables changed before a longjmp are indeterminate
+			struct Decoder
+			{
+				jpeg_decompress_struct Info;
+				jpeg_error_mgr Manager;
+				std::jmp_buf Buffer;
+				std::FILE* File;
+				std::vector<JSAMPLE> Row;
+				Image Img;
+			};
+
+			const auto decoder = std::make_unique<Decoder>();
+			auto& info = decoder->Info;
+
+			decoder->File = std::fopen(fileName.c_str(), "rb");
+			if (!decoder->File)
+				return Image();
+
+			info.err = jpeg_std_error(&decoder->Manager);
+			info.client_data = decoder.get();
+			decoder->Manager.error_exit = [](j_common_ptr cinfo) { std::longjmp(static_cast<Decoder*>(cinfo->client_data)->Buffer, 1); };
+
+			if (setjmp(decoder->Buffer))
+			{
+				jpeg_destroy_decompress(&decoder->Info);
+				std::fclose(decoder->File);
+				return Image();
+			}
+
+			jpeg_create_decompress(&info);
+			jpeg_stdio_src(&info, decoder->File);
+			jpeg_read_header(&info, TRUE);
+
+			// CMYK and YCCK come out as CMYK and are converted below, Adobe applications store them inverted
+			const auto cmyk = info.jpeg_color_space == JCS_CMYK || info.jpeg_color_space == JCS_YCCK;
+			if (cmyk)
+				info.out_color_space = JCS_CMYK;
+
+			auto scale = 1u;
+			if (height > 0ull && width > 0ull)
+				while (scale < 8u && UInt(info.image_height) / (scale * 2u) >= height && UInt(info.image_width) / (scale * 2u) >= width)
+					scale *= 2u;
+			info.scale_num = 1u;
+			info.scale_denom = scale;
+
+			jpeg_start_decompress(&info);
+
+			const auto components = UInt(info.output_components);
+			const auto channels = cmyk ? 3ull : components;
+			const auto inverted = cmyk && info.saw_Adobe_marker;
+			const auto outputHeight = UInt(info.output_height);
+			const auto outputWidth = UInt(info.output_width);
+			auto top = 0ull;
+			auto bottom = outputHeight;
+			auto left = 0ull;
+			auto right = outputWidth;
+			
+			if (roiHeight > 0ull && roiWidth > 0ull)
+			{
+				// two extra pixels on each side cover the cubic taps
+				const auto gridH = height > 0ull ? height : UInt(info.image_height);
+				const auto gridW = width > 0ull ? width : UInt(info.image_width);
+				top = roiTop * outputHeight / gridH;
+				left = roiLeft * outputWidth / gridW;
+				top = top > 2ull ? top - 2ull : 0ull;
+				left = left > 2ull ? left - 2ull : 0ull;
+				bottom = std::min<UInt>(outputHeight, ((roiTop + roiHeight) * outputHeight + gridH - 1ull) / gridH + 2ull);
+				right = std::min<UInt>(outputWidth, ((roiLeft + roiWidth) * outputWidth + gridW - 1ull) / gridW + 2ull);
+			}
+
+			if (top >= bottom || left >= right)
+			{
+				jpeg_abort_decompress(&info);
+				jpeg_destroy_decompress(&info);
+				std::fclose(decoder->File);
+				return Image();
+			}
+
+			decoder->Img = Image((forceColorFormat && channels == 1ull) ? 3ull : channels, 1ull, outputHeight, outputWidth);
+
+#ifdef LIBJPEG_TURBO_VERSION
+			if (right - left < outputWidth)
+			{
+				// the crop gets widened to iMCU boundaries
+				auto xoffset = JDIMENSION(left);
+				auto xwidth = JDIMENSION(right - left);
+				jpeg_crop_scanline(&info, &xoffset, &xwidth);
+				left = UInt(xoffset);
+				right = left + UInt(xwidth);
+			}
+
+			if (top > 0ull)
+				jpeg_skip_scanlines(&info, JDIMENSION(top));
+			
+			// after a crop the scanlines start at the left edge of the widened region
+			const auto first = left;
+#else
+			decoder->Row.resize(outputWidth * components);
+			for (auto r = 0ull; r < top; r++)
+			{
+				auto ptr = decoder->Row.data();
+				jpeg_read_scanlines(&info, &ptr, 1);
+			}
+			
+			const auto first = 0ull;
+#endif
+			decoder->Row.resize(outputWidth * components);
+			auto& dstImage = decoder->Img;
+
+			for (auto h = top; h < bottom; h++)
+			{
+				auto ptr = decoder->Row.data();
+				jpeg_read_scanlines(&info, &ptr, 1);
+
+				const auto src = decoder->Row.data() + (left - first) * components;
+				if (cmyk)
+				{
+					for (auto w = 0ull; w < right - left; w++)
+					{
+						const auto pixel = src + w * components;
+						const auto k = inverted ? UInt(pixel[3]) : 255ull - UInt(pixel[3]);
+						for (auto c = 0ull; c < 3ull; c++)
+							dstImage(c, 0, h, left + w) = T(((inverted ? UInt(pixel[c]) : 255ull - UInt(pixel[c])) * k + 127ull) / 255ull);
+					}
+				}
+				else
+					for (auto c = 0ull; c < channels; c++)
+						for (auto w = 0ull; w < right - left; w++)
+							dstImage(c, 0, h, left + w) = T(src[w * components + c]);
+			}
+
+			if (info.output_scanline < info.output_height)
+				jpeg_abort_decompress(&info);
+			else
+				jpeg_finish_decompress(&info);
+			jpeg_destroy_decompress(&info);
+			std::fclose(decoder->File);
+
+			if (dstImage.Channels != channels)
+				for (auto c = 1ull; c < 3ull; c++)
+					std::memcpy(&dstImage(c, 0, 0, 0), &dstImage(0, 0, 0, 0), dstImage.ChannelSize() * sizeof(T));
+
+			return std::move(dstImage);
+		}
 #endif
 
 #ifdef cimg_use_png
@@ -1040,27 +1397,115 @@ namespace dnn
 			return dstImage;
 		}
 
+		// Writes (image - mean) / stddev per channel to dst in plain CDHW layout
+		// perImage uses the channel mean and stddev of the image itself, gathered while widening to float
+		static void Normalize(const Image& image, Float* dst, const std::vector<Float>& mean, const std::vector<Float>& stddev, const bool perImage = false)
+		{
+			const auto size = image.ChannelSize();
+			const auto part = GetVectorPart(size);
+			const auto stream = (reinterpret_cast<std::uintptr_t>(dst) % 64ull == 0ull) && (size % VectorSize == 0ull);
+
+			const auto load = [](const T* src)
+			{
+				if constexpr (std::is_same_v<T, Byte>)
+					return LoadByteVecFloat(src);
+				else
+				{
+					VecFloat v;
+					v.load(src);
+					return v;
+				}
+			};
+
+			for (auto c = 0ull; c < image.Channels; c++)
+			{
+				const auto src = image.data() + c * size;
+				auto out = dst + c * size;
+
+				auto channelMean = perImage ? Float(0) : mean[c];
+				auto channelStdDev = perImage ? Float(1) : stddev[c];
+
+				if (perImage)
+				{
+					auto sum = Double(0);
+					auto sumSquares = Double(0);
+
+					// lane sums of 256 blocks of squared bytes stay exact in a float mantissa
+					constexpr auto block = 256ull * VectorSize;
+					for (auto start = 0ull; start < part; start += block)
+					{
+						const auto end = std::min(start + block, part);
+						auto vecSum = VecFloat(0);
+						auto vecSumSquares = VecFloat(0);
+						for (auto i = start; i < end; i += VectorSize)
+						{
+							const auto v = load(src + i);
+							vecSum += v;
+							vecSumSquares = mul_add(v, v, vecSumSquares);
+							v.store(out + i);
+						}
+						sum += Double(horizontal_add(vecSum));
+						sumSquares += Double(horizontal_add(vecSumSquares));
+					}
+					for (auto i = part; i < size; i++)
+					{
+						const auto v = Float(src[i]);
+						sum += Double(v);
+						sumSquares += Double(v) * Double(v);
+						out[i] = v;
+					}
+
+					const auto channelMeanD = sum / Double(size);
+					channelMean = Float(channelMeanD);
+					channelStdDev = std::max(Float(std::sqrt(std::max(Double(0), sumSquares / Double(size) - Square<Double>(channelMeanD)))), Float(1) / std::sqrt(Float(size)));
+				}
+
+				const auto scale = Float(1) / channelStdDev;
+				const auto shift = -channelMean * scale;
+				const auto vecScale = VecFloat(scale);
+				const auto vecShift = VecFloat(shift);
+
+				if (perImage)
+				{
+					for (auto i = 0ull; i < part; i += VectorSize)
+					{
+						VecFloat v;
+						v.load(out + i);
+						mul_add(v, vecScale, vecShift).store(out + i);
+					}
+				}
+				else if (stream)
+				{
+					for (auto i = 0ull; i < part; i += VectorSize)
+						mul_add(load(src + i), vecScale, vecShift).store_nt(out + i);
+				}
+				else
+				{
+					for (auto i = 0ull; i < part; i += VectorSize)
+						mul_add(load(src + i), vecScale, vecShift).store(out + i);
+				}
+
+				for (auto i = part; i < size; i++)
+					out[i] = (perImage ? out[i] : Float(src[i])) * scale + shift;
+			}
+
+			if (stream && !perImage)
+				_mm_sfence();
+		}
+
 		inline static Image Padding(const Image& image, const UInt padD, const UInt padH, const UInt padW, const std::vector<Float>& mean, const bool mirrorPad = false)
 		{
 			return mirrorPad ? Image::MirrorPad(image, padD, padH, padW) : Image::ZeroPad(image, padD, padH, padW, mean);
 		}
 
-		static Image Posterize(const Image& image, const UInt levels = 16)
+		static void Posterize(Image& image, const UInt levels = 16)
 		{
-			Image dstImage(image.Channels, image.Depth, image.Height, image.Width);
-
-			auto palette = std::vector<Byte>(256);
+			auto lut = std::array<Byte, 256>();
 			const auto q = 256ull / levels;
-			for (auto c = 0ull; c < 255ull; c++)
-				palette[c] = Saturate<UInt>((((c / q) * q) * levels) / (levels - 1));
-
-			for (auto c = 0ull; c < dstImage.Channels; c++)
-				for (auto d = 0ull; d < dstImage.Depth; d++)
-					for (auto h = 0ull; h < dstImage.Height; h++)
-						for (auto w = 0ull; w < dstImage.Width; w++)
-							dstImage(c, d, h, w) = palette[image(c, d, h, w)];
+			for (auto c = 0ull; c < 256ull; c++)
+				lut[c] = Saturate<UInt>((((c / q) * q) * levels) / (levels - 1));
 
-			return dstImage;
+			ApplyLUT(image, lut);
 		}
 		
 		static Image RandomCrop(const Image& image, const UInt depth, const UInt height, const UInt width, const std::vector<Float>& mean)
@@ -1200,30 +1645,97 @@ namespace dnn
 		// magnitude = 0   // blurred image
 		// magnitude = 1   // original
 		// range 0.1 --> 1.9
-		static Image Sharpness(const Image& image, const Float magnitude)
+		static void Sharpness(Image& image, const Float magnitude)
 		{
-			auto srcImage = ImageToCImg(image);
+			static_assert(std::is_same_v<T, Byte>, "Sharpness requires a Byte image");
 
-			srcImage.sharpen(magnitude, false);
+			// inverse diffusion like CImg's sharpen: the image moves along its 3x3 laplacian,
+			// scaled so the strongest response equals magnitude, clipped to the original range
+			const auto [minimum, maximum] = GetMinMax(image);
+			const auto data = image.data();
+			const auto size = image.Size();
+			const auto H = image.Height;
+			const auto W = image.Width;
 
-			auto dstImage = CImgToImage(srcImage);
+			auto velocity = std::vector<Float, ScratchAllocator<Float, 64ull>>(size);
+			auto peak = VecZero;
+			auto scalarPeak = Float(0);
 
-			return dstImage;
+			const auto laplacian = [&](const Byte* up, const Byte* row, const Byte* down, const UInt w)
+			{
+				const auto left = w > 0ull ? w - 1ull : w;
+				const auto right = w + 1ull < W ? w + 1ull : w;
+				return Float(4) * row[w] - up[w] - down[w] - row[left] - row[right];
+			};
+
+			for (auto c = 0ull; c < image.Channels; c++)
+				for (auto d = 0ull; d < image.Depth; d++)
+				{
+					const auto slice = (c * image.Depth + d) * H * W;
+					for (auto h = 0ull; h < H; h++)
+					{
+						const auto row = data + slice + h * W;
+						const auto up = data + slice + (h > 0ull ? h - 1ull : h) * W;
+						const auto down = data + slice + (h + 1ull < H ? h + 1ull : h) * W;
+						const auto dst = velocity.data() + slice + h * W;
+
+						dst[0] = laplacian(up, row, down, 0ull);
+						scalarPeak = std::max(scalarPeak, std::abs(dst[0]));
+
+						auto w = 1ull;
+						for (; w + VectorSize < W; w += VectorSize)
+						{
+							const auto inc = Float(4) * LoadByteVecFloat(row + w) - LoadByteVecFloat(up + w) - LoadByteVecFloat(down + w) - LoadByteVecFloat(row + w - 1) - LoadByteVecFloat(row + w + 1);
+							inc.store(dst + w);
+							peak = max(peak, abs(inc));
+						}
+						for (; w < W; w++)
+						{
+							dst[w] = laplacian(up, row, down, w);
+							scalarPeak = std::max(scalarPeak, std::abs(dst[w]));
+						}
+					}
+				}
+
+			Float lanes[VectorSize];
+			peak.store(lanes);
+			const auto veloc = std::max(scalarPeak, *std::max_element(lanes, lanes + VectorSize));
+			if (veloc <= Float(0))
+				return;
+
+			const auto scale = magnitude / veloc;
+			const auto lower = VecFloat(Float(minimum));
+			const auto upper = VecFloat(Float(maximum));
+			const auto part = (size / VectorSize) * VectorSize;
+
+			VecFloat inc;
+			for (auto i = 0ull; i < part; i += VectorSize)
+			{
+				inc.load(velocity.data() + i);
+				StoreVecFloatByte(data + i, min(max(inc * scale + LoadByteVecFloat(data + i), lower), upper));
+			}
+			for (auto i = part; i < size; i++)
+				data[i] = Byte(std::clamp(velocity[i] * scale + Float(data[i]), Float(minimum), Float(maximum)));
 		}
 
-		static Image Solarize(const Image& image, const T treshold = 128)
+		static void Solarize(Image& image, const T treshold = 128)
 		{
-			Image dstImage(image.Channels, image.Depth, image.Height, image.Width);
+			static_assert(std::is_same_v<T, Byte>, "Solarize requires a Byte image");
 
-			constexpr T maximum = std::is_floating_point_v<T> ? T(1) : T(255);
+			// a compare and blend per vector beats a table lookup per byte
+			const auto data = image.data();
+			const auto size = image.Size();
+			const auto part = (size / VectorByteSize) * VectorByteSize;
+			const auto threshold = VecByte(treshold);
 
-			for (auto c = 0ull; c < dstImage.Channels; c++)
-				for (auto d = 0ull; d < dstImage.Depth; d++)
-					for (auto h = 0ull; h < dstImage.Height; h++)
-						for (auto w = 0ull; w < dstImage.Width; w++)
-							dstImage(c, d, h, w) = (image(c, d, h, w) < treshold) ? image(c, d, h, w) : (maximum - image(c, d, h, w));
-
-			return dstImage;
+			VecByte bytes;
+			for (auto i = 0ull; i < part; i += VectorByteSize)
+			{
+				bytes.load(data + i);
+				select(bytes < threshold, bytes, VecByte(255) - bytes).store(data + i);
+			}
+			for (auto i = part; i < size; i++)
+				data[i] = data[i] < treshold ? data[i] : Byte(255) - data[i];
 		}
 		
 		static Image Translate(const Image& image, const int deltaH, const int deltaW, const std::vector<Float>& mean)
@@ -1313,7 +1825,292 @@ namespace dnn
 
 			return dstImage;
 		}
-		
+
+		// Single resampling pass from the source directly to the output window for the whole chain described by geometry
+		static Image Warp(const Image& image, const Geometry& geometry, const Interpolations interpolation, const std::vector<Float>& mean, const bool mirrorPad = false)
+		{
+			if (geometry.IsResize() && geometry.Height == image.Height && geometry.Width == image.Width)
+				return image;
+
+			Image dstImage(image.Channels, image.Depth, geometry.Height, geometry.Width);
+
+			const auto canvasH = Float(geometry.CanvasHeight);
+			const auto canvasW = Float(geometry.CanvasWidth);
+			const auto padH = Float(geometry.PadH);
+			const auto padW = Float(geometry.PadW);
+			const auto centerH = (Float(geometry.PaddedHeight()) - Float(1)) / Float(2);
+			const auto centerW = (Float(geometry.PaddedWidth()) - Float(1)) / Float(2);
+			const auto scaleH = Float(image.Height) / canvasH;
+			const auto scaleW = Float(image.Width) / canvasW;
+
+			// output (h, w) -> canvas (y, x), same rotation convention as CImg::rotate
+			const auto radians = geometry.Angle * Float(cimg_library::cimg::PI) / Float(180);
+			const auto cosa = std::cos(radians) / (Float(1) + geometry.Zoom);
+			const auto sina = std::sin(radians) / (Float(1) + geometry.Zoom);
+			const auto offsetH = Float(geometry.OffsetH) - centerH;
+			const auto offsetW = Float(geometry.OffsetW) - centerW;
+			const auto ax = cosa;
+			const auto bx = sina;
+			const auto cx = centerW + offsetW * cosa + offsetH * sina - padW;
+			const auto ay = -sina;
+			const auto by = cosa;
+			const auto cy = centerH - offsetW * sina + offsetH * cosa - padH;
+
+			const auto lowH = -padH - Float(0.5);
+			const auto highH = canvasH + padH - Float(0.5);
+			const auto lowW = -padW - Float(0.5);
+			const auto highW = canvasW + padW - Float(0.5);
+
+			const auto maxH = int(image.Height) - 1;
+			const auto maxW = int(image.Width) - 1;
+
+			auto channelMean = std::vector<T>(image.Channels, T(0));
+			if constexpr (!std::is_floating_point_v<T>)
+				for (auto c = 0ull; c < image.Channels; c++)
+					channelMean[c] = T(mean[c]);
+
+			const auto convert = [](const Float value) { if constexpr (std::is_floating_point_v<T>) return T(value); else return T(Saturate<Float>(value + Float(0.5))); };
+
+			const auto cubic = [](const Float t, Float* weights)
+			{
+				// Keys kernel, a = -0.5
+				const auto t2 = t * t;
+				const auto t3 = t2 * t;
+				weights[0] = Float(-0.5) * t3 + t2 - Float(0.5) * t;
+				weights[1] = Float(1.5) * t3 - Float(2.5) * t2 + Float(1);
+				weights[2] = Float(-1.5) * t3 + Float(2) * t2 + Float(0.5) * t;
+				weights[3] = Float(0.5) * t3 - Float(0.5) * t2;
+			};
+
+			// without rotation the mapping is separable: the taps are computed once per output row and column,
+			// each output row blends whole source rows and then samples the blended row
+			if (geometry.Angle == Float(0))
+			{
+				struct Taps
+				{
+					UInt Index[4];
+					Float Weight[4];
+					bool Inside;
+				};
+
+				const auto axisTaps = [&](const UInt count, const Float start, const Float step, const Float low, const Float high, const Float canvas, const Float scale, const bool flip, const int maximum)
+				{
+					auto axis = std::vector<Taps>(count);
+
+					for (auto i = 0ull; i < count; i++)
+					{
+						const auto coord = start + step * Float(i);
+						auto& tap = axis[i];
+						tap.Inside = coord >= low && coord < high;
+
+						auto canvasCoord = coord;
+						if (tap.Inside && (canvasCoord < Float(-0.5) || canvasCoord >= canvas - Float(0.5)))
+						{
+							if (mirrorPad)
+								canvasCoord = canvasCoord < Float(-0.5) ? Float(-1) - canvasCoord : Float(2) * canvas - Float(1) - canvasCoord;
+							else
+								tap.Inside = false;
+						}
+
+						auto src = (canvasCoord + Float(0.5)) * scale - Float(0.5);
+						if (flip)
+							src = Float(maximum) - src;
+
+						const auto f = interpolation == Interpolations::Nearest ? std::floor(src + Float(0.5)) : std::floor(src);
+						const auto t = src - f;
+						for (auto k = 0; k < 4; k++)
+						{
+							tap.Index[k] = UInt(Clamp<int>(int(f) + k - 1, 0, maximum));
+							tap.Weight[k] = Float(0);
+						}
+
+						switch (interpolation)
+						{
+						case Interpolations::Nearest:
+							tap.Weight[1] = Float(1);
+							break;
+						case Interpolations::Linear:
+							tap.Weight[1] = Float(1) - t;
+							tap.Weight[2] = t;
+							break;
+						case Interpolations::Cubic:
+							cubic(t, tap.Weight);
+							break;
+						}
+					}
+
+					return axis;
+				};
+
+				const auto load = [](const T* src)
+				{
+					if constexpr (std::is_same_v<T, Byte>)
+						return LoadByteVecFloat(src);
+					else
+					{
+						VecFloat v;
+						v.load(src);
+						return v;
+					}
+				};
+
+				const auto columns = axisTaps(dstImage.Width, cx, ax, lowW, highW, canvasW, scaleW, geometry.HorizontalFlip, maxW);
+				const auto rows = axisTaps(dstImage.Height, cy, by, lowH, highH, canvasH, scaleH, geometry.VerticalFlip, maxH);
+				const auto part = GetVectorPart(image.Width);
+				auto blend = std::vector<Float, ScratchAllocator<Float, 64ull>>(image.Width);
+
+				for (auto c = 0ull; c < dstImage.Channels; c++)
+					for (auto d = 0ull; d < dstImage.Depth; d++)
+						for (auto h = 0ull; h < dstImage.Height; h++)
+						{
+							const auto& row = rows[h];
+							const auto dst = &dstImage(c, d, h, 0);
+
+							if (!row.Inside)
+							{
+								std::fill_n(dst, dstImage.Width, channelMean[c]);
+								continue;
+							}
+
+							std::fill(blend.begin(), blend.end(), Float(0));
+							for (auto j = 0; j < 4; j++)
+							{
+								if (row.Weight[j] == Float(0))
+									continue;
+
+								const auto src = &image(c, d, row.Index[j], 0);
+								const auto weight = VecFloat(row.Weight[j]);
+								auto w = 0ull;
+								VecFloat sum;
+								for (; w < part; w += VectorSize)
+								{
+									sum.load(blend.data() + w);
+									mul_add(load(src + w), weight, sum).store(blend.data() + w);
+								}
+								for (; w < image.Width; w++)
+									blend[w] += row.Weight[j] * Float(src[w]);
+							}
+
+							const auto paddedH = h + geometry.OffsetH;
+							const auto cutoutRow = paddedH >= geometry.CutoutTop && paddedH < geometry.CutoutBottom;
+
+							for (auto w = 0ull; w < dstImage.Width; w++)
+							{
+								const auto& column = columns[w];
+								const auto paddedW = w + geometry.OffsetW;
+
+								if (!column.Inside || (cutoutRow && paddedW >= geometry.CutoutLeft && paddedW < geometry.CutoutRight))
+									dst[w] = channelMean[c];
+								else
+									dst[w] = convert(column.Weight[0] * blend[column.Index[0]] + column.Weight[1] * blend[column.Index[1]] + column.Weight[2] * blend[column.Index[2]] + column.Weight[3] * blend[column.Index[3]]);
+							}
+						}
+
+				return dstImage;
+			}
+
+			for (auto d = 0ull; d < dstImage.Depth; d++)
+				for (auto h = 0ull; h < dstImage.Height; h++)
+				{
+					const auto paddedH = h + geometry.OffsetH;
+					const auto cutoutRow = paddedH >= geometry.CutoutTop && paddedH < geometry.CutoutBottom;
+
+					const auto rowX = bx * Float(h) + cx;
+					const auto rowY = by * Float(h) + cy;
+
+					for (auto w = 0ull; w < dstImage.Width; w++)
+					{
+						const auto x = rowX + ax * Float(w);
+						const auto y = rowY + ay * Float(w);
+						const auto paddedW = w + geometry.OffsetW;
+						auto inside = !(cutoutRow && paddedW >= geometry.CutoutLeft && paddedW < geometry.CutoutRight) && x >= lowW && x < highW && y >= lowH && y < highH;
+
+						auto canvasX = x;
+						auto canvasY = y;
+						if (inside && (canvasX < Float(-0.5) || canvasX >= canvasW - Float(0.5) || canvasY < Float(-0.5) || canvasY >= canvasH - Float(0.5)))
+						{
+							if (mirrorPad)
+							{
+								canvasX = canvasX < Float(-0.5) ? Float(-1) - canvasX : (canvasX >= canvasW - Float(0.5) ? Float(2) * canvasW - Float(1) - canvasX : canvasX);
+								canvasY = canvasY < Float(-0.5) ? Float(-1) - canvasY : (canvasY >= canvasH - Float(0.5) ? Float(2) * canvasH - Float(1) - canvasY : canvasY);
+							}
+							else
+								inside = false;
+						}
+
+						if (!inside)
+						{
+							for (auto c = 0ull; c < dstImage.Channels; c++)
+								dstImage(c, d, h, w) = channelMean[c];
+							continue;
+						}
+
+						auto srcX = (canvasX + Float(0.5)) * scaleW - Float(0.5);
+						auto srcY = (canvasY + Float(0.5)) * scaleH - Float(0.5);
+						if (geometry.HorizontalFlip)
+							srcX = Float(maxW) - srcX;
+						if (geometry.VerticalFlip)
+							srcY = Float(maxH) - srcY;
+
+						switch (interpolation)
+						{
+						case Interpolations::Nearest:
+						{
+							const auto sx = UInt(Clamp<int>(int(std::floor(srcX + Float(0.5))), 0, maxW));
+							const auto sy = UInt(Clamp<int>(int(std::floor(srcY + Float(0.5))), 0, maxH));
+							for (auto c = 0ull; c < dstImage.Channels; c++)
+								dstImage(c, d, h, w) = image(c, d, sy, sx);
+						}
+						break;
+
+						case Interpolations::Linear:
+						{
+							const auto fx = std::floor(srcX);
+							const auto fy = std::floor(srcY);
+							const auto tx = srcX - fx;
+							const auto ty = srcY - fy;
+							const auto x0 = UInt(Clamp<int>(int(fx), 0, maxW));
+							const auto x1 = UInt(Clamp<int>(int(fx) + 1, 0, maxW));
+							const auto y0 = UInt(Clamp<int>(int(fy), 0, maxH));
+							const auto y1 = UInt(Clamp<int>(int(fy) + 1, 0, maxH));
+							for (auto c = 0ull; c < dstImage.Channels; c++)
+							{
+								const auto top = Float(image(c, d, y0, x0)) + tx * (Float(image(c, d, y0, x1)) - Float(image(c, d, y0, x0)));
+								const auto bottom = Float(image(c, d, y1, x0)) + tx * (Float(image(c, d, y1, x1)) - Float(image(c, d, y1, x0)));
+								dstImage(c, d, h, w) = convert(top + ty * (bottom - top));
+							}
+						}
+						break;
+
+						case Interpolations::Cubic:
+						{
+							const auto fx = std::floor(srcX);
+							const auto fy = std::floor(srcY);
+							Float weightsX[4], weightsY[4];
+							UInt xs[4], ys[4];
+							cubic(srcX - fx, weightsX);
+							cubic(srcY - fy, weightsY);
+							for (auto i = 0; i < 4; i++)
+							{
+								xs[i] = UInt(Clamp<int>(int(fx) + i - 1, 0, maxW));
+								ys[i] = UInt(Clamp<int>(int(fy) + i - 1, 0, maxH));
+							}
+							for (auto c = 0ull; c < dstImage.Channels; c++)
+							{
+								auto value = Float(0);
+								for (auto j = 0; j < 4; j++)
+									value += weightsY[j] * (weightsX[0] * Float(image(c, d, ys[j], xs[0])) + weightsX[1] * Float(image(c, d, ys[j], xs[1])) + weightsX[2] * Float(image(c, d, ys[j], xs[2])) + weightsX[3] * Float(image(c, d, ys[j], xs[3])));
+								dstImage(c, d, h, w) = convert(value);
+							}
+						}
+						break;
+						}
+					}
+				}
+
+			return dstImage;
+		}
+
 		static Image ZeroPad(const Image& image, const UInt depth, const UInt height, const UInt width, const std::vector<Float>& mean)
 		{
 			Image dstImage(image.Channels, image.Depth + (depth * 2), image.Height + (height * 2), image.Width + (width * 2));
@@ -1,5 +1,6 @@
 #pragma once
 #include "Dataprovider.h"
+#include "PrimitiveCache.h"
 
 namespace dnn
 {
@@ -379,11 +380,173 @@ namespace dnn
 		}
 	};
 
+	// The optimizer step a layer prepared for the model's single sweep over the flat parameters,
+	// Step updates the elements [start, end) of the weights (part 0) or the biases (part 1) with the gradients scaled by scale.
+	struct ParameterSweep
+	{
+		std::array<const Float*, 2ull> Gradients;
+		std::array<UInt, 2ull> Counts;
+		std::function<void(const UInt part, const UInt start, const UInt end, const Float scale)> Step;
+	};
+
+	// The primitives of one pass through a layer, with their memory objects and argument vectors built once per set
+	// of descriptors. The buffers of the layers are looked up on every run and only rebound when they moved.
+	class ExecutionPlan
+	{
+	private:
+		struct Binding
+		{
+			dnnl::memory Memory;
+			std::function<void*()> Handle;
+		};
+
+		struct Step
+		{
+			dnnl::primitive Primitive;
+			std::vector<dnnl_exec_arg_t> Args;
+		};
+
+		struct ScratchBinding
+		{
+			dnnl::memory Memory;
+			UInt Offset;
+		};
+
+		std::vector<Binding> bindings;
+		std::vector<ScratchBinding> scratch;
+		std::vector<Step> steps;
+		UInt scratchSize = 0ull;
+		FloatVector ownScratch;
+
+	public:
+		bool Empty() const
+		{
+			return steps.empty();
+		}
+
+		void Reset()
+		{
+			steps.clear();
+			scratch.clear();
+			bindings.clear();
+			scratchSize = 0ull;
+			ownScratch = FloatVector();
+		}
+
+		UInt ScratchSize() const
+		{
+			return scratchSize;
+		}
+
+		// memory over a buffer owned by a layer
+		dnnl::memory Bind(const dnnl::memory::desc& desc, const dnnl::engine& engine, std::function<void*()> handle)
+		{
+			bindings.push_back(Binding{ dnnl::memory(desc, engine, handle()), std::move(handle) });
+			return bindings.back().Memory;
+		}
+
+		// memory for an intermediate result, only live while the plan runs: it sits at an offset in the scratch passed to Run
+		dnnl::memory Scratch(const dnnl::memory::desc& desc, const dnnl::engine& engine)
+		{
+			scratch.push_back(ScratchBinding{ dnnl::memory(desc, engine, nullptr), scratchSize });
+			scratchSize += DivUp(desc.get_size() / sizeof(Float));
+			return scratch.back().Memory;
+		}
+
+		void Add(const dnnl::primitive& primitive, const std::vector<std::pair<int, dnnl::memory>>& args)
+		{
+			auto step = Step{ primitive, std::vector<dnnl_exec_arg_t>() };
+			for (const auto& arg : args)
+				step.Args.push_back(dnnl_exec_arg_t{ arg.first, arg.second.get() });
+			steps.push_back(std::move(step));
+		}
+
+		void AddReorder(const dnnl::memory& from, const dnnl::memory& to)
+		{
+			Add(dnnl::reorder(from, to), { { DNNL_ARG_FROM, from }, { DNNL_ARG_TO, to } });
+		}
+
+		// arena holds at least ScratchSize floats, without one the plan keeps its own
+		void Run(dnnl::stream& stream, Float* arena = nullptr)
+		{
+			for (auto& binding : bindings)
+			{
+				const auto handle = binding.Handle();
+				if (binding.Memory.get_data_handle() != handle)
+					binding.Memory.set_data_handle(handle);
+			}
+
+			if (!arena && scratchSize > 0ull)
+			{
+				if (ownScratch.size() < scratchSize)
+					ownScratch = FloatVector(scratchSize);
+				arena = ownScratch.data();
+			}
+
+			for (auto& binding : scratch)
+				if (binding.Memory.get_data_handle() != arena + binding.Offset)
+					binding.Memory.set_data_handle(arena + binding.Offset);
+
+			for (const auto& step : steps)
+				dnnl::error::wrap_c_api(dnnl_primitive_execute(step.Primitive.get(), stream.get(), int(step.Args.size()), step.Args.data()), "could not execute primitive");
+
+			stream.wait();
+		}
+	};
+
 	static bool IsNorm(const LayerTypes& type)
 	{
 		return std::string(magic_enum::enum_name<LayerTypes>(type)).find("Norm", 0) != std::string::npos;
 	}
 
+	// the backward pass of these layers reads the activations of their inputs
+	static bool BwdReadsSrc(const LayerTypes& type)
+	{
+		switch (type)
+		{
+		case LayerTypes::Activation:
+		case LayerTypes::BatchNorm:
+		case LayerTypes::BatchNormActivation:
+		case LayerTypes::BatchNormActivationDropout:
+		case LayerTypes::BatchNormRelu:
+		case LayerTypes::Convolution:
+		case LayerTypes::ConvolutionTranspose:
+		case LayerTypes::Cost:
+		case LayerTypes::Dense:
+		case LayerTypes::DepthwiseConvolution:
+		case LayerTypes::Divide:
+		case LayerTypes::GroupNorm:
+		case LayerTypes::LayerNorm:
+		case LayerTypes::LocalResponseNorm:
+		case LayerTypes::Max:
+		case LayerTypes::Min:
+		case LayerTypes::Multiply:
+		case LayerTypes::PRelu:
+		case LayerTypes::Reduction:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	// the backward pass of these layers reads their own activations
+	static bool BwdReadsDst(const LayerTypes& type)
+	{
+		switch (type)
+		{
+		case LayerTypes::Activation:
+		case LayerTypes::BatchNormActivation:
+		case LayerTypes::BatchNormActivationDropout:
+		case LayerTypes::Cost:
+		case LayerTypes::LogSoftmax:
+		case LayerTypes::PRelu:
+		case LayerTypes::Softmax:
+			return true;
+		default:
+			return false;
+		}
+	}
+
 	class Layer
 	{
 	protected:
@@ -490,9 +653,13 @@ namespace dnn
 		bool SharesInput;
 		bool Enabled;
 		bool Skip;
+		bool Checkpoint;
+		bool Inference;
 		bool UseDefaultParameters;
+		bool DeferUpdate;
 		std::atomic<bool> Fwd;
 		std::atomic<bool> Bwd;
+		std::atomic<bool> Updating;
 		std::atomic<bool> LockUpdate;
 		std::atomic<bool> RefreshingStats;
 		const std::vector<Layer*> Inputs;
@@ -522,6 +689,8 @@ namespace dnn
 		Float BwdTrainingWeight;
 		FloatArray Neurons;
 		FloatArray NeuronsD1;
+		Float* FwdScratch;								// ranges of the model's plan scratch arena the passes run in
+		Float* BwdScratch;
 		FloatVector Weights;
 		FloatVector WeightsD1;
 		FloatVector WeightsPar1;
@@ -532,6 +701,7 @@ namespace dnn
 		FloatVector BiasesPar1;
 		FloatVector BiasesPar2;
 		FloatVector BiasesPar3;
+		ParameterSweep Sweep;							// the step UpdateWeights left for the model while DeferUpdate is set
 		Stats NeuronsStats;
 		Stats WeightsStats;
 		Stats BiasesStats;
@@ -568,9 +738,13 @@ namespace dnn
 			SharesInput(false),
 			Enabled(enabled),
 			Skip(false),
+			Checkpoint(false),
+			Inference(false),
 			UseDefaultParameters(true),
+			DeferUpdate(false),
 			Fwd(false),
 			Bwd(false),
+			Updating(false),
 			LockUpdate(false),
 			RefreshingStats(false),
 			Inputs(std::vector<Layer*>(inputs)),	
@@ -596,6 +770,8 @@ namespace dnn
 			Gamma(Float(0)),
 			Neurons(FloatArray()),
 			NeuronsD1(FloatArray()),
+			FwdScratch(nullptr),
+			BwdScratch(nullptr),
 			Weights(FloatVector(weightCount)),
 			WeightsD1(FloatVector(weightCount)),
 			WeightsPar1(FloatVector()),
@@ -606,6 +782,7 @@ namespace dnn
 			BiasesPar1(FloatVector()),
 			BiasesPar2(FloatVector()),
 			BiasesPar3(FloatVector()),
+			Sweep(ParameterSweep()),
 			NeuronsStats(Stats()),
 			WeightsStats(Stats()),
 			BiasesStats(Stats()),
@@ -617,6 +794,12 @@ namespace dnn
 		}
 
 		virtual ~Layer() = default;
+
+		// a stream of its own lets the layer run next to the layers of another branch
+		void UseOwnStream()
+		{
+			Device.stream = dnnl::stream(Device.engine);
+		}
 		
 		inline auto HW() const noexcept { return H * W; }
 		inline auto DHW() const noexcept { return D * H * W; }
@@ -744,6 +927,15 @@ namespace dnn
 
 		virtual void InitializeDescriptors(const UInt) = 0;
 
+		// floats of intermediate results a pass needs while it runs, zero for layers without an execution plan
+		virtual UInt PlanScratchSize(const bool) const
+		{
+			return 0ull;
+		}
+
+		// without backward state the forward primitives don't keep anything for a backward pass
+		inline auto FwdPropKind() const noexcept { return Inference ? dnnl::prop_kind::forward_inference : dnnl::prop_kind::forward; }
+
 #ifdef DNN_LEAN
 		inline void ZeroGradient(const UInt batchSize)
 		{
@@ -773,7 +965,9 @@ namespace dnn
 			
 			Neurons.resize(batchSize, C, H, W, dnnl::memory::data_type::f32, BlockedFmt, Device.engine);
 #ifndef DNN_LEAN
-			if (!InplaceBwd)
+			if (Inference)
+				NeuronsD1.release();
+			else if (!InplaceBwd)
 				NeuronsD1.resize(batchSize, C, H, W, dnnl::memory::data_type::f32, BlockedFmt, Device.engine);
 #else
 			ReleaseGradient();
@@ -790,7 +984,7 @@ namespace dnn
 		{
 			if (!RefreshingStats.load())
 			{
-				while (Fwd.load() || Bwd.load())
+				while (Fwd.load() || Bwd.load() || Updating.load())
 				{
 					std::this_thread::sleep_for(std::chrono::milliseconds(10));
 					std::this_thread::yield();
@@ -1717,11 +1911,91 @@ namespace dnn
 			}
 		}
 
+		static constexpr auto UpdateBlockSize = UInt(512ull * VectorSize);
+
+		// Runs step vector by vector over the weights (part 0) and the biases (part 1) in one pass, in blocks spread over the threads.
+		// The arrays are aligned, the last partial vector of a part is loaded and stored partially so odd sized tensors vectorize too.
+		// With DeferUpdate set the blocks are left in Sweep for the model to run, together with the blocks of all other layers.
+		template <typename Step>
+		void UpdateParameters(const WeightsStruct& weights, const Step& step)
+		{
+			const auto data = [](FloatVector* vector) { return vector != nullptr && !vector->empty() ? vector->data() : nullptr; };
+			const std::array<std::array<Float*, 5ull>, 2ull> parts =
+			{
+				std::array<Float*, 5ull>{ data(weights.Weights), data(weights.WeightsD1), data(weights.WeightsPar1), data(weights.WeightsPar2), data(weights.WeightsPar3) },
+				std::array<Float*, 5ull>{ data(&Biases), data(&BiasesD1), data(&BiasesPar1), data(&BiasesPar2), data(&BiasesPar3) }
+			};
+			// in place the weights are in the primitive's layout, padding included (it stays zero as its gradients are zero),
+			// the plain copies hold just WeightCount
+			const auto weightCount = weights.Weights == &Weights ? UInt(WeightsMemDesc->get_size() / sizeof(Float)) : WeightCount;
+			const std::array<UInt, 2ull> counts = { weightCount, HasBias ? BiasCount : UInt(0) };
+
+			const auto block = [=](const UInt part, const UInt start, const UInt end, const Float scale)
+			{
+				const auto& p = parts[part];
+
+				VecFloat v[5] = { VecFloat(0), VecFloat(0), VecFloat(0), VecFloat(0), VecFloat(0) };
+				for (auto i = start; i < end; i += VectorSize)
+				{
+					const auto n = int(std::min(UInt(VectorSize), end - i));
+					
+					if (n == int(VectorSize))
+					{
+						for (auto a = 0ull; a < 5ull; a++)
+							if (p[a])
+								v[a].load_a(p[a] + i);
+					}
+					else
+						for (auto a = 0ull; a < 5ull; a++)
+							if (p[a])
+								v[a].load_partial(n, p[a] + i);
+
+					v[1] *= scale;
+					step(part, v[0], v[1], v[2], v[3], v[4]);
+
+					if (n == int(VectorSize))
+					{
+						v[0].store_a(p[0] + i);
+						for (auto a = 2ull; a < 5ull; a++)
+							if (p[a])
+								v[a].store_a(p[a] + i);
+					}
+					else
+					{
+						v[0].store_partial(n, p[0] + i);
+						for (auto a = 2ull; a < 5ull; a++)
+							if (p[a])
+								v[a].store_partial(n, p[a] + i);
+					}
+				}
+			};
+
+			// the plain copies of a reordered layer are gone after UpdateWeights, those run right away
+			if (DeferUpdate && weights.Weights == &Weights)
+			{
+				Sweep = ParameterSweep{ { parts[0][1], parts[1][1] }, counts, block };
+				return;
+			}
+
+			const auto weightBlocks = (counts[0] + UpdateBlockSize - 1) / UpdateBlockSize;
+			const auto biasBlocks = (counts[1] + UpdateBlockSize - 1) / UpdateBlockSize;
+
+			// off the main thread (branch and update workers) omp_get_max_threads is the share omp_set_num_threads gave that thread
+			const auto threads = std::min(GetThreads(counts[0] + counts[1], Float(4)), UInt(std::max(1, omp_get_max_threads())));
+
+			for_i(weightBlocks + biasBlocks, threads, [&](const UInt b)
+			{
+				const auto part = b < weightBlocks ? 0ull : 1ull;
+				const auto start = (part == 0ull ? b : b - weightBlocks) * UpdateBlockSize;
+				block(part, start, std::min(counts[part], start + UpdateBlockSize), Float(1));
+			});
+		}
+
 		inline void AdaBelief(const TrainingRate& rate, WeightsStruct weights)
 		{
 			const auto beta1 = rate.Momentum;
 			const auto beta2 = rate.Beta2;
-			const auto lr = rate.MaximumRate * WeightsLRM;
+			const auto lr = std::array<Float, 2ull>{ rate.MaximumRate * WeightsLRM, rate.MaximumRate * BiasesLRM };
 			const auto eps = rate.Eps;
 			const auto oneMinusBeta1 = (Float(1) - beta1) / rate.N;
 			const auto oneMinusBeta2 = Float(1) - beta2;
@@ -1731,47 +2005,12 @@ namespace dnn
 			const auto oneMinusB1 = Float(1) - B1;
 			const auto oneMinusB2 = Float(1) - B2;
 
-			if (WeightCount % VectorSize != 0)
-			{
-				//PRAGMA_OMP_SIMD()
-				for (auto i = 0ull; i < WeightCount; i++)
-				{
-					(*weights.WeightsPar1)[i] = (beta1 * (*weights.WeightsPar1)[i]) + (oneMinusBeta1 * (*weights.WeightsD1)[i]);
-					(*weights.WeightsPar2)[i] = (beta2 * (*weights.WeightsPar2)[i]) + (oneMinusBeta2 * Square<Float>(((*weights.WeightsD1)[i] * batchRecip) - (*weights.WeightsPar1)[i])) + eps;
-					(*weights.Weights)[i] -= lr * ((*weights.WeightsPar1)[i] / oneMinusB1) / std::sqrt(((*weights.WeightsPar2)[i] / oneMinusB2) + eps);
-				}
-			}
-			else
-			{
-				VecFloat weight, weightD1, par1, par2;
-				for (auto i = 0ull; i < WeightCount; i += VectorSize)
-				{
-					weight.load_a(&(*weights.Weights)[i]);
-					weightD1.load_a(&(*weights.WeightsD1)[i]);
-					par1.load_a(&(*weights.WeightsPar1)[i]);
-					par2.load_a(&(*weights.WeightsPar2)[i]);
-
-					par1 = (beta1 * par1) + (oneMinusBeta1 * weightD1);
-					par2 = (beta2 * par2) + (oneMinusBeta2 * square((weightD1 * batchRecip) - par1)) + eps;
-					weight -= lr * (par1 / oneMinusB1) / square((par2 / oneMinusB2) + eps);
-
-					weight.store_a(&(*weights.Weights)[i]);
-					par1.store_a(&(*weights.WeightsPar1)[i]);
-					par2.store_a(&(*weights.WeightsPar2)[i]);
-				}
-			}
-
-			if (HasBias)
+			UpdateParameters(weights, [=](const UInt part, VecFloat& weight, VecFloat& weightD1, VecFloat& par1, VecFloat& par2, VecFloat&)
 			{
-				const auto lrBias = rate.MaximumRate * BiasesLRM;
-				// PRAGMA_OMP_SIMD()
-				for (auto i = 0ull; i < BiasCount; i++)
-				{
-					BiasesPar1[i] = (beta1 * BiasesPar1[i]) + (oneMinusBeta1 * BiasesD1[i]);
-					BiasesPar2[i] = (beta2 * BiasesPar2[i]) + (oneMinusBeta2 * Square<Float>((BiasesD1[i] * batchRecip) - BiasesPar1[i])) + eps;
-					Biases[i] -= lrBias * (BiasesPar1[i] / oneMinusB1) / std::sqrt((BiasesPar2[i] / oneMinusB2) + eps);
-				}
-			}
+				par1 = (beta1 * par1) + (oneMinusBeta1 * weightD1);
+				par2 = (beta2 * par2) + (oneMinusBeta2 * square((weightD1 * batchRecip) - par1)) + eps;
+				weight -= lr[part] * (par1 / oneMinusB1) / sqrt((par2 / oneMinusB2) + eps);
+			});
 
 			B1 *= beta1;
 			B2 *= beta2;
@@ -1790,93 +2029,17 @@ namespace dnn
 			const auto oneMinusB1 = Float(1) - B1;
 			const auto oneMinusB2 = Float(1) - B2;
 			Gamma = Gamma == Float(0) ? rate.Gamma : Gamma;
-			const auto finalRate = rate.FinalRate * rate.MaximumRate * WeightsLRM;
-			const auto lowerBound = finalRate * (Float(1) - (Float(1) / (Gamma + rate.Gamma)));
-			const auto upperBound = finalRate * (Float(1) + (Float(1) / Gamma));
-			//const auto weightDecay = rate.L2Penalty * WeightsWDM;
-			const auto stepSize = rate.MaximumRate * WeightsLRM * std::sqrt(oneMinusB2) / oneMinusB1;
+			const auto finalRate = std::array<Float, 2ull>{ rate.FinalRate * rate.MaximumRate * WeightsLRM, rate.FinalRate * rate.MaximumRate * BiasesLRM };
+			const auto lowerBound = std::array<Float, 2ull>{ finalRate[0] * (Float(1) - (Float(1) / (Gamma + rate.Gamma))), finalRate[1] * (Float(1) - (Float(1) / (Gamma + rate.Gamma))) };
+			const auto upperBound = std::array<Float, 2ull>{ finalRate[0] * (Float(1) + (Float(1) / Gamma)), finalRate[1] * (Float(1) + (Float(1) / Gamma)) };
+			const auto stepSize = std::array<Float, 2ull>{ rate.MaximumRate * WeightsLRM * std::sqrt(oneMinusB2) / oneMinusB1, rate.MaximumRate * BiasesLRM * std::sqrt(oneMinusB2) / oneMinusB1 };
 
-			if (WeightCount % VectorSize != 0)
+			UpdateParameters(weights, [=](const UInt part, VecFloat& weight, VecFloat& weightD1, VecFloat& par1, VecFloat& par2, VecFloat&)
 			{
-				if (!amsbound)
-					//PRAGMA_OMP_SIMD()
-					for (auto i = 0ull; i < WeightCount; i++)
-					{
-						(*weights.WeightsPar1)[i] = (beta1 * (*weights.WeightsPar1)[i]) + (oneMinusBeta1 * (*weights.WeightsD1)[i] * batchRecip);
-						(*weights.WeightsPar2)[i] = (beta2 * (*weights.WeightsPar2)[i]) + (oneMinusBeta2 * Square<Float>((*weights.WeightsD1)[i] * batchRecip));
-						(*weights.Weights)[i] -= Clamp<Float>(stepSize / (std::sqrt((*weights.WeightsPar2)[i]) + eps), lowerBound, upperBound) * (*weights.WeightsPar1)[i];
-					}
-				else
-					//PRAGMA_OMP_SIMD()
-					for (auto i = 0ull; i < WeightCount; i++)
-					{
-						(*weights.WeightsPar1)[i] = (beta1 * (*weights.WeightsPar1)[i]) + (oneMinusBeta1 * (*weights.WeightsD1)[i] * batchRecip);
-						(*weights.WeightsPar2)[i] = (beta2 * (*weights.WeightsPar2)[i]) + (oneMinusBeta2 * Square<Float>((*weights.WeightsD1)[i] * batchRecip));
-						(*weights.Weights)[i] -= Clamp<Float>(stepSize / (std::sqrt(std::max((*weights.WeightsPar1)[i], (*weights.WeightsPar2)[i])) + eps), lowerBound, upperBound) * (*weights.WeightsPar1)[i];
-					}
-			}
-			else
-			{
-				VecFloat weight, weightD1, par1, par2;
-				if (!amsbound)
-					for (auto i = 0ull; i < WeightCount; i += VectorSize)
-					{
-						weight.load_a(&(*weights.Weights)[i]);
-						weightD1.load_a(&(*weights.WeightsD1)[i]);
-						par1.load_a(&(*weights.WeightsPar1)[i]);
-						par2.load_a(&(*weights.WeightsPar2)[i]);
-
-						par1 = (beta1 * par1) + (oneMinusBeta1 * weightD1 *  batchRecip);
-						par2 = (beta2 * par2) + (oneMinusBeta2 * square(weightD1 * batchRecip));
-						weight -= ClampVecFloat(stepSize / sqrt(par2 + eps), lowerBound, upperBound) * par1;
-
-						weight.store_a(&(*weights.Weights)[i]);
-						par1.store_a(&(*weights.WeightsPar1)[i]);
-						par2.store_a(&(*weights.WeightsPar2)[i]);
-					}
-				else
-					for (auto i = 0ull; i < WeightCount; i += VectorSize)
-					{
-						weight.load_a(&(*weights.Weights)[i]);
-						weightD1.load_a(&(*weights.WeightsD1)[i]);
-						par1.load_a(&(*weights.WeightsPar1)[i]);
-						par2.load_a(&(*weights.WeightsPar2)[i]);
-
-						par1 = (beta1 * par1) + (oneMinusBeta1 * weightD1 * batchRecip);
-						par2 = (beta2 * par2) + (oneMinusBeta2 * square(weightD1 * batchRecip));
-						weight -= ClampVecFloat(stepSize / sqrt(max(par1, par2) + eps), lowerBound, upperBound) * par1;
-
-						weight.store_a(&(*weights.Weights)[i]);
-						par1.store_a(&(*weights.WeightsPar1)[i]);
-						par2.store_a(&(*weights.WeightsPar2)[i]);
-					}
-			}
-
-			if (HasBias)
-			{
-				const auto finalRateBias = rate.FinalRate * rate.MaximumRate * BiasesLRM;
-				const auto lowerBoundBias = finalRateBias * (Float(1) - (Float(1) / (Gamma + rate.Gamma)));
-				const auto upperBoundBias = finalRateBias * (Float(1) + (Float(1) / Gamma));
-				//const auto weightDecay = rate.L2Penalty * BiasesWDM;
-				const auto stepSizeBias = rate.MaximumRate * BiasesLRM * std::sqrt(oneMinusB2) / oneMinusB1;
-
-				if (!amsbound)
-					// PRAGMA_OMP_SIMD()
-					for (auto i = 0ull; i < BiasCount; i++)
-					{
-						BiasesPar1[i] = (beta1 * BiasesPar1[i]) + (oneMinusBeta1 * BiasesD1[i] * batchRecip);
-						BiasesPar2[i] = (beta2 * BiasesPar2[i]) + (oneMinusBeta2 * Square<Float>(BiasesD1[i] * batchRecip));
-						Biases[i] -= Clamp<Float>(stepSizeBias / (std::sqrt(BiasesPar2[i]) + eps), lowerBoundBias, upperBoundBias) * BiasesPar1[i];
-					}
-				else
-					// PRAGMA_OMP_SIMD()
-					for (auto i = 0ull; i < BiasCount; i++)
-					{
-						BiasesPar1[i] = (beta1 * BiasesPar1[i]) + (oneMinusBeta1 * BiasesD1[i] * batchRecip);
-						BiasesPar2[i] = (beta2 * BiasesPar2[i]) + (oneMinusBeta2 * Square<Float>(BiasesD1[i] * batchRecip));
-						Biases[i] -= Clamp<Float>(stepSizeBias / (std::sqrt(std::max(BiasesPar1[i], BiasesPar2[i])) + eps), lowerBoundBias, upperBoundBias) * BiasesPar1[i];
-					}
-			}
+				par1 = (beta1 * par1) + (oneMinusBeta1 * weightD1 * batchRecip);
+				par2 = (beta2 * par2) + (oneMinusBeta2 * square(weightD1 * batchRecip));
+				weight -= ClampVecFloat(stepSize[part] / sqrt((amsbound ? max(par1, par2) : par2) + eps), lowerBound[part], upperBound[part]) * par1;
+			});
 
 			B1 *= beta1;
 			B2 *= beta2;
@@ -1896,99 +2059,19 @@ namespace dnn
 			const auto oneMinusB1 = Float(1) - B1;
 			const auto oneMinusB2 = Float(1) - B2;
 			Gamma = Gamma == Float(0) ? rate.Gamma : Gamma;
-			const auto finalRate = rate.FinalRate * rate.MaximumRate * WeightsLRM;
-			const auto lowerBound = finalRate * (Float(1) - (Float(1) / (Gamma + rate.Gamma)));
-			const auto upperBound = finalRate * (Float(1) + (Float(1) / Gamma));
-			const auto weightDecay = rate.L2Penalty * WeightsWDM;
-			const auto stepSize = rate.MaximumRate * WeightsLRM * std::sqrt(oneMinusB2) / oneMinusB1;
+			const auto finalRate = std::array<Float, 2ull>{ rate.FinalRate * rate.MaximumRate * WeightsLRM, rate.FinalRate * rate.MaximumRate * BiasesLRM };
+			const auto lowerBound = std::array<Float, 2ull>{ finalRate[0] * (Float(1) - (Float(1) / (Gamma + rate.Gamma))), finalRate[1] * (Float(1) - (Float(1) / (Gamma + rate.Gamma))) };
+			const auto upperBound = std::array<Float, 2ull>{ finalRate[0] * (Float(1) + (Float(1) / Gamma)), finalRate[1] * (Float(1) + (Float(1) / Gamma)) };
+			const auto weightDecay = std::array<Float, 2ull>{ rate.L2Penalty * WeightsWDM, rate.L2Penalty * BiasesWDM };
+			const auto stepSize = std::array<Float, 2ull>{ rate.MaximumRate * WeightsLRM * std::sqrt(oneMinusB2) / oneMinusB1, rate.MaximumRate * BiasesLRM * std::sqrt(oneMinusB2) / oneMinusB1 };
 
-			if (WeightCount % VectorSize != 0)
+			UpdateParameters(weights, [=](const UInt part, VecFloat& weight, VecFloat& weightD1, VecFloat& par1, VecFloat& par2, VecFloat&)
 			{
-				if (!amsbound)
-					//PRAGMA_OMP_SIMD()
-					for (auto i = 0ull; i < WeightCount; i++)
-					{
-						(*weights.WeightsD1)[i] += weightDecay * (*weights.Weights)[i];
-						(*weights.WeightsPar1)[i] = (beta1 * (*weights.WeightsPar1)[i]) + (oneMinusBeta1 * (*weights.WeightsD1)[i] * batchRecip);
-						(*weights.WeightsPar2)[i] = (beta2 * (*weights.WeightsPar2)[i]) + (oneMinusBeta2 * Square<Float>((*weights.WeightsD1)[i] * batchRecip));
-						(*weights.Weights)[i] -= Clamp<Float>(stepSize / (std::sqrt((*weights.WeightsPar2)[i]) + eps), lowerBound, upperBound) * (*weights.WeightsPar1)[i];
-					}
-				else
-					//PRAGMA_OMP_SIMD()
-					for (auto i = 0ull; i < WeightCount; i++)
-					{
-						(*weights.WeightsD1)[i] += weightDecay * (*weights.Weights)[i];
-						(*weights.WeightsPar1)[i] = (beta1 * (*weights.WeightsPar1)[i]) + (oneMinusBeta1 * (*weights.WeightsD1)[i] * batchRecip);
-						(*weights.WeightsPar2)[i] = (beta2 * (*weights.WeightsPar2)[i]) + (oneMinusBeta2 * Square<Float>((*weights.WeightsD1)[i] * batchRecip));
-						(*weights.Weights)[i] -= Clamp<Float>(stepSize / (std::sqrt(std::max((*weights.WeightsPar1)[i], (*weights.WeightsPar2)[i])) + eps), lowerBound, upperBound) * (*weights.WeightsPar1)[i];
-					}
-			}
-			else
-			{
-				VecFloat weight, weightD1, par1, par2;
-				if (!amsbound)
-					for (auto i = 0ull; i < WeightCount; i += VectorSize)
-					{
-						weight.load_a(&(*weights.Weights)[i]);
-						weightD1.load_a(&(*weights.WeightsD1)[i]);
-						par1.load_a(&(*weights.WeightsPar1)[i]);
-						par2.load_a(&(*weights.WeightsPar2)[i]);
-
-						weightD1 += weightDecay * weight;
-						par1 = (beta1 * par1) + (oneMinusBeta1 * weightD1 * batchRecip);
-						par2 = (beta2 * par2) + (oneMinusBeta2 * square(weightD1 * batchRecip));
-						weight -= ClampVecFloat(stepSize / sqrt(par2 + eps), lowerBound, upperBound) * par1;
-
-						weight.store_a(&(*weights.Weights)[i]);
-						par1.store_a(&(*weights.WeightsPar1)[i]);
-						par2.store_a(&(*weights.WeightsPar2)[i]);
-					}
-				else
-					for (auto i = 0ull; i < WeightCount; i += VectorSize)
-					{
-						weight.load_a(&(*weights.Weights)[i]);
-						weightD1.load_a(&(*weights.WeightsD1)[i]);
-						par1.load_a(&(*weights.WeightsPar1)[i]);
-						par2.load_a(&(*weights.WeightsPar2)[i]);
-
-						weightD1 += weightDecay * weight;
-						par1 = (beta1 * par1) + (oneMinusBeta1 * weightD1 * batchRecip);
-						par2 = (beta2 * par2) + (oneMinusBeta2 * square(weightD1 * batchRecip));
-						weight -= ClampVecFloat(stepSize / sqrt(max(par1, par2) + eps), lowerBound, upperBound) * par1;
-
-						weight.store_a(&(*weights.Weights)[i]);
-						par1.store_a(&(*weights.WeightsPar1)[i]);
-						par2.store_a(&(*weights.WeightsPar2)[i]);
-					}
-			}
-
-			if (HasBias)
-			{
-				const auto finalRateBias = rate.FinalRate * rate.MaximumRate * BiasesLRM;
-				const auto lowerBoundBias = finalRateBias * (Float(1) - (Float(1) / (Gamma + rate.Gamma)));
-				const auto upperBoundBias = finalRateBias * (Float(1) + (Float(1) / Gamma));
-				const auto weightDecayBias = rate.L2Penalty * BiasesWDM;
-				const auto stepSizeBias = rate.MaximumRate * BiasesLRM * std::sqrt(oneMinusB2) / oneMinusB1;
-
-				if (!amsbound)
-					// PRAGMA_OMP_SIMD()
-					for (auto i = 0ull; i < BiasCount; i++)
-					{
-						BiasesD1[i] += weightDecayBias * Biases[i];
-						BiasesPar1[i] = (beta1 * BiasesPar1[i]) + (oneMinusBeta1 * BiasesD1[i] * batchRecip);
-						BiasesPar2[i] = (beta2 * BiasesPar2[i]) + (oneMinusBeta2 * Square<Float>(BiasesD1[i] * batchRecip));
-						Biases[i] -= Clamp<Float>(stepSizeBias / std::sqrt(BiasesPar2[i] + eps), lowerBoundBias, upperBoundBias) * BiasesPar1[i];
-					}
-				else
-					// PRAGMA_OMP_SIMD()
-					for (auto i = 0ull; i < BiasCount; i++)
-					{
-						BiasesD1[i] += weightDecayBias * Biases[i];
-						BiasesPar1[i] = (beta1 * BiasesPar1[i]) + (oneMinusBeta1 * BiasesD1[i] * batchRecip);
-						BiasesPar2[i] = (beta2 * BiasesPar2[i]) + (oneMinusBeta2 * Square<Float>(BiasesD1[i] * batchRecip));
-						Biases[i] -= Clamp<Float>(stepSizeBias / (std::sqrt(std::max(BiasesPar1[i], BiasesPar2[i])) + eps), lowerBoundBias, upperBoundBias) * BiasesPar1[i];
-					}
-			}
+				weightD1 += weightDecay[part] * weight;
+				par1 = (beta1 * par1) + (oneMinusBeta1 * weightD1 * batchRecip);
+				par2 = (beta2 * par2) + (oneMinusBeta2 * square(weightD1 * batchRecip));
+				weight -= ClampVecFloat(stepSize[part] / sqrt((amsbound ? max(par1, par2) : par2) + eps), lowerBound[part], upperBound[part]) * par1;
+			});
 
 			B1 *= beta1;
 			B2 *= beta2;
@@ -1997,88 +2080,39 @@ namespace dnn
 
 		inline void AdaDelta(const TrainingRate& rate, WeightsStruct weights)
 		{
-			const auto lr = -rate.MaximumRate * WeightsLRM;
+			const auto lr = std::array<Float, 2ull>{ -rate.MaximumRate * WeightsLRM, -rate.MaximumRate * BiasesLRM };
 			const auto momentum = rate.Momentum;
 			const auto oneMinMomentum = Float(1) - momentum;
 			const auto eps = rate.Eps;
 			const auto batchRecip = Float(1) / rate.N;
 
-			
-			if (WeightCount % VectorSize != 0)
+			UpdateParameters(weights, [=](const UInt part, VecFloat& weight, VecFloat& weightD1, VecFloat& par1, VecFloat& par2, VecFloat&)
 			{
-				for (auto i = 0ull; i < WeightCount; i++)
-				{
-					(*weights.WeightsPar1)[i] = (momentum * (*weights.WeightsPar1)[i]) + (oneMinMomentum * Square<Float>((*weights.WeightsD1)[i] * batchRecip));
-					const auto update = lr * (std::sqrt((*weights.WeightsPar2)[i] + eps) / std::sqrt((*weights.WeightsPar1)[i] + eps)) * (*weights.WeightsD1)[i] * batchRecip;
-					(*weights.WeightsPar2)[i] = (momentum * (*weights.WeightsPar2)[i]) + (oneMinMomentum * Square<Float>(update));
-					(*weights.Weights)[i] += update;
-				}
-			}
-			else
-			{
-				VecFloat weight, weightD1, par1, par2;
-				for (auto i = 0ull; i < WeightCount; i += VectorSize)
-				{
-					weight.load_a(&(*weights.Weights)[i]);
-					weightD1.load_a(&(*weights.WeightsD1)[i]);
-					par1.load_a(&(*weights.WeightsPar1)[i]);
-					par2.load_a(&(*weights.WeightsPar2)[i]);
-
-					par1 = (momentum * par1) + (oneMinMomentum * square(weightD1 * batchRecip));
-					const auto update = lr * (sqrt(par2 + eps) / sqrt(par1 + eps)) * weightD1 * batchRecip;
-					par2 = (momentum * par2) + (oneMinMomentum * square(update));
-					weight += update;
-
-					weight.store_a(&(*weights.Weights)[i]);
-					par1.store_a(&(*weights.WeightsPar1)[i]);
-					par2.store_a(&(*weights.WeightsPar2)[i]);
-				}
-			}
-
-			if (HasBias)
-			{
-				const auto lrBias = -rate.MaximumRate * BiasesLRM;
-				// PRAGMA_OMP_SIMD()
-				for (auto i = 0ull; i < BiasCount; i++)
-				{
-					BiasesPar1[i] = (momentum * BiasesPar1[i]) + (oneMinMomentum * Square<Float>(BiasesD1[i] * batchRecip));
-					const auto update = lrBias * (std::sqrt(BiasesPar2[i] + eps) / std::sqrt(BiasesPar1[i] + eps)) * BiasesD1[i] * batchRecip;
-					BiasesPar2[i] = (momentum * BiasesPar2[i]) + (oneMinMomentum * Square<Float>(update));
-					Biases[i] += update;
-				}
-			}
+				par1 = (momentum * par1) + (oneMinMomentum * square(weightD1 * batchRecip));
+				const auto update = lr[part] * (sqrt(par2 + eps) / sqrt(par1 + eps)) * weightD1 * batchRecip;
+				par2 = (momentum * par2) + (oneMinMomentum * square(update));
+				weight += update;
+			});
 		}
 
 		inline void AdaGrad(const TrainingRate& rate, WeightsStruct weights)
 		{
-			const auto lr = rate.MaximumRate * WeightsLRM;
+			const auto lr = std::array<Float, 2ull>{ rate.MaximumRate * WeightsLRM, rate.MaximumRate * BiasesLRM };
 			const auto eps = rate.Eps;
 			const auto batchRecip = Float(1) / rate.N;
 
-			//PRAGMA_OMP_SIMD()
-			for (auto i = 0ull; i < WeightCount; i++)
-			{
-				(*weights.WeightsPar1)[i] += Square<Float>((*weights.WeightsD1)[i] * batchRecip);
-				(*weights.Weights)[i] -= lr * (*weights.WeightsD1)[i] / (std::sqrt((*weights.WeightsPar1)[i]) + eps);
-			}
-
-			if (HasBias)
+			UpdateParameters(weights, [=](const UInt part, VecFloat& weight, VecFloat& weightD1, VecFloat& par1, VecFloat&, VecFloat&)
 			{
-				const auto lrBias = rate.MaximumRate * BiasesLRM;
-				//PRAGMA_OMP_SIMD()
-				for (auto i = 0ull; i < BiasCount; i++)
-				{
-					BiasesPar1[i] += Square<Float>(BiasesD1[i] * batchRecip);
-					Biases[i] -= lrBias * BiasesD1[i] / (std::sqrt(BiasesPar1[i]) + eps);
-				}
-			}
+				par1 += square(weightD1 * batchRecip);
+				weight -= lr[part] * weightD1 / (sqrt(par1) + eps);
+			});
 		}
 
 		inline void Adam(const TrainingRate& rate, WeightsStruct weights)
 		{
 			const auto beta1 = rate.Momentum;
 			const auto beta2 = rate.Beta2;
-			const auto lr = rate.MaximumRate * WeightsLRM;
+			const auto lr = std::array<Float, 2ull>{ rate.MaximumRate * WeightsLRM, rate.MaximumRate * BiasesLRM };
 			const auto eps = rate.Eps;
 			const auto oneMinusBeta1 = (Float(1) - beta1) / rate.N;
 			const auto oneMinusBeta2 = Float(1) - beta2;
@@ -2088,47 +2122,12 @@ namespace dnn
 			const auto oneMinusB1 = Float(1) - B1;
 			const auto oneMinusB2 = Float(1) - B2;
 
-			
-			if (WeightCount % VectorSize != 0)
-			{
-				for (auto i = 0ull; i < WeightCount; i++)
-				{
-					(*weights.WeightsPar1)[i] = (beta1 * (*weights.WeightsPar1)[i]) + (oneMinusBeta1 * (*weights.WeightsD1)[i]);
-					(*weights.WeightsPar2)[i] = (beta2 * (*weights.WeightsPar2)[i]) + (oneMinusBeta2 * Square<Float>((*weights.WeightsD1)[i] * batchRecip));
-					(*weights.Weights)[i] -= lr * ((*weights.WeightsPar1)[i] / oneMinusB1) / std::sqrt(((*weights.WeightsPar2)[i] / oneMinusB2) + eps);
-				}
-			}
-			else
+			UpdateParameters(weights, [=](const UInt part, VecFloat& weight, VecFloat& weightD1, VecFloat& par1, VecFloat& par2, VecFloat&)
 			{
-				VecFloat weight, weightD1, par1, par2;
-				for (auto i = 0ull; i < WeightCount; i += VectorSize)
-				{
-					weight.load_a(&(*weights.Weights)[i]);
-					weightD1.load_a(&(*weights.WeightsD1)[i]);
-					par1.load_a(&(*weights.WeightsPar1)[i]);
-					par2.load_a(&(*weights.WeightsPar2)[i]);
-
-					par1 = (beta1 * par1) + (oneMinusBeta1 * weightD1);
-					par2 = (beta2 * par2) + (oneMinusBeta2 * square(weightD1 * batchRecip));
-					weight -= lr * (par1 / oneMinusB1) / sqrt((par2 / oneMinusB2) + eps);
-
-					weight.store_a(&(*weights.Weights)[i]);
-					par1.store_a(&(*weights.WeightsPar1)[i]);
-					par2.store_a(&(*weights.WeightsPar2)[i]);
-				}
-			}
-
-			if (HasBias)
-			{
-				const auto lrBias = rate.MaximumRate * BiasesLRM;
-				// PRAGMA_OMP_SIMD()
-				for (auto i = 0ull; i < BiasCount; i++)
-				{
-					BiasesPar1[i] = (beta1 * BiasesPar1[i]) + (oneMinusBeta1 * BiasesD1[i]);
-					BiasesPar2[i] = (beta2 * BiasesPar2[i]) + (oneMinusBeta2 * Square<Float>(BiasesD1[i] * batchRecip));
-					Biases[i] -= lrBias * (BiasesPar1[i] / oneMinusB1) / std::sqrt((BiasesPar2[i] / oneMinusB2) + eps);
-				}
-			}
+				par1 = (beta1 * par1) + (oneMinusBeta1 * weightD1);
+				par2 = (beta2 * par2) + (oneMinusBeta2 * square(weightD1 * batchRecip));
+				weight -= lr[part] * (par1 / oneMinusB1) / sqrt((par2 / oneMinusB2) + eps);
+			});
 
 			B1 *= beta1;
 			B2 *= beta2;
@@ -2138,53 +2137,18 @@ namespace dnn
 		{
 			const auto beta1 = rate.Momentum;
 			B1 = B1 == Float(0) ? beta1 : B1;
-			const auto lr = rate.MaximumRate * WeightsLRM / (Float(1) - B1);
+			const auto lr = std::array<Float, 2ull>{ rate.MaximumRate * WeightsLRM / (Float(1) - B1), rate.MaximumRate * BiasesLRM / (Float(1) - B1) };
 			const auto batchRecip = Float(1) / rate.N;
 			const auto oneMinusBeta1 = (Float(1) - beta1) / rate.N;
 			const auto beta2 = rate.Beta2;
 			const auto eps = rate.Eps;
 
-			
-			if (WeightCount % VectorSize != 0)
+			UpdateParameters(weights, [=](const UInt part, VecFloat& weight, VecFloat& weightD1, VecFloat& par1, VecFloat& par2, VecFloat&)
 			{
-				for (auto i = 0ull; i < WeightCount; i++)
-				{
-					(*weights.WeightsPar1)[i] = (beta1 * (*weights.WeightsPar1)[i]) + (oneMinusBeta1 * (*weights.WeightsD1)[i]);
-					(*weights.WeightsPar2)[i] = std::max(beta2 * (*weights.WeightsPar2)[i], std::abs((*weights.WeightsD1)[i] * batchRecip));
-					(*weights.Weights)[i] -= lr * (*weights.WeightsPar1)[i] / ((*weights.WeightsPar2)[i] + eps);
-				}
-			}
-			else
-			{
-				VecFloat weight, weightD1, par1, par2;
-				for (auto i = 0ull; i < WeightCount; i += VectorSize)
-				{
-					weight.load_a(&(*weights.Weights)[i]);
-					weightD1.load_a(&(*weights.WeightsD1)[i]);
-					par1.load_a(&(*weights.WeightsPar1)[i]);
-					par2.load_a(&(*weights.WeightsPar2)[i]);
-
-					par1 = (beta1 * par1) + (oneMinusBeta1 * weightD1);
-					par2 = max(beta2 * par2, abs(weightD1 * batchRecip));
-					weight -= lr * par1 / (par2 + eps);
-
-					weight.store_a(&(*weights.Weights)[i]);
-					par1.store_a(&(*weights.WeightsPar1)[i]);
-					par2.store_a(&(*weights.WeightsPar2)[i]);
-				}
-			}
-
-			if (HasBias)
-			{
-				const auto lrBias = rate.MaximumRate * BiasesLRM / (Float(1) - B1);
-				// PRAGMA_OMP_SIMD()
-				for (auto i = 0ull; i < BiasCount; i++)
-				{
-					BiasesPar1[i] = (beta1 * BiasesPar1[i]) + (oneMinusBeta1 * BiasesD1[i]);
-					BiasesPar2[i] = std::max(beta2 * BiasesPar2[i], std::abs(BiasesD1[i] * batchRecip));
-					Biases[i] -= lrBias * BiasesPar1[i] / (BiasesPar2[i] + eps);
-				}
-			}
+				par1 = (beta1 * par1) + (oneMinusBeta1 * weightD1);
+				par2 = max(beta2 * par2, abs(weightD1 * batchRecip));
+				weight -= lr[part] * par1 / (par2 + eps);
+			});
 
 			B1 *= beta1;
 		}
@@ -2193,8 +2157,9 @@ namespace dnn
 		{
 			const auto beta1 = rate.Momentum;
 			const auto beta2 = rate.Beta2;
-			const auto lr = rate.MaximumRate * WeightsLRM;
-			const auto weightDecay = rate.L2Penalty * WeightsWDM;
+			const auto lr = std::array<Float, 2ull>{ rate.MaximumRate * WeightsLRM, rate.MaximumRate * BiasesLRM };
+			const auto weightDecay = std::array<Float, 2ull>{ rate.L2Penalty * WeightsWDM, rate.L2Penalty * BiasesWDM };
+			const auto count = std::array<Float, 2ull>{ Float(WeightCount), Float(BiasCount) };
 			const auto eps = rate.Eps;
 			const auto oneMinusBeta1 = Float(1) - beta1;
 			const auto oneMinusBeta2 = Float(1) - beta2;
@@ -2204,58 +2169,17 @@ namespace dnn
 			const auto oneMinusB1 = Float(1) - B1;
 			const auto oneMinusB2 = Float(1) - B2;
 
-			if (WeightCount % VectorSize != 0)
+			UpdateParameters(weights, [=](const UInt part, VecFloat& weight, VecFloat& weightD1, VecFloat& par1, VecFloat& par2, VecFloat&)
 			{
-				for (auto i = 0ull; i < WeightCount; i++)
-				{
-					(*weights.WeightsPar1)[i] = (beta1 * (*weights.WeightsPar1)[i]) + (oneMinusBeta1 * (*weights.WeightsD1)[i] * batchRecip);
-					(*weights.WeightsPar2)[i] = (beta2 * (*weights.WeightsPar2)[i]) + (oneMinusBeta2 * Square<Float>((*weights.WeightsD1)[i] * batchRecip));
-					const auto p1 = (*weights.WeightsPar1)[i] / oneMinusB1;
-					const auto p2 = (*weights.WeightsPar2)[i] / oneMinusB2;
-					const auto p2mean = std::sqrt(p2 / Float(WeightCount));
-					(*weights.Weights)[i] -= (lr / std::sqrt(p2 + eps) * p1) - ((Float(1) - weightDecay * lr / p2mean) * (*weights.Weights)[i]);
-				}
-			}
-			else
-			{
-				VecFloat weight, weightD1, par1, par2;
-				for (auto i = 0ull; i < WeightCount; i += VectorSize)
-				{
-					weight.load_a(&(*weights.Weights)[i]);
-					weightD1.load_a(&(*weights.WeightsD1)[i]);
-					par1.load_a(&(*weights.WeightsPar1)[i]);
-					par2.load_a(&(*weights.WeightsPar2)[i]);
-
-					par1 = (beta1 * par1) + (oneMinusBeta1 * weightD1 * batchRecip);
-					par2 = (beta2 * par2) + (oneMinusBeta2 * square(weightD1 * batchRecip));
-					const auto p1 = par1 / oneMinusB1;
-					const auto p2 = par2 / oneMinusB2;
-					const auto p2mean = sqrt(p2 / Float(WeightCount));
-
-					weight -= (lr / sqrt(p2 + eps) * p1) - ((Float(1) - weightDecay * lr / p2mean) * weight);
-
-					weight.store_a(&(*weights.Weights)[i]);
-					par1.store_a(&(*weights.WeightsPar1)[i]);
-					par2.store_a(&(*weights.WeightsPar2)[i]);
-				}
-			}
+				par1 = (beta1 * par1) + (oneMinusBeta1 * weightD1 * batchRecip);
+				par2 = (beta2 * par2) + (oneMinusBeta2 * square(weightD1 * batchRecip));
+				const auto p1 = par1 / oneMinusB1;
+				const auto p2 = par2 / oneMinusB2;
+				const auto p2mean = sqrt(p2 / count[part]);
 
-			if (HasBias)
-			{
-				const auto lrBias = rate.MaximumRate * BiasesLRM;
-				const auto weightDecayBias = rate.L2Penalty * BiasesWDM;
-				// PRAGMA_OMP_SIMD()
-				for (auto i = 0ull; i < BiasCount; i++)
-				{
-					BiasesPar1[i] = (beta1 * BiasesPar1[i]) + (oneMinusBeta1 * BiasesD1[i] * batchRecip);
-					BiasesPar2[i] = (beta2 * BiasesPar2[i]) + (oneMinusBeta2 * Square<Float>(BiasesD1[i] * batchRecip));
-					const auto p1 = BiasesPar1[i] / oneMinusB1;
-					const auto p2 = BiasesPar2[i] / oneMinusB2;
-					const auto p2mean = std::sqrt(p2 / Float(BiasCount));
-					
-					Biases[i] -= (lrBias / std::sqrt(p2 + eps) * p1) - ((Float(1) - weightDecayBias * lrBias / p2mean) * Biases[i]);
-				}
-			}
+				// the zero padding of a blocked layout never sees a gradient, its decay term would be 0 * inf
+				weight -= (lr[part] / sqrt(p2 + eps) * p1) - select(p2 > Float(0), (Float(1) - weightDecay[part] * lr[part] / p2mean) * weight, VecFloat(0));
+			});
 
 			B1 *= beta1;
 			B2 *= beta2;
@@ -2265,8 +2189,8 @@ namespace dnn
 		{
 			const auto beta1 = rate.Momentum;
 			const auto beta2 = rate.Beta2;
-			const auto lr = rate.MaximumRate * WeightsLRM;
-			const auto weightDecay = lr * rate.L2Penalty * WeightsWDM;
+			const auto lr = std::array<Float, 2ull>{ rate.MaximumRate * WeightsLRM, rate.MaximumRate * BiasesLRM };
+			const auto weightDecay = std::array<Float, 2ull>{ lr[0] * rate.L2Penalty * WeightsWDM, lr[1] * rate.L2Penalty * BiasesWDM };
 			const auto eps = rate.Eps;
 			const auto oneMinusBeta1 = Float(1) - beta1;
 			const auto oneMinusBeta2 = Float(1) - beta2;
@@ -2276,48 +2200,12 @@ namespace dnn
 			const auto oneMinusB1 = Float(1) - B1;
 			const auto oneMinusB2 = Float(1) - B2;
 
-			
-			if (WeightCount % VectorSize != 0)
+			UpdateParameters(weights, [=](const UInt part, VecFloat& weight, VecFloat& weightD1, VecFloat& par1, VecFloat& par2, VecFloat&)
 			{
-				for (auto i = 0ull; i < WeightCount; i++)
-				{
-					(*weights.WeightsPar1)[i] = (beta1 * (*weights.WeightsPar1)[i]) + (oneMinusBeta1 * (*weights.WeightsD1)[i] * batchRecip);
-					(*weights.WeightsPar2)[i] = (beta2 * (*weights.WeightsPar2)[i]) + (oneMinusBeta2 * Square<Float>((*weights.WeightsD1)[i] * batchRecip));
-					(*weights.Weights)[i] -= lr * (((*weights.WeightsPar1)[i] / oneMinusB1) / std::sqrt(((*weights.WeightsPar2)[i] / oneMinusB2) + eps) - (weightDecay * (*weights.Weights)[i]));
-				}
-			}
-			else
-			{
-				VecFloat weight, weightD1, par1, par2;
-				for (auto i = 0ull; i < WeightCount; i += VectorSize)
-				{
-					weight.load_a(&(*weights.Weights)[i]);
-					weightD1.load_a(&(*weights.WeightsD1)[i]);
-					par1.load_a(&(*weights.WeightsPar1)[i]);
-					par2.load_a(&(*weights.WeightsPar2)[i]);
-
-					par1 = (beta1 * par1) + (oneMinusBeta1 * weightD1 * batchRecip);
-					par2 = (beta2 * par2) + (oneMinusBeta2 * square(weightD1 * batchRecip));
-					weight -= lr * (par1 / oneMinusB1) / sqrt((par2 / oneMinusB2) + eps) - (weightDecay * weight);
-
-					weight.store_a(&(*weights.Weights)[i]);
-					par1.store_a(&(*weights.WeightsPar1)[i]);
-					par2.store_a(&(*weights.WeightsPar2)[i]);
-				}
-			}
-
-			if (HasBias)
-			{
-				const auto lrBias = rate.MaximumRate * BiasesLRM;
-				const auto weightDecayBias = lrBias * rate.L2Penalty * BiasesWDM;
-				// PRAGMA_OMP_SIMD()
-				for (auto i = 0ull; i < BiasCount; i++)
-				{
-					BiasesPar1[i] = (beta1 * BiasesPar1[i]) + (oneMinusBeta1 * BiasesD1[i] * batchRecip);
-					BiasesPar2[i] = (beta2 * BiasesPar2[i]) + (oneMinusBeta2 * Square<Float>(BiasesD1[i] * batchRecip));
-					Biases[i] -= lrBias * ((BiasesPar1[i] / oneMinusB1) / std::sqrt((BiasesPar2[i] / oneMinusB2) + eps) - (weightDecayBias * Biases[i]));
-				}
-			}
+				par1 = (beta1 * par1) + (oneMinusBeta1 * weightD1 * batchRecip);
+				par2 = (beta2 * par2) + (oneMinusBeta2 * square(weightD1 * batchRecip));
+				weight -= lr[part] * (par1 / oneMinusB1) / sqrt((par2 / oneMinusB2) + eps) - (weightDecay[part] * weight);
+			});
 
 			B1 *= beta1;
 			B2 *= beta2;
@@ -2327,8 +2215,8 @@ namespace dnn
 		{
 			const auto beta1 = rate.Momentum;
 			const auto beta2 = rate.Beta2;
-			const auto lr = rate.MaximumRate * WeightsLRM;
-			const auto weightDecay = rate.L2Penalty * WeightsWDM;
+			const auto lr = std::array<Float, 2ull>{ rate.MaximumRate * WeightsLRM, rate.MaximumRate * BiasesLRM };
+			const auto weightDecay = std::array<Float, 2ull>{ rate.L2Penalty * WeightsWDM, rate.L2Penalty * BiasesWDM };
 			const auto eps = rate.Eps;
 			const auto oneMinusBeta1 = (Float(1) - beta1) / rate.N;
 			const auto oneMinusBeta2 = Float(1) - beta2;
@@ -2338,68 +2226,18 @@ namespace dnn
 			const auto oneMinusB1 = Float(1) - B1;
 			const auto oneMinusB2 = Float(1) - B2;
 
-
-			if (WeightCount % VectorSize != 0)
+			UpdateParameters(weights, [=](const UInt part, VecFloat& weight, VecFloat& weightD1, VecFloat& par1, VecFloat& par2, VecFloat& par3)
 			{
-				for (auto i = 0ull; i < WeightCount; i++)
-				{
-					(*weights.WeightsPar1)[i] = (beta1 * (*weights.WeightsPar1)[i]) + (oneMinusBeta1 * (*weights.WeightsD1)[i]);
-					(*weights.WeightsPar2)[i] = (beta2 * (*weights.WeightsPar2)[i]) + (oneMinusBeta2 * Square<Float>((*weights.WeightsD1)[i] * batchRecip));
-
-					auto diff = std::abs((*weights.WeightsPar3)[i] - (*weights.WeightsD1)[i]);
-					auto dfc = Float(1) / (Float(1) + std::exp(-diff));
-					(*weights.WeightsPar3)[i] = (*weights.WeightsD1)[i];
-					auto exp_avg1 = ((*weights.WeightsPar1)[i] / oneMinusB1) * dfc;
+				par1 = (beta1 * par1) + (oneMinusBeta1 * weightD1);
+				par2 = (beta2 * par2) + (oneMinusBeta2 * square(weightD1 * batchRecip));
 
-					(*weights.Weights)[i] -= lr * exp_avg1 / std::sqrt(((*weights.WeightsPar2)[i] / oneMinusB2) + eps) + (weightDecay * (*weights.Weights)[i]);
-				}
-			}
-			else
-			{
-				VecFloat weight, weightD1, par1, par2, par3;
-				for (auto i = 0ull; i < WeightCount; i += VectorSize)
-				{
-					weight.load_a(&(*weights.Weights)[i]);
-					weightD1.load_a(&(*weights.WeightsD1)[i]);
-					par1.load_a(&(*weights.WeightsPar1)[i]);
-					par2.load_a(&(*weights.WeightsPar2)[i]);
-					par3.load_a(&(*weights.WeightsPar3)[i]);
-
-					par1 = (beta1 * par1) + (oneMinusBeta1 * weightD1);
-					par2 = (beta2 * par2) + (oneMinusBeta2 * square(weightD1 * batchRecip));
-
-					auto diff = abs(par3 - weightD1);
-					auto dfc = VecFloat(1) / (VecFloat(1) + exp(-diff));
-					par3 = weightD1;
-					auto exp_avg1 = (par1 / oneMinusB1) * dfc;
-					
-					weight -= lr * exp_avg1 / sqrt((par2 / oneMinusB2) + eps) + (weightDecay * weight);
+				const auto diff = abs(par3 - weightD1);
+				const auto dfc = VecFloat(1) / (VecFloat(1) + exp(-diff));
+				par3 = weightD1;
+				const auto exp_avg1 = (par1 / oneMinusB1) * dfc;
 
-					weight.store_a(&(*weights.Weights)[i]);
-					par1.store_a(&(*weights.WeightsPar1)[i]);
-					par2.store_a(&(*weights.WeightsPar2)[i]);
-					par3.store_a(&(*weights.WeightsPar3)[i]);
-				}
-			}
-
-			if (HasBias)
-			{
-				const auto lrBias = rate.MaximumRate * BiasesLRM;
-				const auto weightDecayBias = rate.L2Penalty * BiasesWDM;
-				// PRAGMA_OMP_SIMD()
-				for (auto i = 0ull; i < BiasCount; i++)
-				{
-					BiasesPar1[i] = (beta1 * BiasesPar1[i]) + (oneMinusBeta1 * BiasesD1[i]);
-					BiasesPar2[i] = (beta2 * BiasesPar2[i]) + (oneMinusBeta2 * Square<Float>(BiasesD1[i] * batchRecip));
-
-					auto diff = std::abs(BiasesPar3[i] - BiasesD1[i]);
-					auto dfc = Float(1) / (Float(1) + std::exp(-diff));
-					BiasesPar3[i] = BiasesD1[i];
-					auto exp_avg1 = (BiasesPar1[i] / oneMinusB1) * dfc;
-										
-					Biases[i] -= lrBias * exp_avg1 / std::sqrt((BiasesPar2[i] / oneMinusB2) + eps) + (weightDecayBias * Biases[i]);
-				}
-			}
+				weight -= lr[part] * exp_avg1 / sqrt((par2 / oneMinusB2) + eps) + (weightDecay[part] * weight);
+			});
 
 			B1 *= beta1;
 			B2 *= beta2;
@@ -2407,127 +2245,70 @@ namespace dnn
 
 		inline void NAG(const TrainingRate& rate, WeightsStruct weights)
 		{
-			const auto lr = rate.MaximumRate * WeightsLRM;
-			const auto l2Penalty = rate.L2Penalty * WeightsWDM * lr;
+			const auto lr = std::array<Float, 2ull>{ rate.MaximumRate * WeightsLRM, rate.MaximumRate * BiasesLRM };
+			const auto l2Penalty = std::array<Float, 2ull>{ rate.L2Penalty * WeightsWDM * lr[0], Float(0) };
 			const auto momentum = rate.Momentum;
 			const auto momentumPlusOne = momentum + Float(1);
-			const auto batchRecip = Float(1) / rate.N * lr;
-			
-			PRAGMA_OMP_SIMD()
-			for (auto i = 0ull; i < WeightCount; i++)
-			{
-				const auto V = momentum * (*weights.WeightsPar1)[i] - ((*weights.WeightsD1)[i] * batchRecip + (*weights.Weights)[i] * l2Penalty);
-				(*weights.Weights)[i] += -momentum * (*weights.WeightsPar1)[i] + momentumPlusOne * V;
-				(*weights.WeightsPar1)[i] = V;
-			}
+			const auto batchRecip = std::array<Float, 2ull>{ Float(1) / rate.N * lr[0], Float(1) / rate.N * lr[1] };
 
-			if (HasBias)
+			UpdateParameters(weights, [=](const UInt part, VecFloat& weight, VecFloat& weightD1, VecFloat& par1, VecFloat&, VecFloat&)
 			{
-				const auto lrBias = rate.MaximumRate * BiasesLRM;
-				const auto batchRecipBias = Float(1) / rate.N * lrBias;
-				PRAGMA_OMP_SIMD()
-				for (auto i = 0ull; i < BiasCount; i++)
-				{
-					const auto V = momentum * BiasesPar1[i] - BiasesD1[i] * batchRecipBias;
-					Biases[i] += -momentum * BiasesPar1[i] + momentumPlusOne * V;
-					BiasesPar1[i] = V;
-				}
-			}
+				const auto V = momentum * par1 - (weightD1 * batchRecip[part] + weight * l2Penalty[part]);
+				weight += -momentum * par1 + momentumPlusOne * V;
+				par1 = V;
+			});
 		}
 
 		inline void RMSProp(const TrainingRate& rate, WeightsStruct weights)
 		{
-			const auto lr = rate.MaximumRate * WeightsLRM / rate.N;
+			const auto lr = std::array<Float, 2ull>{ rate.MaximumRate * WeightsLRM / rate.N, rate.MaximumRate * BiasesLRM / rate.N };
 			const auto eps = rate.Eps;
 			const auto momentum = rate.Momentum;
 			const auto oneMinusMomentum = Float(1) - momentum;
 			const auto batchRecip = Float(1) / rate.N;
 
-			//PRAGMA_OMP_SIMD()
-			for (auto i = 0ull; i < WeightCount; i++)
+			UpdateParameters(weights, [=](const UInt part, VecFloat& weight, VecFloat& weightD1, VecFloat& par1, VecFloat&, VecFloat&)
 			{
-				(*weights.WeightsPar1)[i] = (momentum * (*weights.WeightsPar1)[i]) + (oneMinusMomentum * Square<Float>((*weights.WeightsD1)[i] * batchRecip));
-				(*weights.Weights)[i] -= lr * (*weights.WeightsD1)[i] / std::sqrt((*weights.WeightsPar1)[i] + eps);
-			}
-
-			if (HasBias)
-			{
-				const auto lrBias = rate.MaximumRate * BiasesLRM / rate.N;
-				//PRAGMA_OMP_SIMD()
-				for (auto i = 0ull; i < BiasCount; i++)
-				{
-					BiasesPar1[i] = (momentum * BiasesPar1[i]) + (oneMinusMomentum * Square<Float>(BiasesD1[i] * batchRecip));
-					Biases[i] -= lrBias * BiasesD1[i] / std::sqrt(BiasesPar1[i] + eps);
-				}
-			}
+				par1 = (momentum * par1) + (oneMinusMomentum * square(weightD1 * batchRecip));
+				weight -= lr[part] * weightD1 / sqrt(par1 + eps);
+			});
 		}
 
 		inline void SGD(const TrainingRate& rate, WeightsStruct weights)
 		{
-			const auto lr = rate.MaximumRate * WeightsLRM / rate.N;
-			const auto l2Penalty = rate.MaximumRate * WeightsLRM * rate.L2Penalty * WeightsWDM;
-
-			PRAGMA_OMP_SIMD()
-			for (auto i = 0ull; i < WeightCount; i++)
-				(*weights.Weights)[i] -= (lr * (*weights.WeightsD1)[i]) - (l2Penalty * (*weights.Weights)[i]);
+			const auto lr = std::array<Float, 2ull>{ rate.MaximumRate * WeightsLRM / rate.N, rate.MaximumRate * BiasesLRM / rate.N };
+			const auto l2Penalty = std::array<Float, 2ull>{ rate.MaximumRate * WeightsLRM * rate.L2Penalty * WeightsWDM, Float(0) };
 
-			if (HasBias)
+			UpdateParameters(weights, [=](const UInt part, VecFloat& weight, VecFloat& weightD1, VecFloat&, VecFloat&, VecFloat&)
 			{
-				const auto lrBias = rate.MaximumRate * BiasesLRM / rate.N;;
-				PRAGMA_OMP_SIMD()
-				for (auto i = 0ull; i < BiasCount; i++)
-					Biases[i] -= lrBias * BiasesD1[i];
-			}
+				weight -= (lr[part] * weightD1) - (l2Penalty[part] * weight);
+			});
 		}
 
 		inline void SGDMomentum(const TrainingRate& rate, WeightsStruct weights)
 		{
 			const auto momentum = rate.Momentum;
-			const auto lr = rate.MaximumRate * WeightsLRM / rate.N;
-			const auto l2Penalty = rate.MaximumRate * WeightsLRM * rate.L2Penalty * WeightsWDM;
+			const auto lr = std::array<Float, 2ull>{ rate.MaximumRate * WeightsLRM / rate.N, rate.MaximumRate * BiasesLRM / rate.N };
+			const auto l2Penalty = std::array<Float, 2ull>{ rate.MaximumRate * WeightsLRM * rate.L2Penalty * WeightsWDM, Float(0) };
 
-			PRAGMA_OMP_SIMD()
-			for (auto i = 0ull; i < WeightCount; i++)
+			UpdateParameters(weights, [=](const UInt part, VecFloat& weight, VecFloat& weightD1, VecFloat& par1, VecFloat&, VecFloat&)
 			{
-				(*weights.WeightsPar1)[i] = (momentum * (*weights.WeightsPar1)[i]) - (lr * (*weights.WeightsD1)[i]) - (l2Penalty * (*weights.Weights)[i]);
-				(*weights.Weights)[i] += (*weights.WeightsPar1)[i];
-			}
-
-			if (HasBias)
-			{
-				const auto lrBias = rate.MaximumRate * BiasesLRM / rate.N;
-				PRAGMA_OMP_SIMD()
-				for (auto i = 0ull; i < BiasCount; i++)
-				{
-					BiasesPar1[i] = (momentum * BiasesPar1[i]) - (lrBias * BiasesD1[i]);
-					Biases[i] += BiasesPar1[i];
-				}
-			}
+				par1 = (momentum * par1) - (lr[part] * weightD1) - (l2Penalty[part] * weight);
+				weight += par1;
+			});
 		}
 
 		inline void SGDW(const TrainingRate& rate, WeightsStruct weights)
 		{
 			const auto momentum = rate.Momentum;
-			const auto lr = rate.MaximumRate * WeightsLRM / rate.N;
-			const auto l2Penalty = rate.L2Penalty * WeightsWDM;
+			const auto lr = std::array<Float, 2ull>{ rate.MaximumRate * WeightsLRM / rate.N, rate.MaximumRate * BiasesLRM / rate.N };
+			const auto l2Penalty = std::array<Float, 2ull>{ rate.L2Penalty * WeightsWDM, Float(0) };
 
-			PRAGMA_OMP_SIMD()
-			for (auto i = 0ull; i < WeightCount; i++)
+			UpdateParameters(weights, [=](const UInt part, VecFloat& weight, VecFloat& weightD1, VecFloat& par1, VecFloat&, VecFloat&)
 			{
-				(*weights.WeightsPar1)[i] = (momentum * (*weights.WeightsPar1)[i]) - (lr * (*weights.WeightsD1)[i]);
-				(*weights.Weights)[i] += (*weights.WeightsPar1)[i] - (l2Penalty * (*weights.Weights)[i]);
-			}
-
-			if (HasBias)
-			{
-				const auto lrBias = rate.MaximumRate * BiasesLRM / rate.N;
-				PRAGMA_OMP_SIMD()
-				for (auto i = 0ull; i < BiasCount; i++)
-				{
-					BiasesPar1[i] = (momentum * BiasesPar1[i]) - (lrBias * BiasesD1[i]);
-					Biases[i] += BiasesPar1[i];
-				}
-			}
+				par1 = (momentum * par1) - (lr[part] * weightD1);
+				weight += par1 - (l2Penalty[part] * weight);
+			});
 		}
 
 		virtual void LoadNeurons(std::istream& is)
@@ -2905,7 +2686,7 @@ namespace dnn
 		virtual UInt GetNeuronsSize(const UInt batchSize) const
 		{
 #ifndef DNN_LEAN
-			return batchSize * PaddedCDHW() * sizeof(Float) * (InplaceBwd ? 1ull : 2ull);
+			return batchSize * PaddedCDHW() * sizeof(Float) * (InplaceBwd || Inference ? 1ull : 2ull);
 #else
 			return batchSize * PaddedCDHW() * sizeof(Float);
 #endif // DNN_LEAN
@@ -9,9 +9,7 @@ namespace dnn
 		std::vector<Float> scales;
 		std::unordered_map<int, dnnl::memory> fwdArgs;
 		std::unique_ptr<dnnl::binary::primitive_desc> fwdDesc;
-#ifdef DNN_CACHE_PRIMITIVES
 		std::unique_ptr<dnnl::binary> fwd;
-#endif
 
 	public:
 		const Byte first, second;
@@ -86,9 +84,7 @@ namespace dnn
 
 			fwdArgs = std::unordered_map<int, dnnl::memory>{ { DNNL_ARG_SRC_0, dnnl::memory(*Inputs[first]->DstMemDesc, Device.engine, Inputs[first]->Neurons.data()) }, { DNNL_ARG_SRC_1, dnnl::memory(*Inputs[second]->DstMemDesc, Device.engine, Inputs[second]->Neurons.data()) }, { DNNL_ARG_DST, dnnl::memory(*DstMemDesc, Device.engine, Neurons.data()) } };
 
-#ifdef DNN_CACHE_PRIMITIVES
 			fwd = std::make_unique<dnnl::binary>(dnnl::binary(*fwdDesc));
-#endif
 		}
 
 		void ForwardProp(const UInt batchSize, const bool training) final override
@@ -101,11 +97,7 @@ namespace dnn
 			{
 				if (Reference && fullDepth)
 				{
-#ifdef DNN_CACHE_PRIMITIVES
 					fwd->execute(Device.stream, fwdArgs);
-#else
-					dnnl::binary(*fwdDesc).execute(Device.stream, fwdArgs);
-#endif
 					Device.stream.wait();
 #ifndef DNN_LEAN
 					fast_memzero(NeuronsD1.data(), PaddedCDHW() * batchSize * sizeof(Float));
@@ -283,11 +275,7 @@ namespace dnn
 			}
 			else
 			{
-#ifdef DNN_CACHE_PRIMITIVES
 				fwd->execute(Device.stream, fwdArgs);
-#else
-				dnnl::binary(*fwdDesc).execute(Device.stream, fwdArgs);
-#endif
 				Device.stream.wait();
 			}
 		}
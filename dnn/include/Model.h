@@ -457,6 +457,53 @@ namespace dnn
 		}
 	};
 
+	// the place of a layer's weights or biases in the parameter arenas
+	struct ParameterSpan
+	{
+		Layer* Owner;
+		bool Biases;
+		UInt Offset;	// in Floats, the same in every arena
+		UInt Size;
+
+		bool operator==(const ParameterSpan& other) const
+		{
+			return Owner == other.Owner && Biases == other.Biases && Offset == other.Offset && Size == other.Size;
+		}
+	};
+
+	// a run of consecutive layers with Checkpoint=Yes, its activations are recomputed in the backward pass
+	struct CheckpointSegment
+	{
+		UInt First;
+		UInt Last;
+		std::vector<Layer*> Shared;	// only used inside the segment, their activations live in the shared arena
+		std::vector<Layer*> Live;	// gradients already written by later layers when the segment is recomputed
+	};
+
+	// separate counter-based streams per purpose
+	enum class AugmentationOps
+	{
+		Plan = 0,
+		Sample = 1,
+		Flip = 2,
+		Shuffle = 3,
+		Test = 4
+	};
+
+	// Augmentation decisions of one training sample, drawn for the whole batch before it is assembled
+	struct AugmentationPlan
+	{
+		bool Cutout;
+		bool ColorCast;
+		bool AutoAugment;
+		bool Distortion;
+		double Lambda;
+		Float Zoom;
+		Float Angle;
+		UInt CropH;			// top-left corner of the random crop inside the padded image
+		UInt CropW;
+	};
+
 	static bool IsBatchNorm(const LayerTypes& type)
 	{
 		return std::string(magic_enum::enum_name<LayerTypes>(type)).find("BatchNorm", 0) != std::string::npos;
@@ -489,6 +536,7 @@ namespace dnn
 		UInt CurrentCycle;
 		UInt CurrentEpoch;
 		UInt SampleIndex;
+		UInt AugmentationSeed;
 		//UInt LogInterval;
 		UInt GotoEpoch;
 		UInt GotoCycle;
@@ -498,6 +546,8 @@ namespace dnn
 		UInt TestSkipCount;
 		UInt TrainOverflowCount;
 		UInt TestOverflowCount;
+		UInt TestBatchSize;
+		UInt TrainBatchSize;
 		UInt N;
 		UInt C;
 		UInt D;
@@ -547,6 +597,8 @@ namespace dnn
 		bool HasBias;
 		bool PersistOptimizer;
 		bool DisableLocking;
+		bool Inference;
+		bool TrainInference;
 		std::vector<Flip> TrainSamplesFlip;
 		std::vector<Flip> TestSamplesFlip;
 		std::vector<UInt> RandomTrainSamples;
@@ -555,8 +607,43 @@ namespace dnn
 		std::vector<TrainingStrategy> TrainingStrategies;
 		bool UseTrainingStrategy;
 		std::vector<LogRecord> TrainingLog;
+		std::array<std::unique_ptr<ParameterArena>, 5ull> ParameterArenas;	// weights, gradients and the three optimizer states, declared before Layers so they outlive them
+		std::vector<ParameterSpan> ParameterSpans;
+		bool FlatParameters;								// keep the parameters in the arenas and update them in one sweep, see SetFlatParameters
+		Float MaxGradientNorm;								// clip the gradients of the sweep to this global L2 norm, 0 leaves them as they are
+		bool PlanMemory;									// let gradients and activations that are never live at the same time share memory
+		FloatArray GradientArena;
+		std::vector<std::vector<Layer*>> GradientClears;	// per layer, the shared gradients it writes first in the backward pass
+		Float GradientSharing;
+		FloatArray PlanArena;								// intermediate results of the layers' execution plans, see PlanScratch
+		std::vector<CheckpointSegment> Checkpoints;
+		FloatArray ActivationArena;
+		FloatArray GradientBackup;
+		Float ActivationSharing;
+		FloatArray ForwardArena;							// activations only the forward pass reads, see PlanActivations
+		std::vector<Layer*> ForwardShared;
+		Float ForwardSharing;
 		std::vector<std::unique_ptr<Layer>> Layers;
 		std::vector<Cost*> CostLayers;
+		std::vector<std::vector<UInt>> ForwardWaves;
+		std::vector<std::vector<UInt>> BackwardWaves;
+		bool ConcurrentBranches;							// run the independent branches of the graph side by side, see SetConcurrentBranches
+		WorkerPool BranchWorkers;
+		bool OverlapUpdates;								// run the weight updates next to the backward pass of the layers below, see SetOverlapUpdates
+		WorkerPool UpdateWorkers;
+		std::vector<std::future<void>> PendingUpdates;
+		WorkerPool InputProducers;
+		std::vector<FloatArray> InputBuffers;
+		std::vector<std::vector<std::vector<LabelInfo>>> InputLabels;
+		std::vector<std::future<void>> InputReady;
+		std::vector<std::vector<LabelInfo>>(Model::*InputBatch)(const UInt, const UInt, FloatArray&);
+		UInt InputBatchCount;
+		UInt InputBatchIndex;
+		UInt InputSlot;
+		std::mutex TestInputsLock;
+		FloatVector TestInputs;
+		std::vector<Byte> TestInputsCached;
+		std::tuple<Datasets, UInt, UInt, UInt, UInt, UInt, UInt, Interpolations, bool, bool, bool, std::vector<Float>, std::vector<Float>> TestInputsKey;
 		std::chrono::duration<Float> fpropTime;
 		std::chrono::duration<Float> bpropTime;
 		std::chrono::duration<Float> updateTime;
@@ -629,6 +716,7 @@ namespace dnn
 			CurrentEpoch(1),
 			CurrentCycle(1),
 			SampleIndex(0),
+			AugmentationSeed(Seed<UInt>()),
 			//LogInterval(10000),
 			GotoEpoch(1),
 			AdjustedTrainSamplesCount(0),
@@ -637,6 +725,8 @@ namespace dnn
 			TestSkipCount(0),
 			TrainOverflowCount(0),
 			TestOverflowCount(0),
+			TestBatchSize(0),
+			TrainBatchSize(0),
 			N(1),
 			C(3),									// Dim
 			D(1),
@@ -685,13 +775,49 @@ namespace dnn
 			HasBias(true),							// Biases
 			PersistOptimizer(false),
 			DisableLocking(true),
+			Inference(false),
+			TrainInference(false),
 			NewEpoch(nullptr),
 			TrainingRates(std::vector<TrainingRate>()),
 			TrainingStrategies(std::vector<TrainingStrategy>()),
 			UseTrainingStrategy(false),
 			TrainingLog(std::vector<LogRecord>()),
+			ParameterArenas(),
+			ParameterSpans(std::vector<ParameterSpan>()),
+			FlatParameters(false),
+			MaxGradientNorm(Float(0)),
+			PlanMemory(true),
+			GradientArena(),
+			GradientClears(std::vector<std::vector<Layer*>>()),
+			GradientSharing(Float(1)),
+			PlanArena(),
+			Checkpoints(std::vector<CheckpointSegment>()),
+			ActivationArena(),
+			GradientBackup(),
+			ActivationSharing(Float(1)),
+			ForwardArena(),
+			ForwardShared(std::vector<Layer*>()),
+			ForwardSharing(Float(1)),
 			Layers(std::vector<std::unique_ptr<Layer>>()),
 			CostLayers(std::vector<Cost*>()),
+			ForwardWaves(std::vector<std::vector<UInt>>()),
+			BackwardWaves(std::vector<std::vector<UInt>>()),
+			ConcurrentBranches(false),
+			BranchWorkers(),
+			OverlapUpdates(false),
+			UpdateWorkers(),
+			PendingUpdates(std::vector<std::future<void>>()),
+			InputProducers(),
+			InputBuffers(std::vector<FloatArray>()),
+			InputLabels(std::vector<std::vector<std::vector<LabelInfo>>>()),
+			InputReady(std::vector<std::future<void>>()),
+			InputBatch(nullptr),
+			InputBatchCount(0ull),
+			InputBatchIndex(0ull),
+			InputSlot(0ull),
+			TestInputsLock(),
+			TestInputs(FloatVector()),
+			TestInputsCached(std::vector<Byte>()),
 			fpropTime(std::chrono::duration<Float>(Float(0))),
 			bpropTime(std::chrono::duration<Float>(Float(0))),
 			updateTime(std::chrono::duration<Float>(Float(0))),
@@ -742,11 +868,638 @@ namespace dnn
 			auto neuronsSize = UInt(0);
 
 			for (const auto& layer : Layers)
+			{
 				neuronsSize += layer->GetNeuronsSize(batchSize);
+				if (!Inference && HasSharedGradient(*layer))
+					neuronsSize -= UInt((Float(1) - GradientSharing) * Float(batchSize * layer->PaddedCDHW() * sizeof(Float)));
+				if (HasSharedActivation(*layer))
+					neuronsSize -= UInt((Float(1) - ForwardSharing) * Float(batchSize * layer->PaddedCDHW() * sizeof(Float)));
+			}
+
+			for (const auto& segment : Checkpoints)
+				for (const auto layer : segment.Shared)
+					neuronsSize -= UInt((Float(1) - ActivationSharing) * Float(batchSize * layer->PaddedCDHW() * sizeof(Float)));
 
 			return neuronsSize;
 		}
 
+		bool HasSharedGradient(const Layer& layer) const
+		{
+#ifndef DNN_LEAN
+			return PlanMemory && !layer.InplaceBwd && !layer.Checkpoint && layer.LayerType != LayerTypes::Input && layer.LayerType != LayerTypes::Cost;
+#else
+			DNN_UNREF_PAR(layer);
+			return false;
+#endif
+		}
+
+		// An activation can share memory when nothing reads it after the forward pass. Training keeps the ones the backward
+		// pass reads, the outputs of the cost, checkpointed and skippable layers, and the padded channels some layers rely on.
+		bool HasSharedActivation(const Layer& layer) const
+		{
+			if (!PlanMemory || layer.LayerType == LayerTypes::Input || layer.LayerType == LayerTypes::Cost || layer.Checkpoint || layer.Outputs.empty() || layer.C != layer.PaddedC || (!Inference && BwdReadsDst(layer.LayerType)))
+				return false;
+
+			for (const auto output : layer.Outputs)
+				if (output->LayerType == LayerTypes::Cost || output->Checkpoint || IsSkippable(*output) || (!Inference && BwdReadsSrc(output->LayerType)))
+					return false;
+
+			return true;
+		}
+
+		// places the biggest slot first, each at the lowest offset clear of the slots it overlaps with, and returns the arena size
+		template<typename Slot, typename Overlaps>
+		static UInt PlaceSlots(std::vector<Slot>& slots, const Overlaps& overlaps)
+		{
+			auto order = std::vector<UInt>(slots.size());
+			std::iota(order.begin(), order.end(), 0ull);
+			std::stable_sort(order.begin(), order.end(), [&](const UInt a, const UInt b) { return slots[a].Size > slots[b].Size; });
+
+			auto arenaSize = 0ull;
+			auto placed = std::vector<UInt>();
+			for (const auto s : order)
+			{
+				auto conflicts = std::vector<UInt>();
+				for (const auto p : placed)
+					if (overlaps(slots[s], slots[p]))
+						conflicts.push_back(p);
+				std::sort(conflicts.begin(), conflicts.end(), [&](const UInt a, const UInt b) { return slots[a].Offset < slots[b].Offset; });
+
+				auto offset = 0ull;
+				for (const auto c : conflicts)
+				{
+					if (offset + slots[s].Size <= slots[c].Offset)
+						break;
+					offset = std::max(offset, slots[c].Offset + slots[c].Size);
+				}
+
+				slots[s].Offset = offset;
+				arenaSize = std::max(arenaSize, offset + slots[s].Size);
+				placed.push_back(s);
+			}
+
+			return arenaSize;
+		}
+
+		// Lets the gradients of the layers share one arena. A gradient is live from the first layer writing it in the backward
+		// pass until its owner has used it. Gradients that are never live at the same time, neither in the backward waves nor in
+		// plain reverse order, get the same memory, and the first writer clears it as the forward pass zeroes it too early.
+		void PlanGradients(const UInt batchSize)
+		{
+			struct Slot
+			{
+				UInt Owner;
+				UInt FirstWriter;
+				UInt FirstWave;
+				UInt LastWave;
+				UInt Size;
+				UInt Offset;
+			};
+
+			// the gradients of the previous plan get their own memory back in SetBatchSize
+			for (const auto& clears : GradientClears)
+				for (const auto layer : clears)
+					layer->NeuronsD1.release();
+			GradientClears = std::vector<std::vector<Layer*>>(Layers.size());
+			if (Inference)
+			{
+				GradientArena.release();
+				return;
+			}
+
+			auto wave = std::vector<UInt>(Layers.size(), 0ull);
+			for (auto w = 0ull; w < BackwardWaves.size(); w++)
+				for (const auto i : BackwardWaves[w])
+					wave[i] = w;
+
+			auto slots = std::vector<Slot>();
+			auto totalSize = 0ull;
+			for (auto i = 1ull; i < Layers.size(); i++)
+			{
+				if (!HasSharedGradient(*Layers[i]))
+					continue;
+
+				auto slot = Slot{ i, i, wave[i], wave[i], 0ull, 0ull };
+				for (auto j = i + 1; j < Layers.size(); j++)
+					for (const auto input : Layers[j]->InputsBwd)
+						if (input == Layers[i].get())
+						{
+							slot.FirstWriter = j;
+							slot.FirstWave = std::min(slot.FirstWave, wave[j]);
+							slot.LastWave = std::max(slot.LastWave, wave[j]);
+						}
+
+				const auto& layer = Layers[i];
+				const auto size = dnnl::memory::desc(dnnl::memory::dims({ dnnl::memory::dim(batchSize), dnnl::memory::dim(layer->C), dnnl::memory::dim(layer->H), dnnl::memory::dim(layer->W) }), dnnl::memory::data_type::f32, BlockedFmt).get_size() / sizeof(Float);
+				slot.Size = DivUp(size);
+				totalSize += slot.Size;
+				slots.push_back(slot);
+			}
+
+			if (slots.empty())
+			{
+				GradientArena.release();
+				return;
+			}
+
+			const auto overlaps = [](const Slot& a, const Slot& b)
+			{
+				return (a.Owner <= b.FirstWriter && b.Owner <= a.FirstWriter) || (a.FirstWave <= b.LastWave && b.FirstWave <= a.LastWave);
+			};
+
+			const auto arenaSize = PlaceSlots(slots, overlaps);
+
+			for (const auto& slot : slots)
+				Layers[slot.Owner]->NeuronsD1.release();
+			GradientArena.release();
+			GradientArena.resize(1ull, arenaSize, dnnl::memory::data_type::f32, dnnl::memory::format_tag::ab, Device.engine);
+
+			for (const auto& slot : slots)
+			{
+				const auto& layer = Layers[slot.Owner];
+				layer->NeuronsD1.view(GradientArena.data() + slot.Offset, dnnl::memory::desc(dnnl::memory::dims({ dnnl::memory::dim(batchSize), dnnl::memory::dim(layer->C), dnnl::memory::dim(layer->H), dnnl::memory::dim(layer->W) }), dnnl::memory::data_type::f32, BlockedFmt));
+				GradientClears[slot.FirstWriter].push_back(layer.get());
+			}
+
+			GradientSharing = Float(arenaSize) / Float(totalSize);
+		}
+
+		// The reorder buffers of an execution plan are only live while its layer runs that pass, so the plans of all layers
+		// share one arena. Layers that can run at the same time, in one wave with concurrent branches, get disjoint ranges,
+		// and forward ranges never share memory with backward ones as checkpointed segments rerun forward passes.
+		void PlanScratch()
+		{
+			struct Slot
+			{
+				Layer* Owner;
+				bool Backward;
+				UInt Wave;
+				UInt Size;
+				UInt Offset;
+			};
+
+			auto fwdWave = std::vector<UInt>(Layers.size(), 0ull);
+			for (auto w = 0ull; w < ForwardWaves.size(); w++)
+				for (const auto i : ForwardWaves[w])
+					fwdWave[i] = w;
+			auto bwdWave = std::vector<UInt>(Layers.size(), 0ull);
+			for (auto w = 0ull; w < BackwardWaves.size(); w++)
+				for (const auto i : BackwardWaves[w])
+					bwdWave[i] = w;
+
+			auto slots = std::vector<Slot>();
+			for (auto i = 0ull; i < Layers.size(); i++)
+			{
+				Layers[i]->FwdScratch = nullptr;
+				Layers[i]->BwdScratch = nullptr;
+
+				if (const auto size = Layers[i]->PlanScratchSize(false))
+					slots.push_back(Slot{ Layers[i].get(), false, fwdWave[i], size, 0ull });
+				if (const auto size = Layers[i]->PlanScratchSize(true))
+					slots.push_back(Slot{ Layers[i].get(), true, bwdWave[i], size, 0ull });
+			}
+
+			PlanArena.release();
+			if (slots.empty())
+				return;
+
+			const auto overlaps = [this](const Slot& a, const Slot& b)
+			{
+				return a.Backward != b.Backward || (ConcurrentBranches && a.Wave == b.Wave);
+			};
+
+			const auto arenaSize = PlaceSlots(slots, overlaps);
+			PlanArena.resize(1ull, arenaSize, dnnl::memory::data_type::f32, dnnl::memory::format_tag::ab, Device.engine);
+
+			for (const auto& slot : slots)
+				(slot.Backward ? slot.Owner->BwdScratch : slot.Owner->FwdScratch) = PlanArena.data() + slot.Offset;
+		}
+
+		void SetCheckpoints()
+		{
+			Checkpoints.clear();
+
+			auto index = std::unordered_map<const Layer*, UInt>();
+			for (auto i = 0ull; i < Layers.size(); i++)
+				index[Layers[i].get()] = i;
+
+			for (auto first = 1ull; first < Layers.size(); first++)
+			{
+				if (!Layers[first]->Checkpoint)
+					continue;
+
+				auto last = first;
+				while (last + 1 < Layers.size() && Layers[last + 1]->Checkpoint)
+					last++;
+
+				auto segment = CheckpointSegment{ first, last, std::vector<Layer*>(), std::vector<Layer*>() };
+				for (auto i = first; i <= last; i++)
+				{
+					auto inside = !Layers[i]->Outputs.empty();
+					for (const auto output : Layers[i]->Outputs)
+						inside = inside && index[output] <= last;
+					if (inside)
+						segment.Shared.push_back(Layers[i].get());
+				}
+				for (auto j = last + 1; j < Layers.size(); j++)
+					for (const auto input : Layers[j]->InputsBwd)
+						if (index[input] >= first && index[input] <= last && std::find(segment.Live.cbegin(), segment.Live.cend(), input) == segment.Live.cend())
+							segment.Live.push_back(input);
+
+				if (!segment.Shared.empty())
+					Checkpoints.push_back(segment);
+
+				first = last;
+			}
+		}
+
+		// Lets the activations used only inside a checkpointed segment share one arena with the other segments. They are
+		// overwritten by the next segment in the forward pass and recomputed when the backward pass reaches the segment.
+		void PlanCheckpoints(const UInt batchSize)
+		{
+			struct Slot
+			{
+				UInt Segment;
+				UInt FirstFwdWave;
+				UInt LastFwdWave;
+				UInt FirstBwdWave;
+				UInt LastBwdWave;
+				UInt Size;
+				UInt Offset;
+			};
+
+			if (Checkpoints.empty())
+				return;
+
+			auto fwdWave = std::vector<UInt>(Layers.size(), 0ull);
+			for (auto w = 0ull; w < ForwardWaves.size(); w++)
+				for (const auto i : ForwardWaves[w])
+					fwdWave[i] = w;
+			auto bwdWave = std::vector<UInt>(Layers.size(), 0ull);
+			for (auto w = 0ull; w < BackwardWaves.size(); w++)
+				for (const auto i : BackwardWaves[w])
+					bwdWave[i] = w;
+
+			const auto neuronsDesc = [&](const Layer* layer)
+			{
+				return dnnl::memory::desc(dnnl::memory::dims({ dnnl::memory::dim(batchSize), dnnl::memory::dim(layer->C), dnnl::memory::dim(layer->H), dnnl::memory::dim(layer->W) }), dnnl::memory::data_type::f32, BlockedFmt);
+			};
+
+			auto slots = std::vector<Slot>();
+			auto totalSize = 0ull;
+			auto backupSize = 0ull;
+			for (auto s = 0ull; s < Checkpoints.size(); s++)
+			{
+				const auto& segment = Checkpoints[s];
+				auto slot = Slot{ s, fwdWave[segment.First], fwdWave[segment.First], bwdWave[segment.First], bwdWave[segment.First], 0ull, 0ull };
+				for (auto i = segment.First; i <= segment.Last; i++)
+				{
+					slot.FirstFwdWave = std::min(slot.FirstFwdWave, fwdWave[i]);
+					slot.LastFwdWave = std::max(slot.LastFwdWave, fwdWave[i]);
+					slot.FirstBwdWave = std::min(slot.FirstBwdWave, bwdWave[i]);
+					slot.LastBwdWave = std::max(slot.LastBwdWave, bwdWave[i]);
+				}
+				for (const auto layer : segment.Shared)
+					slot.Size += DivUp(neuronsDesc(layer).get_size() / sizeof(Float));
+				totalSize += slot.Size;
+				slots.push_back(slot);
+
+				auto live = 0ull;
+				for (const auto layer : segment.Live)
+					live += neuronsDesc(layer).get_size() / sizeof(Float);
+				backupSize = std::max(backupSize, live);
+			}
+
+			const auto overlaps = [](const Slot& a, const Slot& b)
+			{
+				return (a.FirstFwdWave <= b.LastFwdWave && b.FirstFwdWave <= a.LastFwdWave) || (a.FirstBwdWave <= b.LastBwdWave && b.FirstBwdWave <= a.LastBwdWave);
+			};
+
+			const auto arenaSize = PlaceSlots(slots, overlaps);
+
+			for (const auto& segment : Checkpoints)
+				for (const auto layer : segment.Shared)
+					layer->Neurons.release();
+			ActivationArena.release();
+			ActivationArena.resize(1ull, arenaSize, dnnl::memory::data_type::f32, dnnl::memory::format_tag::ab, Device.engine);
+
+			for (const auto& slot : slots)
+			{
+				auto offset = slot.Offset;
+				for (const auto layer : Checkpoints[slot.Segment].Shared)
+				{
+					const auto desc = neuronsDesc(layer);
+					layer->Neurons.view(ActivationArena.data() + offset, desc);
+					offset += DivUp(desc.get_size() / sizeof(Float));
+				}
+			}
+
+			GradientBackup.release();
+			if (!Inference)
+				GradientBackup.resize(1ull, std::max(backupSize, 1ull), dnnl::memory::data_type::f32, dnnl::memory::format_tag::ab, Device.engine);
+
+			ActivationSharing = Float(arenaSize) / Float(totalSize);
+		}
+
+		// Lets the activations that only the forward pass reads share one arena, see HasSharedActivation. An activation is live
+		// from the wave of its layer to the last wave of the layers reading it, so a layer never writes over its own inputs.
+		void PlanActivations(const UInt batchSize)
+		{
+			struct Slot
+			{
+				UInt Owner;
+				UInt FirstWave;
+				UInt LastWave;
+				UInt Size;
+				UInt Offset;
+			};
+
+			// the activations of the previous plan get their own memory back in SetBatchSize
+			for (const auto layer : ForwardShared)
+				layer->Neurons.release();
+			ForwardShared.clear();
+			ForwardArena.release();
+			ForwardSharing = Float(1);
+
+			auto index = std::unordered_map<const Layer*, UInt>();
+			for (auto i = 0ull; i < Layers.size(); i++)
+				index[Layers[i].get()] = i;
+			auto wave = std::vector<UInt>(Layers.size(), 0ull);
+			for (auto w = 0ull; w < ForwardWaves.size(); w++)
+				for (const auto i : ForwardWaves[w])
+					wave[i] = w;
+
+			const auto neuronsDesc = [&](const Layer* layer)
+			{
+				return dnnl::memory::desc(dnnl::memory::dims({ dnnl::memory::dim(batchSize), dnnl::memory::dim(layer->C), dnnl::memory::dim(layer->H), dnnl::memory::dim(layer->W) }), dnnl::memory::data_type::f32, BlockedFmt);
+			};
+
+			auto slots = std::vector<Slot>();
+			auto totalSize = 0ull;
+			for (auto i = 1ull; i < Layers.size(); i++)
+			{
+				if (!HasSharedActivation(*Layers[i]))
+					continue;
+
+				auto slot = Slot{ i, wave[i], wave[i], 0ull, 0ull };
+				for (const auto output : Layers[i]->Outputs)
+					slot.LastWave = std::max(slot.LastWave, wave[index[output]]);
+				slot.Size = DivUp(neuronsDesc(Layers[i].get()).get_size() / sizeof(Float));
+				totalSize += slot.Size;
+				slots.push_back(slot);
+			}
+
+			if (slots.empty())
+				return;
+
+			const auto overlaps = [](const Slot& a, const Slot& b)
+			{
+				return a.FirstWave <= b.LastWave && b.FirstWave <= a.LastWave;
+			};
+
+			const auto arenaSize = PlaceSlots(slots, overlaps);
+
+			for (const auto& slot : slots)
+				Layers[slot.Owner]->Neurons.release();
+			ForwardArena.resize(1ull, arenaSize, dnnl::memory::data_type::f32, dnnl::memory::format_tag::ab, Device.engine);
+
+			for (const auto& slot : slots)
+			{
+				const auto& layer = Layers[slot.Owner];
+				layer->Neurons.view(ForwardArena.data() + slot.Offset, neuronsDesc(layer.get()));
+				ForwardShared.push_back(layer.get());
+			}
+
+			ForwardSharing = Float(arenaSize) / Float(totalSize);
+		}
+
+		// a recomputed forward pass must leave the running statistics alone
+		template<typename T>
+		static void RecomputeNorm(Layer* layer, const UInt batchSize)
+		{
+			auto norm = dynamic_cast<T*>(layer);
+			if (norm)
+			{
+				const auto runningMean = FloatVector(norm->RunningMean);
+				const auto runningVariance = FloatVector(norm->RunningVariance);
+				norm->ForwardProp(batchSize, true);
+				std::copy(runningMean.cbegin(), runningMean.cend(), norm->RunningMean.begin());
+				std::copy(runningVariance.cbegin(), runningVariance.cend(), norm->RunningVariance.begin());
+			}
+		}
+
+		// Reruns the forward pass of the segment ending at layer i. That zeroes the gradients of its layers again,
+		// so the ones already written by the layers after the segment are kept aside.
+		void Recompute(const UInt i, const UInt batchSize)
+		{
+			for (const auto& segment : Checkpoints)
+			{
+				if (segment.Last != i)
+					continue;
+
+				auto offset = 0ull;
+				for (const auto layer : segment.Live)
+				{
+					std::memcpy(GradientBackup.data() + offset, layer->NeuronsD1.data(), layer->NeuronsD1.size() * sizeof(Float));
+					offset += layer->NeuronsD1.size();
+				}
+
+				for (auto l = segment.First; l <= segment.Last; l++)
+				{
+					if (Layers[l]->Skip)
+						continue;
+
+					switch (Layers[l]->LayerType)
+					{
+					case LayerTypes::BatchNorm:
+						RecomputeNorm<BatchNorm>(Layers[l].get(), batchSize);
+						break;
+					case LayerTypes::BatchNormActivation:
+						RecomputeNorm<BatchNormActivation>(Layers[l].get(), batchSize);
+						break;
+					case LayerTypes::BatchNormRelu:
+						RecomputeNorm<BatchNormRelu>(Layers[l].get(), batchSize);
+						break;
+					default:
+						Layers[l]->ForwardProp(batchSize, true);
+						break;
+					}
+				}
+
+				offset = 0ull;
+				for (const auto layer : segment.Live)
+				{
+					std::memcpy(layer->NeuronsD1.data(), GradientBackup.data() + offset, layer->NeuronsD1.size() * sizeof(Float));
+					offset += layer->NeuronsD1.size();
+				}
+			}
+		}
+
+		inline void ClearGradients(const UInt i)
+		{
+			if (i < GradientClears.size())
+				for (const auto layer : GradientClears[i])
+					fast_memzero(layer->NeuronsD1.data(), layer->NeuronsD1.size() * sizeof(Float));
+		}
+
+		static constexpr auto ParameterAlignment = ParameterArena::BlockAlignment / sizeof(Float);
+
+		static constexpr UInt AlignParameters(const UInt size) noexcept
+		{
+			return ((size + ParameterAlignment - 1ull) / ParameterAlignment) * ParameterAlignment;
+		}
+
+		// the vectors that share a span in the weights, gradients and optimizer arenas, weights first then biases
+		static auto GetParameterVectors(Layer& layer, const bool biases)
+		{
+			return biases ?
+				std::array<FloatVector*, 5ull>{ &layer.Biases, &layer.BiasesD1, &layer.BiasesPar1, &layer.BiasesPar2, &layer.BiasesPar3 } :
+				std::array<FloatVector*, 5ull>{ &layer.Weights, &layer.WeightsD1, &layer.WeightsPar1, &layer.WeightsPar2, &layer.WeightsPar3 };
+		}
+
+		bool ParametersPacked() const
+		{
+			if (!ParameterArenas[0])
+				return false;
+
+			for (const auto& span : ParameterSpans)
+			{
+				const auto vectors = GetParameterVectors(*span.Owner, span.Biases);
+				for (auto a = 0ull; a < vectors.size(); a++)
+					if (!vectors[a]->empty() && (vectors[a]->size() > span.Size || vectors[a]->data() != reinterpret_cast<Float*>(ParameterArenas[a]->data()) + span.Offset))
+						return false;
+			}
+
+			return true;
+		}
+
+		// Moves the weights, biases, gradients and optimizer states of all layers into five contiguous arenas with the same layout,
+		// so element k of every arena belongs to the same parameter. The layers keep their vectors, they're views into the arenas.
+		void PackParameters()
+		{
+			auto spans = std::vector<ParameterSpan>();
+			auto offset = UInt(0);
+
+			for (auto& layer : Layers)
+				if (layer->HasWeights)
+					for (const auto biases : { false, true })
+					{
+						auto size = UInt(0);
+						for (const auto vector : GetParameterVectors(*layer, biases))
+						{
+							size = std::max(size, vector->size());
+
+							// an empty vector may still hold a block in the arena that is about to go
+							if (vector->empty())
+								FloatVector().swap(*vector);
+						}
+
+						if (size > 0ull)
+						{
+							spans.push_back(ParameterSpan{ layer.get(), biases, offset, size });
+							offset += AlignParameters(size);
+						}
+					}
+
+			if (spans == ParameterSpans && ParametersPacked())
+				return;
+
+			auto arenas = std::array<std::unique_ptr<ParameterArena>, 5ull>();
+			for (auto a = 0ull; a < arenas.size(); a++)
+			{
+				arenas[a] = std::make_unique<ParameterArena>();
+				arenas[a]->Reserve(offset * sizeof(Float));
+			}
+
+			for (const auto& span : spans)
+			{
+				const auto vectors = GetParameterVectors(*span.Owner, span.Biases);
+				for (auto a = 0ull; a < vectors.size(); a++)
+					if (!vectors[a]->empty())
+					{
+						arenas[a]->Seek(span.Offset * sizeof(Float));
+
+						const auto scope = ParameterScope(*arenas[a]);
+						auto packed = FloatVector(vectors[a]->cbegin(), vectors[a]->cend());
+						vectors[a]->swap(packed);
+					}
+			}
+
+			// the old arenas go when they're swapped out, every vector has left them by now
+			ParameterArenas.swap(arenas);
+			ParameterSpans = std::move(spans);
+		}
+
+		auto ParametersCount() const
+		{
+			return ParameterSpans.empty() ? UInt(0) : ParameterSpans.back().Offset + AlignParameters(ParameterSpans.back().Size);
+		}
+
+		// the sweep needs all gradients before the first update, overlapped updates start while they're still coming in
+		bool FusedUpdates() const
+		{
+			return FlatParameters && !OverlapUpdates && !PlainOptimizerWeights;
+		}
+
+		// Runs the optimizer steps the layers left in the backward pass as one sweep over the parameter arenas, in arena order.
+		// With MaxGradientNorm set the gradients are scaled first, so the L2 norm of the batch mean gradient of the whole model stays below it.
+		void SweepParameters()
+		{
+			auto blocks = std::vector<std::tuple<Layer*, UInt, UInt>>();
+			auto count = UInt(0);
+			for (auto& layer : Layers)
+				if (layer->Sweep.Step)
+					for (auto part = 0ull; part < 2ull; part++)
+					{
+						for (auto start = 0ull; start < layer->Sweep.Counts[part]; start += Layer::UpdateBlockSize)
+							blocks.emplace_back(layer.get(), part, start);
+						count += layer->Sweep.Counts[part];
+					}
+
+			if (blocks.empty())
+				return;
+
+			const auto threads = GetThreads(count, Float(4));
+			const auto end = [&](const UInt b) { return std::min(std::get<0>(blocks[b])->Sweep.Counts[std::get<1>(blocks[b])], std::get<2>(blocks[b]) + Layer::UpdateBlockSize); };
+
+			auto scale = Float(1);
+			if (MaxGradientNorm > Float(0))
+			{
+				auto sums = std::vector<double>(blocks.size(), 0.0);
+				for_i(blocks.size(), threads, [&](const UInt b)
+				{
+					const auto gradients = std::get<0>(blocks[b])->Sweep.Gradients[std::get<1>(blocks[b])];
+					if (gradients == nullptr)
+						return;
+
+					auto sum = VecFloat(0);
+					auto gradient = VecFloat(0);
+					for (auto i = std::get<2>(blocks[b]); i < end(b); i += VectorSize)
+					{
+						if (end(b) - i >= VectorSize)
+							gradient.load_a(gradients + i);
+						else
+							gradient.load_partial(int(end(b) - i), gradients + i);
+						sum = mul_add(gradient, gradient, sum);
+					}
+					sums[b] = double(horizontal_add(sum));
+				});
+
+				// the gradients are summed over the batch
+				const auto norm = std::sqrt(std::accumulate(sums.cbegin(), sums.cend(), 0.0)) / double(CurrentTrainingRate.N);
+				if (norm > double(MaxGradientNorm))
+					scale = Float(double(MaxGradientNorm) / norm);
+			}
+
+			for_i(blocks.size(), threads, [&](const UInt b)
+			{
+				std::get<0>(blocks[b])->Sweep.Step(std::get<1>(blocks[b]), std::get<2>(blocks[b]), end(b), scale);
+			});
+
+			for (auto& layer : Layers)
+				layer->Sweep = ParameterSweep();
+		}
+
 		bool BatchNormUsed() const
 		{
 			for (const auto& layer : Layers)
@@ -816,8 +1569,13 @@ namespace dnn
 				}
 			}
 
+			PlanGradients(n);
+			PlanCheckpoints(n);
+			PlanActivations(n);
+
 			for (auto& layer : Layers)
 				layer->SetBatchSize(n);
+			PlanScratch();
 			
 
 			N = n;
@@ -893,6 +1651,224 @@ namespace dnn
 			    return false;
 		}
 
+		// The waves decide which gradients and plan buffers may share memory, so both plans are rebuilt for the new waves
+		bool SetConcurrentBranches(const bool concurrent)
+		{
+			if (TaskState.load() == TaskStates::Stopped && !BatchSizeChanging.load() && !ResettingWeights.load())
+			{
+				if (ConcurrentBranches == concurrent)
+					return true;
+
+				ConcurrentBranches = concurrent;
+				SetWaves();
+				StartWorkers();
+
+				PlanGradients(N);
+				PlanCheckpoints(N);
+				PlanActivations(N);
+
+				for (auto& layer : Layers)
+					layer->SetBatchSize(N);
+				PlanScratch();
+
+				return true;
+			}
+			else
+				return false;
+		}
+
+		bool SetOverlapUpdates(const bool overlap)
+		{
+			if (TaskState.load() == TaskStates::Stopped && !BatchSizeChanging.load() && !ResettingWeights.load() && !(overlap && MaxGradientNorm > Float(0)))
+			{
+				if (OverlapUpdates != overlap)
+				{
+					OverlapUpdates = overlap;
+					StartWorkers();
+				}
+
+				return true;
+			}
+			else
+				return false;
+		}
+
+		// The parameters are packed right away and again at the start of every epoch, the optimizer runs over them in one sweep per batch
+		bool SetFlatParameters(const bool flat)
+		{
+			if (TaskState.load() == TaskStates::Stopped && !BatchSizeChanging.load() && !ResettingWeights.load() && !(!flat && MaxGradientNorm > Float(0)))
+			{
+				FlatParameters = flat;
+				if (FlatParameters)
+					PackParameters();
+
+				return true;
+			}
+			else
+				return false;
+		}
+
+		// clipping needs the whole model's gradients at once, so only the sweep over the flat parameters does it
+		bool SetGradientClipping(const Float maxNorm)
+		{
+			if (TaskState.load() == TaskStates::Stopped && !BatchSizeChanging.load() && !ResettingWeights.load() && maxNorm >= Float(0) && (maxNorm == Float(0) || FusedUpdates()))
+			{
+				MaxGradientNorm = maxNorm;
+
+				return true;
+			}
+			else
+				return false;
+		}
+
+		void UpdateInference(const bool inference)
+		{
+			Inference = inference;
+			for (auto& layer : Layers)
+				layer->Inference = inference;
+		}
+
+		// Drops the gradients and backward primitives of all layers, the weights and the optimizer state are kept so training can resume
+		bool SetInference(const bool inference)
+		{
+			if (TaskState.load() == TaskStates::Stopped && !BatchSizeChanging.load() && !ResettingWeights.load())
+			{
+				if (Inference == inference)
+					return true;
+
+				UpdateInference(inference);
+
+				PlanGradients(N);
+				PlanCheckpoints(N);
+				PlanActivations(N);
+
+				for (auto& layer : Layers)
+					layer->SetBatchSize(N);
+				PlanScratch();
+
+				return true;
+			}
+			else
+				return false;
+		}
+
+		// Trains one test batch with and without the memory plan, leaving the weights alone, and tells whether both runs give
+		// the same losses and parameter gradients bit for bit. The running statistics of the norm layers do see the batch twice.
+		bool CheckMemoryPlan(const UInt batchSize)
+		{
+			if (TaskState.load() == TaskStates::Stopped && !BatchSizeChanging.load() && !ResettingWeights.load() && !Inference && DataProv)
+			{
+				if (!ChangeResolution(batchSize, D, H, W, PadD, PadH, PadW))
+					return false;
+
+				const auto planMemory = PlanMemory;
+
+				const auto replan = [&]()
+				{
+					PlanGradients(N);
+					PlanCheckpoints(N);
+					PlanActivations(N);
+
+					for (auto& layer : Layers)
+						layer->SetBatchSize(N);
+					PlanScratch();
+				};
+
+				const auto run = [&](const bool plan)
+				{
+					PlanMemory = plan;
+					replan();
+
+					const auto sampleLabels = TestBatch(0ull, N, Layers[0]->Neurons);
+					for (auto cost : CostLayers)
+						cost->SetSampleLabels(sampleLabels);
+
+					RunWaves(ForwardWaves, [&](const UInt i)
+					{
+						if (!Layers[i]->Skip)
+							Layers[i]->ForwardProp(N, true);
+					});
+
+					RunWaves(BackwardWaves, [&](const UInt i)
+					{
+						Recompute(i, N);
+						ClearGradients(i);
+						if (!Layers[i]->Skip)
+						{
+							if (Layers[i]->HasWeights)
+								Layers[i]->ResetGradients();
+							Layers[i]->BackwardProp(N);
+						}
+					});
+
+					auto result = FloatVector();
+					for (auto cost : CostLayers)
+						result.insert(result.end(), cost->Neurons.data(), cost->Neurons.data() + cost->Neurons.size());
+					for (const auto& layer : Layers)
+						if (layer->HasWeights)
+						{
+							result.insert(result.end(), layer->WeightsD1.cbegin(), layer->WeightsD1.cend());
+							if (layer->HasBias)
+								result.insert(result.end(), layer->BiasesD1.cbegin(), layer->BiasesD1.cend());
+						}
+
+					return result;
+				};
+
+				const auto planned = run(true);
+				const auto unplanned = run(false);
+
+				PlanMemory = planMemory;
+				replan();
+
+				return planned.size() == unplanned.size() && std::memcmp(planned.data(), unplanned.data(), planned.size() * sizeof(Float)) == 0;
+			}
+			else
+				return false;
+		}
+
+		bool SetTestBatchSize(const UInt n)
+		{
+			if (TaskState.load() == TaskStates::Stopped)
+			{
+				TestBatchSize = n;
+
+				return true;
+			}
+			else
+				return false;
+		}
+
+		// A test pass keeps no gradients, so it runs forward-only at TestBatchSize when one is set. The primitive cache spares
+		// recreating the descriptors, but every switch still resizes the buffers of all layers and replans their memory, so
+		// it's only done when the test set is bigger than a training batch.
+		void BeginTestBatchSize()
+		{
+			TrainBatchSize = N;
+			TrainInference = Inference;
+
+			if (TestBatchSize == 0 || TestBatchSize == N || DataProv->TestSamplesCount <= N)
+				return;
+
+			UpdateInference(true);
+			if (!ChangeResolution(TestBatchSize, D, H, W, PadD, PadH, PadW))
+				UpdateInference(TrainInference);
+		}
+
+		// false when the training batch size no longer fits, the model then stays forward-only at the test batch size
+		bool EndTestBatchSize()
+		{
+			if (N == TrainBatchSize)
+				return true;
+
+			UpdateInference(TrainInference);
+			if (ChangeResolution(TrainBatchSize, D, H, W, PadD, PadH, PadW))
+				return true;
+
+			UpdateInference(true);
+			return false;
+		}
+
 		void ResetWeights()
 		{
 			if (!BatchSizeChanging.load() && !ResettingWeights.load())
@@ -1260,6 +2236,7 @@ namespace dnn
 					layer->InitializeDescriptors(N);
 					layer->SetOptimizer(optimizer);
 				}
+				PlanScratch();
 
 				Optimizer = optimizer;
 			}
@@ -1523,42 +2500,204 @@ namespace dnn
 
 				auto outputsCount = layer->Outputs.size();
 
-				if (outputsCount > 0)
+				if (outputsCount > 0)
+				{
+					for (auto& l : Layers)
+					{
+						if (l->Name == layer->Name)
+							continue;
+
+						for (auto input : l->Inputs)
+						{
+							if (input->Name == layer->Name)
+							{
+								if (input->LayerType != LayerTypes::Input)
+									l->SharesInput = !l->InplaceBwd;
+
+								outputsCount--;
+								break;
+							}
+						}
+						
+						if (outputsCount <= 1)
+							break;
+					}
+				}
+				else
+				{
+					if (outputsCount == 0 && layer->LayerType != LayerTypes::Cost)
+						unreferencedLayers.push_back(layer.get());
+				}
+			}
+
+			SetCheckpoints();
+			SetWaves();
+			StartWorkers();
+
+			return unreferencedLayers;
+		}
+
+		// Groups the layers in waves of layers that don't depend on each other, a wave only starts when the previous one is done.
+		// Forward a layer follows its inputs, backward it follows its outputs and every later layer that writes to the same input gradient,
+		// so the copy and the adds into a shared gradient keep their sequential order.
+		void SetWaves()
+		{
+			ForwardWaves.clear();
+			BackwardWaves.clear();
+
+			if (Layers.size() < 2)
+				return;
+
+			if (!ConcurrentBranches)
+			{
+				for (auto i = 1ull; i < Layers.size(); i++)
+					ForwardWaves.push_back(std::vector<UInt>(1, i));
+				for (auto i = Layers.size() - 1; i > 0ull; --i)
+					BackwardWaves.push_back(std::vector<UInt>(1, i));
+
+				return;
+			}
+
+			auto index = std::unordered_map<const Layer*, UInt>();
+			for (auto i = 0ull; i < Layers.size(); i++)
+				index[Layers[i].get()] = i;
+
+			auto wave = std::vector<UInt>(Layers.size(), 0ull);
+			for (auto i = 1ull; i < Layers.size(); i++)
+			{
+				for (auto input : Layers[i]->Inputs)
+					wave[i] = std::max(wave[i], wave[index[input]] + UInt(1));
+
+				if (wave[i] > ForwardWaves.size())
+					ForwardWaves.resize(wave[i]);
+				ForwardWaves[wave[i] - 1ull].push_back(i);
+			}
+
+			std::fill(wave.begin(), wave.end(), 0ull);
+			for (auto i = Layers.size() - 1; i > 0ull; --i)
+			{
+				for (auto output : Layers[i]->Outputs)
+					wave[i] = std::max(wave[i], wave[index[output]] + UInt(1));
+
+				for (auto j = i + 1; j < Layers.size(); j++)
+					for (auto input : Layers[j]->InputsBwd)
+						if (std::find(Layers[i]->InputsBwd.cbegin(), Layers[i]->InputsBwd.cend(), input) != Layers[i]->InputsBwd.cend())
+							wave[i] = std::max(wave[i], wave[j] + UInt(1));
+
+				// the last layer of a checkpointed segment recomputes it, so it goes first and after every layer writing to its gradients
+				for (const auto& segment : Checkpoints)
+				{
+					if (i >= segment.First && i < segment.Last)
+						wave[i] = std::max(wave[i], wave[segment.Last] + UInt(1));
+
+					if (i == segment.Last)
+						for (auto j = i + 1; j < Layers.size(); j++)
+							for (auto input : Layers[j]->InputsBwd)
+								if (index[input] >= segment.First && index[input] <= segment.Last)
+									wave[i] = std::max(wave[i], wave[j] + UInt(1));
+				}
+
+				wave[i] = std::max(wave[i], UInt(1));
+				if (wave[i] > BackwardWaves.size())
+					BackwardWaves.resize(wave[i]);
+				BackwardWaves[wave[i] - 1ull].push_back(i);
+			}
+		}
+
+		// Starts the branch workers when a wave holds more than one layer and the update worker,
+		// layers that can run next to each other get a stream of their own.
+		void StartWorkers()
+		{
+			auto branches = UInt(1);
+			for (const auto& w : ForwardWaves)
+				branches = std::max(branches, UInt(w.size()));
+			for (const auto& w : BackwardWaves)
+				branches = std::max(branches, UInt(w.size()));
+			branches = std::min(branches, UInt(std::max(1u, std::thread::hardware_concurrency())));
+
+			BranchWorkers.Stop();
+			auto concurrent = branches > 1ull && BranchWorkers.Start(branches);
+
+			UpdateWorkers.Stop();
+			PendingUpdates = std::vector<std::future<void>>(Layers.size());
+			if (OverlapUpdates)
+				concurrent = UpdateWorkers.Start(1ull) || concurrent;
+
+			if (concurrent)
+				for (auto& layer : Layers)
+					layer->UseOwnStream();
+		}
+
+		// hands the weight update of a layer to the update worker, the backward pass continues with the layers below
+		void PostUpdate(const UInt i)
+		{
+			if (UpdateWorkers.Threads() == 0ull)
+			{
+				// in a fused sweep the layer only prepares its step, SweepParameters runs it after the backward pass
+				const auto timePoint = std::chrono::high_resolution_clock::now();
+				Layers[i]->DeferUpdate = FusedUpdates();
+				Layers[i]->UpdateWeights(CurrentTrainingRate, Optimizer, DisableLocking);
+				Layers[i]->DeferUpdate = false;
+				Layers[i]->updateTime = std::chrono::high_resolution_clock::now() - timePoint;
+			}
+			else
+			{
+				// Bwd is cleared before the update is done, Updating keeps the statistics refresh off the weights until then
+				Layers[i]->Updating.store(true);
+				// the backward pass keeps the other threads busy, the memory bound update gets a quarter of them
+				const auto threads = std::max(1, omp_get_max_threads() / 4);
+				PendingUpdates[i] = UpdateWorkers.Post([this, i, threads, rate = CurrentTrainingRate, optimizer = Optimizer, disableLocking = DisableLocking]()
 				{
-					for (auto& l : Layers)
-					{
-						if (l->Name == layer->Name)
-							continue;
+#if DNNL_CPU_RUNTIME == DNNL_RUNTIME_OMP
+					omp_set_num_threads(threads);
+#endif
+					while (Layers[i]->RefreshingStats.load()) { std::this_thread::yield(); }
+					const auto timePoint = std::chrono::high_resolution_clock::now();
+					Layers[i]->UpdateWeights(rate, optimizer, disableLocking);
+					Layers[i]->updateTime = std::chrono::high_resolution_clock::now() - timePoint;
+					Layers[i]->Updating.store(false);
+				});
+			}
+		}
 
-						for (auto input : l->Inputs)
-						{
-							if (input->Name == layer->Name)
-							{
-								if (input->LayerType != LayerTypes::Input)
-									l->SharesInput = !l->InplaceBwd;
+		// barrier, every posted weight update is done when it returns
+		void WaitForUpdates()
+		{
+			for (auto& update : PendingUpdates)
+				if (update.valid())
+					update.get();
+		}
 
-								outputsCount--;
-								break;
-							}
-						}
-						
-						if (outputsCount <= 1)
-							break;
-					}
+		// runs func for every layer index, wave after wave, the layers of a wave run concurrently and split the threads between them
+		template <typename Func>
+		void RunWaves(const std::vector<std::vector<UInt>>& waves, const Func& func)
+		{
+			for (const auto& wave : waves)
+			{
+				if (wave.size() == 1ull || BranchWorkers.Threads() == 0ull)
+				{
+					for (auto i : wave)
+						func(i);
 				}
 				else
 				{
-					if (outputsCount == 0 && layer->LayerType != LayerTypes::Cost)
-						unreferencedLayers.push_back(layer.get());
+#if DNNL_CPU_RUNTIME == DNNL_RUNTIME_OMP
+					const auto threads = std::max(1, omp_get_max_threads() / int(wave.size()));
+#endif
+					BranchWorkers.for_i(wave.size(), [&](const size_t b)
+					{
+#if DNNL_CPU_RUNTIME == DNNL_RUNTIME_OMP
+						omp_set_num_threads(threads);
+#endif
+						func(wave[b]);
+					});
 				}
 			}
-
-			return unreferencedLayers;
 		}
 	
 		void Training()
 		{
-			if (TaskState.load() == TaskStates::Stopped && !BatchSizeChanging.load() && !ResettingWeights.load())
+			if (TaskState.load() == TaskStates::Stopped && !BatchSizeChanging.load() && !ResettingWeights.load() && !Inference)
 			{
 				TaskState.store(TaskStates::Running);
 				State.store(States::Idle);
@@ -1601,6 +2740,9 @@ namespace dnn
 					State.store(States::Completed);
 					return;
 				}
+
+				// resize the dataset for the current and the next resolution in the schedule in the background, batches use a copy once it is complete
+				PrepareResolutions(0ull);
 				
 				if (Dropout != CurrentTrainingRate.Dropout)
 					ChangeDropout(CurrentTrainingRate.Dropout, N);
@@ -1614,10 +2756,14 @@ namespace dnn
 
 				TrainSamplesFlip = std::vector<Flip>();
 				TestSamplesFlip = std::vector<Flip>();
-				for (auto index = 0ull; index < DataProv->TrainSamplesCount; index++)
-					TrainSamplesFlip.push_back(Flip{ Bernoulli<bool>(Float(0.5)), Bernoulli<bool>(Float(0.5)) });
-				for (auto index = 0ull; index < DataProv->TestSamplesCount; index++)
-					TestSamplesFlip.push_back(Flip{ Bernoulli<bool>(Float(0.5)), Bernoulli<bool>(Float(0.5)) });
+				{
+					auto stream = Philox(AugmentationSeed, 0ull, 0ull, UInt(AugmentationOps::Flip));
+					const auto scope = AugmentationScope(stream);
+					for (auto index = 0ull; index < DataProv->TrainSamplesCount; index++)
+						TrainSamplesFlip.push_back(Flip{ Bernoulli<bool>(Float(0.5)), Bernoulli<bool>(Float(0.5)) });
+					for (auto index = 0ull; index < DataProv->TestSamplesCount; index++)
+						TestSamplesFlip.push_back(Flip{ Bernoulli<bool>(Float(0.5)), Bernoulli<bool>(Float(0.5)) });
+				}
 				
 				SetOptimizer(CurrentTrainingRate.Optimizer);
 				for (auto& layer : Layers)
@@ -1650,6 +2796,8 @@ namespace dnn
 							State.store(States::Completed);
 							return;
 						}
+
+						PrepareResolutions(learningRateIndex);
 								
 						if (Dropout != CurrentTrainingRate.Dropout)
 							ChangeDropout(CurrentTrainingRate.Dropout, N);
@@ -1664,6 +2812,9 @@ namespace dnn
 						}
 					}
 
+					if (FlatParameters)
+						PackParameters();
+
 					timePointGlobal = timer.now();
 					CurrentEpoch++;
 					CurrentCycle = CurrentTrainingRate.Cycles;
@@ -1680,9 +2831,13 @@ namespace dnn
 					{
 						State.store(States::Training);
 
-						const auto shuffleCount = UniformInt<UInt>(DataProv->ShuffleCount / 2ull, DataProv->ShuffleCount);
-						for (auto shuffle = 0ull; shuffle < shuffleCount; shuffle++)
-							std::shuffle(std::begin(RandomTrainSamples), std::end(RandomTrainSamples), std::mt19937(Seed<unsigned>()));
+						{
+							auto stream = Philox(AugmentationSeed, CurrentEpoch, 0ull, UInt(AugmentationOps::Shuffle));
+							const auto scope = AugmentationScope(stream);
+							const auto shuffleCount = UniformInt<UInt>(DataProv->ShuffleCount / 2ull, DataProv->ShuffleCount);
+							for (auto shuffle = 0ull; shuffle < shuffleCount; shuffle++)
+								std::shuffle(std::begin(RandomTrainSamples), std::end(RandomTrainSamples), stream);
+						}
 
 						for (auto cost : CostLayers)
 							cost->Reset();
@@ -1720,6 +2875,8 @@ namespace dnn
 								updateTimeCount = std::chrono::duration<Float>(Float(0));
 								for (auto i = Layers.size() - 1; i >= FirstUnlockedLayer.load(); --i)
 								{
+									Recompute(i, N);
+									ClearGradients(i);
 									if (Layers[i]->HasWeights && TaskState.load() == TaskStates::Running)
 									{
 										timePoint = timer.now();
@@ -1755,6 +2912,7 @@ namespace dnn
 						{
 #endif
 							auto overflow = false;
+							StartInputQueue(&Model::TrainBatch, AdjustedTrainSamplesCount);
 							for (SampleIndex = 0; SampleIndex < AdjustedTrainSamplesCount; SampleIndex += N)
 							{
 								// Forward
@@ -1764,27 +2922,27 @@ namespace dnn
 								while (Layers[0]->RefreshingStats.load()) {	std::this_thread::yield(); }
 								Layers[0]->Fwd.store(true);
 								const auto timePointLocal = timer.now();
-								auto SampleLabels = TrainBatch(SampleIndex, N);
+								auto SampleLabels = NextInputBatch();
 								Layers[0]->fpropTime = timer.now() - timePointLocal;
 								Layers[0]->Fwd.store(false);
 
 								for (auto cost : CostLayers)
 									cost->SetSampleLabels(SampleLabels);
 
-								for (auto i = 1ull; i < Layers.size(); i++)
+								RunWaves(ForwardWaves, [&](const UInt i)
 								{
 									if (!Layers[i]->Skip && TaskState.load() == TaskStates::Running)
 									{
 										while (Layers[i]->RefreshingStats.load()) { std::this_thread::yield(); }
 										Layers[i]->Fwd.store(true);
-										timePoint = timer.now();
+										const auto timePointLayer = timer.now();
 										Layers[i]->ForwardProp(N, true);
-										Layers[i]->fpropTime = timer.now() - timePoint;
+										Layers[i]->fpropTime = timer.now() - timePointLayer;
 										Layers[i]->Fwd.store(false);
 									}
 									else
 										Layers[i]->fpropTime = std::chrono::duration<Float>(Float(0));
-								}
+								});
 								
 								overflow = SampleIndex >= TrainOverflowCount;
 								CostFunctionBatch(State.load(), N, overflow, TrainSkipCount);
@@ -1794,41 +2952,54 @@ namespace dnn
 								// Backward
 								bpropTimeCount = std::chrono::duration<Float>(Float(0));
 								updateTimeCount = std::chrono::duration<Float>(Float(0));
-								for (auto i = Layers.size() - 1; i >= FirstUnlockedLayer.load(); --i)
+								const auto firstUnlockedLayer = FirstUnlockedLayer.load();
+								RunWaves(BackwardWaves, [&](const UInt i)
 								{
-									if (TaskState.load() == TaskStates::Running)
+									if (i >= firstUnlockedLayer && TaskState.load() == TaskStates::Running)
 									{
 										Layers[i]->bpropTime = std::chrono::duration<Float>(Float(0));
 										Layers[i]->updateTime = std::chrono::duration<Float>(Float(0));
 
+										Recompute(i, N);
+										ClearGradients(i);
 										if (!Layers[i]->Skip)
 										{
 											while (Layers[i]->RefreshingStats.load()) { std::this_thread::yield(); }
 											Layers[i]->Bwd.store(true);
-											timePoint = timer.now();
+											const auto timePointLayer = timer.now();
 
 											if (Layers[i]->HasWeights)
 											{
 												Layers[i]->ResetGradients();
 												Layers[i]->BackwardProp(N);
-												Layers[i]->bpropTime = timer.now() - timePoint;
+												Layers[i]->bpropTime = timer.now() - timePointLayer;
 
-												timePoint = timer.now();
-												Layers[i]->UpdateWeights(CurrentTrainingRate, Optimizer, DisableLocking);
-												Layers[i]->updateTime = timer.now() - timePoint;
-									     
-												updateTimeCount += Layers[i]->updateTime;
+												PostUpdate(i);
 											}
 											else
 											{
 												Layers[i]->BackwardProp(N);
-												Layers[i]->bpropTime = timer.now() - timePoint;
+												Layers[i]->bpropTime = timer.now() - timePointLayer;
 											}
 
-											bpropTimeCount += Layers[i]->bpropTime;
 											Layers[i]->Bwd.store(false);
 										}										
 									}
+								});
+								WaitForUpdates();
+								for (auto i = Layers.size() - 1; i >= firstUnlockedLayer; --i)
+								{
+									if (!Layers[i]->Skip)
+									{
+										bpropTimeCount += Layers[i]->bpropTime;
+										updateTimeCount += Layers[i]->updateTime;
+									}
+								}
+								if (FusedUpdates())
+								{
+									const auto timePointUpdate = timer.now();
+									SweepParameters();
+									updateTimeCount += timer.now() - timePointUpdate;
 								}
 								bpropTime = bpropTimeCount;
 								updateTime = updateTimeCount;
@@ -1839,6 +3010,7 @@ namespace dnn
 								if (TaskState.load() != TaskStates::Running && !CheckTaskState())
 									break;
 							}
+							StopInputQueue();
 #ifdef DNN_STOCHASTIC
 						}
 #endif
@@ -1849,6 +3021,7 @@ namespace dnn
 					if (CheckTaskState())
 					{
 						State.store(States::Testing);
+						BeginTestBatchSize();
 #ifdef DNN_STOCHASTIC	
 						if (N == 1)
 						{
@@ -1873,28 +3046,29 @@ namespace dnn
 						{
 #endif
 							auto overflow = false;
+							StartInputQueue(&Model::TestBatch, AdjustedTestSamplesCount);
 							for (SampleIndex = 0; SampleIndex < AdjustedTestSamplesCount; SampleIndex += N)
 							{
 								const auto timePointLocal = timer.now();
 								while (Layers[0]->RefreshingStats.load()) { std::this_thread::yield(); }
 								Layers[0]->Fwd.store(true);
 								timePoint = timer.now();
-								auto SampleLabels = TestBatch(SampleIndex, N);
+								auto SampleLabels = NextInputBatch();
 								Layers[0]->fpropTime = timer.now() - timePoint;
 								Layers[0]->Fwd.store(false);
 
 								for (auto cost : CostLayers)
 									cost->SetSampleLabels(SampleLabels);
 
-								for (auto i = 1ull; i < Layers.size(); i++)
+								RunWaves(ForwardWaves, [&](const UInt i)
 								{
 									while (Layers[i]->RefreshingStats.load()) { std::this_thread::yield(); }
 									Layers[i]->Fwd.store(true);
-									timePoint = timer.now();
+									const auto timePointLayer = timer.now();
 									Layers[i]->ForwardProp(N, false);
-									Layers[i]->fpropTime = timer.now() - timePoint;
+									Layers[i]->fpropTime = timer.now() - timePointLayer;
 									Layers[i]->Fwd.store(false);
-								}
+								});
 
 								fpropTime = timer.now() - timePointLocal;
 
@@ -1908,9 +3082,16 @@ namespace dnn
 								if (TaskState.load() != TaskStates::Running && !CheckTaskState())
 									break;
 							}
+							StopInputQueue();
 #ifdef DNN_STOCHASTIC
 						}
 #endif
+						if (!EndTestBatchSize())
+						{
+							State.store(States::Completed);
+							return;
+						}
+
 						if (CheckTaskState())
 						{
 							for (auto cost : CostLayers)
@@ -2148,6 +3329,8 @@ namespace dnn
 
 						for (auto i = Layers.size() - 1; i >= FirstUnlockedLayer.load(); --i)
 						{
+							Recompute(i, N);
+							ClearGradients(i);
 							if (Layers[i]->HasWeights)
 							{
 								//Layers[i]->ResetGradients();
@@ -2223,18 +3406,27 @@ namespace dnn
 					return;
 				}
 
+				// testing has no next resolution
+				const auto resolution = std::make_tuple(CurrentTrainingRate.D, CurrentTrainingRate.H, CurrentTrainingRate.W, Interpolations(CurrentTrainingRate.Interpolation));
+				DataProv->PrepareResolutions(resolution, resolution);
+
 				if (Dropout != CurrentTrainingRate.Dropout)
 					ChangeDropout(CurrentTrainingRate.Dropout, N);
 
 
 				TrainSamplesFlip = std::vector<Flip>();
 				TestSamplesFlip = std::vector<Flip>();
-				for (auto index = 0ull; index < DataProv->TrainSamplesCount; index++)
-					TrainSamplesFlip.push_back(Flip{ Bernoulli<bool>(Float(0.5)), Bernoulli<bool>(Float(0.5)) });
-				for (auto index = 0ull; index < DataProv->TestSamplesCount; index++)
-					TestSamplesFlip.push_back(Flip{ Bernoulli<bool>(Float(0.5)), Bernoulli<bool>(Float(0.5)) });
+				{
+					auto stream = Philox(AugmentationSeed, 0ull, 0ull, UInt(AugmentationOps::Flip));
+					const auto scope = AugmentationScope(stream);
+					for (auto index = 0ull; index < DataProv->TrainSamplesCount; index++)
+						TrainSamplesFlip.push_back(Flip{ Bernoulli<bool>(Float(0.5)), Bernoulli<bool>(Float(0.5)) });
+					for (auto index = 0ull; index < DataProv->TestSamplesCount; index++)
+						TestSamplesFlip.push_back(Flip{ Bernoulli<bool>(Float(0.5)), Bernoulli<bool>(Float(0.5)) });
+				}
 
 				State.store(States::Testing);
+				BeginTestBatchSize();
 
 				if (CheckTaskState())
 				{
@@ -2265,28 +3457,29 @@ namespace dnn
 					{
 #endif
 						auto overflow = false;
+						StartInputQueue(&Model::TestAugmentedBatch, AdjustedTestSamplesCount);
 						for (SampleIndex = 0; SampleIndex < AdjustedTestSamplesCount; SampleIndex += N)
 						{
 							timePointGlobal = timer.now();
 
 							while (Layers[0]->RefreshingStats.load()) { std::this_thread::yield(); }
 							Layers[0]->Fwd.store(true);
-							auto SampleLabels = TestAugmentedBatch(SampleIndex, N);
+							auto SampleLabels = NextInputBatch();
 							Layers[0]->fpropTime = timer.now() - timePointGlobal;
 							Layers[0]->Fwd.store(false);
 
 							for (auto cost : CostLayers)
 								cost->SetSampleLabels(SampleLabels);
 
-							for (auto i = 1ull; i < Layers.size(); i++)
+							RunWaves(ForwardWaves, [&](const UInt i)
 							{
 								while (Layers[i]->RefreshingStats.load()) { std::this_thread::yield(); }
 								Layers[i]->Fwd.store(true);
-								timePoint = timer.now();
+								const auto timePointLayer = timer.now();
 								Layers[i]->ForwardProp(N, false);
-								Layers[i]->fpropTime = timer.now() - timePoint;
+								Layers[i]->fpropTime = timer.now() - timePointLayer;
 								Layers[i]->Fwd.store(false);
-							}
+							});
 
 							overflow = SampleIndex >= TestOverflowCount;
 							CostFunctionBatch(State.load(), N, overflow, TestSkipCount);
@@ -2299,6 +3492,7 @@ namespace dnn
 							if (TaskState.load() != TaskStates::Running && !CheckTaskState())
 								break;
 						}
+						StopInputQueue();
 #ifdef DNN_STOCHASTIC
 					}
 #endif
@@ -2308,6 +3502,8 @@ namespace dnn
 						cost->TestErrorPercentage = cost->TestErrors / Float(DataProv->TestSamplesCount / 100);
 					}
 				}
+				if (!EndTestBatchSize())
+					std::cout << std::string("Could not return to the training batch size ") << std::to_string(TrainBatchSize) << std::endl << std::endl;
 			
 				TestLoss = CostLayers[CostIndex]->TestLoss;
 				AvgTestLoss = CostLayers[CostIndex]->AvgTestLoss;
@@ -2395,11 +3591,15 @@ namespace dnn
 #ifdef DNN_STOCHASTIC
 		std::vector<LabelInfo> TrainSample(const UInt index)
 		{
+			auto stream = Philox(AugmentationSeed, CurrentEpoch, index, UInt(AugmentationOps::Sample));
+			const auto scope = AugmentationScope(stream);
+			const auto resized = DataProv->GetResized(D, H, W, Interpolations(CurrentTrainingRate.Interpolation));
+
 			const auto rndIndex = RandomTrainSamples[index];
-			auto imgByte = DataProv->TrainSamples[rndIndex];
+			auto imgByte = resized ? resized->TrainSamples[rndIndex] : DataProv->TrainSample(rndIndex, H, W);
 
 			const auto rndIndexMix = (index + 1 >= DataProv->TrainSamplesCount) ? RandomTrainSamples[1] : RandomTrainSamples[index + 1];
-			auto imgByteMix = Image<Byte>(DataProv->TrainSamples[rndIndexMix]);
+			auto imgByteMix = resized ? resized->TrainSamples[rndIndexMix] : DataProv->TrainSample(rndIndexMix, H, W);
 
 			auto label = DataProv->TrainLabels[rndIndex];
 			auto labelMix = DataProv->TrainLabels[rndIndexMix];
@@ -2472,7 +3672,8 @@ namespace dnn
 			auto label = DataProv->TestLabels[index];
 			auto SampleLabel = GetLabelInfo(label);
 
-			auto imgByte = DataProv->TestSamples[index];
+			const auto resized = DataProv->GetResized(D, H, W, Interpolations(CurrentTrainingRate.Interpolation));
+			auto imgByte = resized ? resized->TestSamples[index] : DataProv->TestSample(index, H, W);
 
 			if (imgByte.D() != D || imgByte.H() != H || imgByte.W() != W)
 				imgByte = Image<Byte>::Resize(imgByte, D, H, W, Interpolations(CurrentTrainingRate.Interpolation));
@@ -2498,10 +3699,13 @@ namespace dnn
 
 		std::vector<LabelInfo> TestAugmentedSample(const UInt index)
 		{
+			auto stream = Philox(AugmentationSeed, CurrentEpoch, index, UInt(AugmentationOps::Test));
+			const auto scope = AugmentationScope(stream);
 			auto label = DataProv->TestLabels[index];
 			auto SampleLabel = GetLabelInfo(label);
 
-			auto imgByte = DataProv->TestSamples[index];
+			const auto resized = DataProv->GetResized(D, H, W, Interpolations(CurrentTrainingRate.Interpolation));
+			auto imgByte = resized ? resized->TestSamples[index] : DataProv->TestSample(index, H, W);
 
 			if (DataProv->C == 3 && Bernoulli<bool>(CurrentTrainingRate.ColorCast))
 				imgByte = Image<Byte>::ColorCast(imgByte, CurrentTrainingRate.ColorAngle);
@@ -2563,7 +3767,7 @@ namespace dnn
 				auto labels = std::vector<UInt>(DataProv->TrainLabels[sampleIndex]);
 				SampleLabels[batchIndex] = GetLabelInfo(labels);
 
-				auto imgByte = Image<Byte>(DataProv->TrainSamples[sampleIndex]);
+				auto imgByte = DataProv->TrainSample(sampleIndex, H, W);
 				if (resize)
 					imgByte = Image<Byte>::Resize(imgByte, D, H, W, Interpolations(CurrentTrainingRate.Interpolation));
 
@@ -2586,32 +3790,152 @@ namespace dnn
 			return SampleLabels;
 		}
 
-		std::vector<std::vector<LabelInfo>> TrainBatch(const UInt index, const UInt batchSize)
+		// the input queue is stopped between epochs, so the copies of the resolutions left behind can go
+		void PrepareResolutions(const UInt index)
+		{
+			const auto& current = TrainingRates[index];
+			const auto& next = TrainingRates[std::min<UInt>(index + 1ull, TrainingRates.size() - 1ull)];
+
+			DataProv->PrepareResolutions(std::make_tuple(current.D, current.H, current.W, Interpolations(current.Interpolation)), std::make_tuple(next.D, next.H, next.W, Interpolations(next.Interpolation)));
+		}
+
+		// InputQueueDepth producers assemble batches concurrently into a ring of as many input buffers, batch k lands in slot k modulo the depth
+		void StartInputQueue(std::vector<std::vector<LabelInfo>>(Model::*batch)(const UInt, const UInt, FloatArray&), const UInt count)
+		{
+			StopInputQueue();
+
+			const auto depth = std::max<UInt>(1ull, DataProv->InputQueueDepth);
+			if (InputProducers.Threads() != depth)
+				InputProducers.Start(depth);
+
+			InputBuffers.resize(depth);
+			for (auto& buffer : InputBuffers)
+				buffer.resizeMem(Layers[0]->Neurons.desc(), Device.engine);
+			InputLabels = std::vector<std::vector<std::vector<LabelInfo>>>(depth);
+			InputReady = std::vector<std::future<void>>(depth);
+
+			InputBatch = batch;
+			InputBatchCount = count;
+			InputBatchIndex = 0ull;
+			InputSlot = 0ull;
+
+			for (auto slot = 0ull; slot < depth && InputBatchIndex < InputBatchCount; slot++)
+				EnqueueInputBatch(slot);
+		}
+
+		void EnqueueInputBatch(const UInt slot)
+		{
+			const auto index = InputBatchIndex;
+			const auto batchSize = N;
+			const auto batch = InputBatch;
+			InputBatchIndex += N;
+
+			InputReady[slot] = InputProducers.Post([=]() { InputLabels[slot] = (this->*batch)(index, batchSize, InputBuffers[slot]); });
+		}
+
+		// swaps the oldest assembled batch into the input layer and queues the next one in the slot it frees
+		std::vector<std::vector<LabelInfo>> NextInputBatch()
+		{
+			const auto slot = InputSlot;
+			InputSlot = (InputSlot + 1ull) % InputBuffers.size();
+
+			InputReady[slot].get();
+			auto sampleLabels = std::move(InputLabels[slot]);
+			Layers[0]->Neurons.swap(InputBuffers[slot]);
+
+			if (InputBatchIndex < InputBatchCount)
+				EnqueueInputBatch(slot);
+
+			return sampleLabels;
+		}
+
+		void StopInputQueue()
+		{
+			for (auto& ready : InputReady)
+				if (ready.valid())
+					ready.wait();
+
+			InputReady.clear();
+		}
+
+		// one pass over the batch, keyed by epoch and position in the epoch so the result does not depend on the threads assembling it
+		std::vector<AugmentationPlan> GetAugmentationPlans(const UInt index, const UInt batchSize) const
+		{
+			auto plans = std::vector<AugmentationPlan>(batchSize);
+
+			for (auto batchIndex = 0ull; batchIndex < batchSize; batchIndex++)
+			{
+				auto stream = Philox(AugmentationSeed, CurrentEpoch, index + batchIndex, UInt(AugmentationOps::Plan));
+				auto& plan = plans[batchIndex];
+
+				plan.Cutout = stream.Uniform() < CurrentTrainingRate.Cutout;
+				plan.ColorCast = stream.Uniform() < CurrentTrainingRate.ColorCast;
+				plan.AutoAugment = stream.Uniform() < CurrentTrainingRate.AutoAugment;
+				plan.Distortion = stream.Uniform() < CurrentTrainingRate.Distortion;
+				plan.Lambda = double(stream.Uniform());		// Beta(1, 1)
+				plan.Zoom = CurrentTrainingRate.Scaling / Float(100) * (Float(2) * stream.Uniform() - Float(1));
+				plan.Angle = CurrentTrainingRate.Rotation * (Float(2) * stream.Uniform() - Float(1));
+
+				const auto scope = AugmentationScope(stream);
+				plan.CropH = UniformInt<UInt>(0ull, 2ull * PadH);
+				plan.CropW = UniformInt<UInt>(0ull, 2ull * PadW);
+			}
+
+			return plans;
+		}
+
+		std::vector<std::vector<LabelInfo>> TrainBatch(const UInt index, const UInt batchSize, FloatArray& input)
 		{
 			const auto hierarchies = DataProv->Hierarchies;
 			auto SampleLabels = std::vector<std::vector<LabelInfo>>(batchSize, std::vector<LabelInfo>(hierarchies));
-			const auto resize = DataProv->D != D || DataProv->H != H || DataProv->W != W;
+			const auto resized = DataProv->GetResized(D, H, W, Interpolations(CurrentTrainingRate.Interpolation));
+			const auto resize = !resized && (DataProv->D != D || DataProv->H != H || DataProv->W != W);
+			const auto warp = DataProv->D == D && PadD == 0ull;
+
+			const auto plans = GetAugmentationPlans(index, batchSize);
 
 			const auto elements = batchSize * C * D * H * W;
 			const auto threads = batchSize == 1 ? 1ull : GetThreads(elements, Float(10));
 			
-            for_i_dynamic(batchSize, threads, [=, &SampleLabels](const UInt batchIndex)
+            DataProv->ForEachSample(batchSize, threads, [=, &SampleLabels, &plans](const UInt batchIndex)
 			{
+				// the random draws inside the image operations come from a stream of this sample only
+				const auto& plan = plans[batchIndex];
+				auto stream = Philox(AugmentationSeed, CurrentEpoch, index + batchIndex, UInt(AugmentationOps::Sample));
+				const auto scope = AugmentationScope(stream);
+				const auto scratch = ScratchScope();
+
 				const auto randomIndex = (index + batchIndex >= DataProv->TrainSamplesCount) ? RandomTrainSamples[batchIndex] : RandomTrainSamples[index + batchIndex];
-				auto imgByte = Image<Byte>(DataProv->TrainSamples[randomIndex]);
+				const auto horizontalFlip = CurrentTrainingRate.HorizontalFlip && TrainSamplesFlip[randomIndex].Horizontal;
+				const auto verticalFlip = CurrentTrainingRate.VerticalFlip && TrainSamplesFlip[randomIndex].Vertical;
+
+				// a crop without zoom or rotation reads only part of the canvas, a folder dataset then decodes just that part
+				auto roi = std::array<UInt, 4>({ 0ull, 0ull, 0ull, 0ull });
+				if (warp && RandomCrop && !resized && !plan.AutoAugment && !plan.Distortion)
+				{
+					auto window = Geometry(H, W, H, W);
+					window.PadH = PadH;
+					window.PadW = PadW;
+					window.HorizontalFlip = horizontalFlip;
+					window.VerticalFlip = verticalFlip;
+					window.Crop(plan.CropH, plan.CropW);
+					window.CanvasWindow(roi[0], roi[1], roi[2], roi[3]);
+				}
+
+				auto imgByte = resized ? resized->TrainSamples[randomIndex] : DataProv->TrainSample(randomIndex, H, W, roi[0], roi[1], roi[2], roi[3]);
 
 				const auto randomIndexMix = (index + batchSize - (batchIndex + 1) >= DataProv->TrainSamplesCount) ? RandomTrainSamples[batchSize - (batchIndex + 1)] : RandomTrainSamples[index + batchSize - (batchIndex + 1)];
-				auto imgByteMix = Image<Byte>(DataProv->TrainSamples[randomIndexMix]);
+				auto imgByteMix = resized ? resized->TrainSamples[randomIndexMix] : DataProv->TrainSample(randomIndexMix, H, W);
 
 				auto labels = std::vector<UInt>(DataProv->TrainLabels[randomIndex]);
 				auto mixLabels = std::vector<UInt>(DataProv->TrainLabels[randomIndexMix]);
 
 				auto cutout = false;
-				if (Bernoulli<bool>(CurrentTrainingRate.Cutout))
+				if (plan.Cutout)
 				{
 					if (CurrentTrainingRate.CutMix)
 					{
-						double lambda = dnn::BetaDistribution<double>(1, 1);
+						auto lambda = plan.Lambda;
 						imgByte = Image<Byte>::RandomCutMix(imgByte, imgByteMix, &lambda);
 						SampleLabels[batchIndex] = GetCutMixLabelInfo(labels, mixLabels, lambda);
 					}
@@ -2624,66 +3948,134 @@ namespace dnn
 				else
 					SampleLabels[batchIndex] = GetLabelInfo(labels);
 
-				if (CurrentTrainingRate.HorizontalFlip && TrainSamplesFlip[randomIndex].Horizontal)
-					imgByte = Image<Byte>::HorizontalMirror(imgByte);
+				if (DataProv->C == 3 && plan.ColorCast)
+					imgByte = Image<Byte>::ColorCast(imgByte, CurrentTrainingRate.ColorAngle);
 
-				if (CurrentTrainingRate.VerticalFlip && TrainSamplesFlip[randomIndex].Vertical)
-					imgByte = Image<Byte>::VerticalMirror(imgByte);
+				if (warp)
+				{
+					auto geometry = Geometry(H, W, H, W);
+					geometry.HorizontalFlip = horizontalFlip;
+					geometry.VerticalFlip = verticalFlip;
 
-				if (DataProv->C == 3 && Bernoulli<bool>(CurrentTrainingRate.ColorCast))
-					imgByte = Image<Byte>::ColorCast(imgByte, CurrentTrainingRate.ColorAngle);
+					if (DataProv->C == 3 && plan.AutoAugment)
+					{
+						// AutoAugment works on the resized image, only flip and resize can be fused ahead of it
+						if (resize || horizontalFlip || verticalFlip)
+							imgByte = Image<Byte>::Warp(imgByte, geometry, Interpolations(CurrentTrainingRate.Interpolation), DataProv->Mean);
+						
+						imgByte = Image<Byte>::AutoAugment(imgByte, PadD, PadH, PadW, DataProv->Mean, MirrorPad);
+						geometry = Geometry(RandomCrop ? H : imgByte.H(), RandomCrop ? W : imgByte.W(), imgByte.H(), imgByte.W());
+					}
+					else
+					{
+						geometry.PadH = PadH;
+						geometry.PadW = PadW;
+						geometry.Height = RandomCrop ? H : geometry.PaddedHeight();
+						geometry.Width = RandomCrop ? W : geometry.PaddedWidth();
+					}
 
-				if (resize)
-					imgByte = Image<Byte>::Resize(imgByte, D, H, W, Interpolations(CurrentTrainingRate.Interpolation));
+					if (plan.Distortion)
+					{
+						geometry.Zoom = plan.Zoom;
+						geometry.Angle = plan.Angle;
+					}
 
-				if (DataProv->C == 3 && Bernoulli<bool>(CurrentTrainingRate.AutoAugment))
-					imgByte = Image<Byte>::AutoAugment(imgByte, PadD, PadH, PadW, DataProv->Mean, MirrorPad);
+					if (cutout)
+						geometry.RandomCutout();
+
+					if (RandomCrop)
+						geometry.Crop(plan.CropH, plan.CropW);
+
+					imgByte = Image<Byte>::Warp(imgByte, geometry, Interpolations(CurrentTrainingRate.Interpolation), DataProv->Mean, MirrorPad);
+				}
 				else
-					imgByte = Image<Byte>::Padding(imgByte, PadD, PadH, PadW, DataProv->Mean, MirrorPad);
+				{
+					if (horizontalFlip)
+						imgByte = Image<Byte>::HorizontalMirror(imgByte);
 
-				if (Bernoulli<bool>(CurrentTrainingRate.Distortion))
-					imgByte = Image<Byte>::Distorted(imgByte, CurrentTrainingRate.Scaling, CurrentTrainingRate.Rotation, Interpolations(CurrentTrainingRate.Interpolation), DataProv->Mean);
+					if (verticalFlip)
+						imgByte = Image<Byte>::VerticalMirror(imgByte);
 
-				if (cutout)
-					imgByte = Image<Byte>::RandomCutout(imgByte, DataProv->Mean);
+					if (resize)
+						imgByte = Image<Byte>::Resize(imgByte, D, H, W, Interpolations(CurrentTrainingRate.Interpolation));
 
-				if (RandomCrop)
-					imgByte = Image<Byte>::RandomCrop(imgByte, D, H, W, DataProv->Mean);
+					if (DataProv->C == 3 && plan.AutoAugment)
+						imgByte = Image<Byte>::AutoAugment(imgByte, PadD, PadH, PadW, DataProv->Mean, MirrorPad);
+					else
+						imgByte = Image<Byte>::Padding(imgByte, PadD, PadH, PadW, DataProv->Mean, MirrorPad);
 
-				if (CurrentTrainingRate.InputDropout > Float(0))
-					imgByte = Image<Byte>::Dropout(imgByte, CurrentTrainingRate.InputDropout, DataProv->Mean);
+					if (plan.Distortion)
+						imgByte = Image<Byte>::Distorted(imgByte, CurrentTrainingRate.Scaling, CurrentTrainingRate.Rotation, Interpolations(CurrentTrainingRate.Interpolation), DataProv->Mean);
 
-				for (auto c = 0u; c < imgByte.C(); c++)
-				{
-					const auto mean = MeanStdNormalization ? DataProv->Mean[c] : Image<Byte>::GetChannelMean(imgByte, c);
-					const auto stddev = MeanStdNormalization ? DataProv->StdDev[c] : Image<Byte>::GetChannelStdDev(imgByte, c);
+					if (cutout)
+						imgByte = Image<Byte>::RandomCutout(imgByte, DataProv->Mean);
 
-					for (auto d = 0u; d < imgByte.D(); d++)
-						for (auto h = 0u; h < imgByte.H(); h++)
-							for (auto w = 0u; w < imgByte.W(); w++)
-								Layers[0]->Neurons[batchIndex * imgByte.Size() + (c * imgByte.ChannelSize()) + (d * imgByte.Area()) + (h * imgByte.W()) + w] = (imgByte(c, d, h, w) - mean) / stddev;
+					if (RandomCrop)
+						imgByte = Image<Byte>::RandomCrop(imgByte, D, H, W, DataProv->Mean);
 				}
+
+				if (CurrentTrainingRate.InputDropout > Float(0))
+					imgByte = Image<Byte>::Dropout(imgByte, CurrentTrainingRate.InputDropout, DataProv->Mean);
+
+				Image<Byte>::Normalize(imgByte, &input[batchIndex * imgByte.Size()], DataProv->Mean, DataProv->StdDev, !MeanStdNormalization);
 			});
 
 			return SampleLabels;
 		}
 
-		std::vector<std::vector<LabelInfo>> TestBatch(const UInt index, const UInt batchSize)
+		// TestBatch is deterministic, its inputs stay valid as long as everything they depend on is unchanged
+		bool PrepareTestInputs(const bool resized)
+		{
+			if constexpr (!CacheTestInputs)
+				return false;
+
+			// the input producers call this concurrently
+			std::lock_guard<std::mutex> lock(TestInputsLock);
+			const auto key = std::make_tuple(DataProv->Dataset, D, H, W, PadD, PadH, PadW, CurrentTrainingRate.Interpolation, MirrorPad, MeanStdNormalization, resized, DataProv->Mean, DataProv->StdDev);
+			const auto size = DataProv->TestSamplesCount * C * D * H * W;
+
+			if (key != TestInputsKey)
+			{
+				TestInputsKey = key;
+				TestInputs = FloatVector();
+				TestInputsCached = std::vector<Byte>();
+
+				if (size * sizeof(Float) > GetTotalFreeMemory() / 2ull)
+					return false;
+
+				TestInputs = FloatVector(size);
+				TestInputsCached = std::vector<Byte>(DataProv->TestSamplesCount, 0);
+			}
+
+			return !TestInputs.empty();
+		}
+
+		std::vector<std::vector<LabelInfo>> TestBatch(const UInt index, const UInt batchSize, FloatArray& input)
 		{
 			auto SampleLabels = std::vector<std::vector<LabelInfo>>(batchSize, std::vector<LabelInfo>(DataProv->Hierarchies));
-			const auto resize = DataProv->D != D || DataProv->H != H || DataProv->W != W;
+			const auto resized = DataProv->GetResized(D, H, W, Interpolations(CurrentTrainingRate.Interpolation));
+			const auto resize = !resized && (DataProv->D != D || DataProv->H != H || DataProv->W != W);
+			const auto cache = PrepareTestInputs(resized != nullptr);
+			const auto size = C * D * H * W;
 
 			const auto elements = batchSize * C * D * H * W;
 			const auto threads = batchSize == 1 ? 1ull : GetThreads(elements, Float(10));
 
-			for_i(batchSize, threads, [=, &SampleLabels](const UInt batchIndex)
+			DataProv->ForEachSample(batchSize, threads, [=, &SampleLabels](const UInt batchIndex)
 			{
+				const auto scratch = ScratchScope();
 				const auto sampleIndex = ((index + batchIndex) >= DataProv->TestSamplesCount) ? batchIndex : index + batchIndex;
 
 				auto labels = std::vector<UInt>(DataProv->TestLabels[sampleIndex]);
 				SampleLabels[batchIndex] = GetLabelInfo(labels);
 
-				auto imgByte = Image<Byte>(DataProv->TestSamples[sampleIndex]);
+				if (cache && TestInputsCached[sampleIndex])
+				{
+					std::memcpy(&input[batchIndex * size], &TestInputs[sampleIndex * size], size * sizeof(Float));
+					return;
+				}
+
+				auto imgByte = resized ? resized->TestSamples[sampleIndex] : DataProv->TestSample(sampleIndex, H, W);
 				
 				if (resize)
 					imgByte = Image<Byte>::Resize(imgByte, D, H, W, Interpolations(CurrentTrainingRate.Interpolation));
@@ -2692,37 +4084,40 @@ namespace dnn
 
 				imgByte = Image<Byte>::Crop(imgByte, Positions::Center, D, H, W, DataProv->Mean);
 
-				for (auto c = 0u; c < imgByte.C(); c++)
-				{
-					const auto mean = MeanStdNormalization ? DataProv->Mean[c] : Image<Byte>::GetChannelMean(imgByte, c);
-					const auto stddev = MeanStdNormalization ? DataProv->StdDev[c] : Image<Byte>::GetChannelStdDev(imgByte, c);
+				Image<Byte>::Normalize(imgByte, &input[batchIndex * imgByte.Size()], DataProv->Mean, DataProv->StdDev, !MeanStdNormalization);
 
-					for (auto d = 0u; d < imgByte.D(); d++)
-						for (auto h = 0u; h < imgByte.H(); h++)
-							for (auto w = 0u; w < imgByte.W(); w++)
-								Layers[0]->Neurons[batchIndex * imgByte.Size() + (c * imgByte.ChannelSize()) + (d * imgByte.Area()) + (h * imgByte.W()) + w] = (imgByte(c, d, h, w) - mean) / stddev;
+				if (cache)
+				{
+					std::memcpy(&TestInputs[sampleIndex * size], &input[batchIndex * size], size * sizeof(Float));
+					TestInputsCached[sampleIndex] = 1;
 				}
-			});
+			}, false);
 
 			return SampleLabels;
 		}
 
-		std::vector<std::vector<LabelInfo>> TestAugmentedBatch(const UInt index, const UInt batchSize)
+		std::vector<std::vector<LabelInfo>> TestAugmentedBatch(const UInt index, const UInt batchSize, FloatArray& input)
 		{
 			auto SampleLabels = std::vector<std::vector<LabelInfo>>(batchSize, std::vector<LabelInfo>(DataProv->Hierarchies));
-			const auto resize = DataProv->D != D || DataProv->H != H || DataProv->W != W;
+			const auto resized = DataProv->GetResized(D, H, W, Interpolations(CurrentTrainingRate.Interpolation));
+			const auto resize = !resized && (DataProv->D != D || DataProv->H != H || DataProv->W != W);
 
 			const auto elements = batchSize * C * D * H * W;
 			const auto threads = batchSize == 1 ? 1ull : GetThreads(elements, Float(10));
 
-			for_i_dynamic(batchSize, threads, [=, &SampleLabels](const UInt batchIndex)
+			DataProv->ForEachSample(batchSize, threads, [=, &SampleLabels](const UInt batchIndex)
 			{
+				const auto scratch = ScratchScope();
 				const auto sampleIndex = ((index + batchIndex) >= DataProv->TestSamplesCount) ? batchIndex : index + batchIndex;
 
+				// the augmentations of a test sample come from a stream of its own, whatever thread assembles it
+				auto stream = Philox(AugmentationSeed, CurrentEpoch, sampleIndex, UInt(AugmentationOps::Test));
+				const auto scope = AugmentationScope(stream);
+
 				auto labels = std::vector<UInt>(DataProv->TestLabels[sampleIndex]);
 				SampleLabels[batchIndex] = GetLabelInfo(labels);
 
-				auto imgByte = Image<Byte>(DataProv->TestSamples[sampleIndex]);
+				auto imgByte = resized ? resized->TestSamples[sampleIndex] : DataProv->TestSample(sampleIndex, H, W);
 
 				if (DataProv->C == 3 && Bernoulli<bool>(CurrentTrainingRate.ColorCast))
 					imgByte = Image<Byte>::ColorCast(imgByte, CurrentTrainingRate.ColorAngle);
@@ -2753,16 +4148,7 @@ namespace dnn
 				if (CurrentTrainingRate.InputDropout > Float(0))
 					imgByte = Image<Byte>::Dropout(imgByte, CurrentTrainingRate.InputDropout, DataProv->Mean);
 
-				for (auto c = 0u; c < imgByte.C(); c++)
-				{
-					const auto mean = MeanStdNormalization ? DataProv->Mean[c] : Image<Byte>::GetChannelMean(imgByte, c);
-					const auto stddev = MeanStdNormalization ? DataProv->StdDev[c] : Image<Byte>::GetChannelStdDev(imgByte, c);
-
-					for (auto d = 0u; d < imgByte.D(); d++)
-						for (auto h = 0u; h < imgByte.H(); h++)
-							for (auto w = 0u; w < imgByte.W(); w++)
-								Layers[0]->Neurons[batchIndex * imgByte.Size() + (c * imgByte.ChannelSize()) + (d * imgByte.Area()) + (h * imgByte.W()) + w] = (imgByte(c, d, h, w) - mean) / stddev;
-				}
+				Image<Byte>::Normalize(imgByte, &input[batchIndex * imgByte.Size()], DataProv->Mean, DataProv->StdDev, !MeanStdNormalization);
 			});
 
 			return SampleLabels;
@@ -2770,14 +4156,18 @@ namespace dnn
 			
 		void ForwardProp(const UInt batchSize)
 		{
-			for (auto &layer : Layers)
-				layer->ForwardProp(batchSize, State.load() == States::Training);
+			const auto training = State.load() == States::Training;
+
+			Layers[0]->ForwardProp(batchSize, training);
+			RunWaves(ForwardWaves, [&](const UInt i) { Layers[i]->ForwardProp(batchSize, training); });
 		}
 
 		void BackwardProp(const UInt batchSize)
 		{
-			for (auto i = Layers.size() - 1; i > 0ull; --i)
+			RunWaves(BackwardWaves, [&](const UInt i)
 			{
+				Recompute(i, batchSize);
+				ClearGradients(i);
 				if (Layers[i]->HasWeights && TaskState.load() == TaskStates::Running)
 				{
 					Layers[i]->ResetGradients();
@@ -2787,7 +4177,7 @@ namespace dnn
 				}
 				else
 					Layers[i]->BackwardProp(batchSize);
-			}
+			});
 		}
 		
 		bool SaveModel(const std::string& fileName) const
@@ -3184,6 +4574,120 @@ namespace dnn
 			return -1;
 		}
 
+		// The BatchNorm, BatchNormActivation and BatchNormRelu layers fed only by a Convolution, DepthwiseConvolution or Dense layer
+		// that has no other outputs, as pairs of layer indices. In inference they scale and shift each channel of that layer.
+		std::vector<std::pair<UInt, UInt>> GetFoldableNorms() const
+		{
+			auto folds = std::vector<std::pair<UInt, UInt>>();
+
+			for (auto i = 1ull; i < Layers.size(); i++)
+			{
+				const auto& norm = Layers[i];
+				if ((norm->LayerType != LayerTypes::BatchNorm && norm->LayerType != LayerTypes::BatchNormActivation && norm->LayerType != LayerTypes::BatchNormRelu) || norm->Inputs.size() != 1)
+					continue;
+
+				for (auto j = 1ull; j < i; j++)
+				{
+					const auto& layer = Layers[j];
+					if (layer.get() == norm->Inputs[0] && (layer->LayerType == LayerTypes::Convolution || layer->LayerType == LayerTypes::DepthwiseConvolution || layer->LayerType == LayerTypes::Dense) && layer->Outputs.size() == 1 && layer->C == norm->C)
+						folds.push_back(std::make_pair(j, i));
+				}
+			}
+
+			return folds;
+		}
+
+		template<typename T>
+		static void GetNormAffine(const Layer* layer, FloatVector& scale, FloatVector& shift)
+		{
+			auto norm = dynamic_cast<const T*>(layer);
+			if (norm)
+			{
+				for (auto c = 0ull; c < norm->C; c++)
+				{
+					const auto invStdDev = Float(1) / std::sqrt(norm->RunningVariance[c] + norm->Eps);
+					scale[c] = norm->Scaling ? norm->Weights[c] * invStdDev : invStdDev;
+					shift[c] = (norm->Scaling && norm->HasBias ? norm->Biases[c] : Float(0)) - norm->RunningMean[c] * scale[c];
+				}
+			}
+		}
+
+		// Writes the weights of the model with the folds of GetFoldableNorms applied. A folded norm has no weights left
+		// and its weight layer always gets biases, everything else is saved as is, without optimizer state.
+		int SaveFoldedWeights(const std::string& fileName, const std::vector<std::pair<UInt, UInt>>& folds) const
+		{
+			auto os = std::ofstream(fileName, std::ios::out | std::ios::binary | std::ios::trunc);
+
+			if (!os.bad() && os.is_open())
+			{
+				auto foldedBy = std::vector<UInt>(Layers.size(), 0ull);
+				auto folded = std::vector<bool>(Layers.size(), false);
+				for (const auto& fold : folds)
+				{
+					foldedBy[fold.first] = fold.second;
+					folded[fold.second] = true;
+				}
+
+				for (auto i = 0ull; i < Layers.size(); i++)
+				{
+					const auto& layer = Layers[i];
+
+					if (folded[i])
+						continue;
+
+					if (foldedBy[i] == 0ull)
+					{
+						layer->Save(os, false, Optimizer);
+						continue;
+					}
+
+					auto scale = FloatVector(layer->C);
+					auto shift = FloatVector(layer->C);
+					const auto norm = Layers[foldedBy[i]].get();
+					switch (norm->LayerType)
+					{
+					case LayerTypes::BatchNorm:
+						GetNormAffine<BatchNorm>(norm, scale, shift);
+						break;
+					case LayerTypes::BatchNormActivation:
+						GetNormAffine<BatchNormActivation>(norm, scale, shift);
+						break;
+					case LayerTypes::BatchNormRelu:
+						GetNormAffine<BatchNormRelu>(norm, scale, shift);
+						break;
+					default:
+						break;
+					}
+
+					auto weights = FloatVector(layer->WeightCount);
+					auto memWeights = dnnl::memory(*layer->WeightsMemDesc, Device.engine, layer->Weights.data());
+					auto weightsMem = dnnl::memory(*layer->PersistWeightsMemDesc, Device.engine, weights.data());
+					dnnl::reorder(memWeights, weightsMem).execute(Device.stream, { {DNNL_ARG_FROM, memWeights}, {DNNL_ARG_TO, weightsMem} });
+					Device.stream.wait();
+
+					// the output channel is the outer dimension of the persisted weights of all three layer types
+					const auto size = layer->WeightCount / layer->C;
+					auto biases = FloatVector(layer->C);
+					for (auto c = 0ull; c < layer->C; c++)
+					{
+						for (auto w = c * size; w < (c + 1) * size; w++)
+							weights[w] *= scale[c];
+						biases[c] = (layer->HasBias ? layer->Biases[c] : Float(0)) * scale[c] + shift[c];
+					}
+
+					os.write(reinterpret_cast<const char*>(&layer->LockUpdate), sizeof(std::atomic<bool>));
+					os.write(reinterpret_cast<const char*>(weights.data()), std::streamsize(layer->WeightCount * sizeof(Float)));
+					os.write(reinterpret_cast<const char*>(biases.data()), std::streamsize(layer->C * sizeof(Float)));
+				}
+
+				os.close();
+
+				return os ? 0 : -1;
+			}
+
+			return -1;
+		}
+
 		int LoadLayerWeights(const std::string& fileName, const UInt layerIndex, const bool persistOptimizer = false)
 		{
 			if (GetFileSize(fileName) == Layers[layerIndex]->GetWeightsSize(persistOptimizer, Optimizer))
@@ -6,14 +6,13 @@ namespace dnn
 	class PRelu final : public Layer
 	{
 	private:
-		std::unique_ptr<dnnl::prelu_forward::primitive_desc> fwdDescPRelu;
-		std::unique_ptr<dnnl::prelu_backward::primitive_desc> bwdDescPRelu;
-		std::unique_ptr<dnnl::binary::primitive_desc> bwdAddDesc;
-#ifdef DNN_CACHE_PRIMITIVES
-		std::unique_ptr<dnnl::prelu_forward> fwdPRelu;
-		std::unique_ptr<dnnl::prelu_backward> bwdPRelu;
-		std::unique_ptr<dnnl::binary> bwdAdd;
-#endif
+		std::shared_ptr<dnnl::prelu_forward::primitive_desc> fwdDescPRelu;
+		std::shared_ptr<dnnl::prelu_backward::primitive_desc> bwdDescPRelu;
+		std::shared_ptr<dnnl::binary::primitive_desc> bwdAddDesc;
+		std::shared_ptr<dnnl::prelu_forward> fwdPRelu;
+		std::shared_ptr<dnnl::prelu_backward> bwdPRelu;
+		std::shared_ptr<dnnl::binary> bwdAdd;
+		PrimitiveCache<std::tuple<decltype(fwdDescPRelu), decltype(bwdDescPRelu), decltype(bwdAddDesc), decltype(fwdPRelu), decltype(bwdPRelu), decltype(bwdAdd)>> primitives;
 		bool reorderFwdSrc;
 		bool reorderBwdSrc;
 		bool reorderBwdDiffSrc;
@@ -81,15 +80,23 @@ namespace dnn
 				DiffDstMemDesc = std::make_unique<dnnl::memory::desc>(dnnl::memory::desc(dnnl::memory::dims({ dnnl::memory::dim(batchSize), dnnl::memory::dim(C), dnnl::memory::dim(H), dnnl::memory::dim(W) }), dnnl::memory::data_type::f32, ChosenFormat));
 			}
 
-			bwdAddDesc = std::make_unique<dnnl::binary::primitive_desc>(dnnl::binary::primitive_desc(Device.engine, dnnl::algorithm::binary_add, *InputLayer->DiffDstMemDesc, *InputLayer->DiffDstMemDesc, *InputLayer->DiffDstMemDesc));
-#ifdef DNN_CACHE_PRIMITIVES
-			bwdAdd = std::make_unique<dnnl::binary>(dnnl::binary(*bwdAddDesc));
-#endif
-			
-			auto memDesc = dnnl::memory::desc(dnnl::memory::dims({ 1, dnnl::memory::dim(C), 1, 1 }), dnnl::memory::data_type::f32, dnnl::memory::format_tag::any);
+			const auto key = PrimitiveKey{ batchSize, InputLayer->D, InputLayer->H, InputLayer->W, InputLayer->ChosenFormat, dnnl::prop_kind::forward };
+			if (const auto cached = primitives.Get(key))
+				std::tie(fwdDescPRelu, bwdDescPRelu, bwdAddDesc, fwdPRelu, bwdPRelu, bwdAdd) = *cached;
+			else
+			{
+				auto memDesc = dnnl::memory::desc(dnnl::memory::dims({ 1, dnnl::memory::dim(C), 1, 1 }), dnnl::memory::data_type::f32, dnnl::memory::format_tag::any);
+
+				fwdDescPRelu = std::make_unique<dnnl::prelu_forward::primitive_desc>(dnnl::prelu_forward::primitive_desc(Device.engine, dnnl::prop_kind::forward,*InputLayer->DstMemDesc, memDesc, *DstMemDesc));
+				bwdDescPRelu = std::make_unique<dnnl::prelu_backward::primitive_desc>(dnnl::prelu_backward::primitive_desc(Device.engine, *InputLayer->DstMemDesc, memDesc , *InputLayer->DiffDstMemDesc, memDesc, *DiffDstMemDesc, *fwdDescPRelu));
+				bwdAddDesc = std::make_unique<dnnl::binary::primitive_desc>(dnnl::binary::primitive_desc(Device.engine, dnnl::algorithm::binary_add, *InputLayer->DiffDstMemDesc, *InputLayer->DiffDstMemDesc, *InputLayer->DiffDstMemDesc));
+
+				fwdPRelu = std::make_shared<dnnl::prelu_forward>(dnnl::prelu_forward(*fwdDescPRelu));
+				bwdPRelu = std::make_shared<dnnl::prelu_backward>(dnnl::prelu_backward(*bwdDescPRelu));
+				bwdAdd = std::make_shared<dnnl::binary>(dnnl::binary(*bwdAddDesc));
 
-			fwdDescPRelu = std::make_unique<dnnl::prelu_forward::primitive_desc>(dnnl::prelu_forward::primitive_desc(Device.engine, dnnl::prop_kind::forward,*InputLayer->DstMemDesc, memDesc, *DstMemDesc));
-			bwdDescPRelu = std::make_unique<dnnl::prelu_backward::primitive_desc>(dnnl::prelu_backward::primitive_desc(Device.engine, *InputLayer->DstMemDesc, memDesc , *InputLayer->DiffDstMemDesc, memDesc, *DiffDstMemDesc, *fwdDescPRelu));
+				primitives.Put(key, std::make_shared<decltype(primitives)::value_type>(fwdDescPRelu, bwdDescPRelu, bwdAddDesc, fwdPRelu, bwdPRelu, bwdAdd), PrimitiveBytes(*fwdDescPRelu, *bwdDescPRelu, *bwdAddDesc));
+			}
 
 			if (*WeightsMemDesc != fwdDescPRelu->weights_desc())
 			{
@@ -115,11 +122,6 @@ namespace dnn
 			reorderBwdSrc = bwdDescPRelu->src_desc() != *InputLayer->DstMemDesc;
 			reorderBwdDiffSrc = bwdDescPRelu->diff_src_desc() != *InputLayerBwd->DiffDstMemDesc;
 			reorderBwdDiffWeights = bwdDescPRelu->diff_weights_desc() != fwdDescPRelu->weights_desc();
-
-#ifdef DNN_CACHE_PRIMITIVES
-			fwdPRelu = std::make_unique<dnnl::prelu_forward>(dnnl::prelu_forward(*fwdDescPRelu));
-			bwdPRelu = std::make_unique<dnnl::prelu_backward>(dnnl::prelu_backward(*bwdDescPRelu));
-#endif
 		}
 
 		ByteArray GetImage(const Byte fillColor) final override
@@ -176,11 +178,7 @@ namespace dnn
 			auto weightsMem = dnnl::memory(fwdDescPRelu->weights_desc(), Device.engine, Biases.data());
 
 			auto dstMem = dnnl::memory(*DstMemDesc, Device.engine, Neurons.data());
-#ifdef DNN_CACHE_PRIMITIVES
 			fwdPRelu->execute(Device.stream, std::unordered_map<int, dnnl::memory>{ {DNNL_ARG_SRC, srcMem}, { DNNL_ARG_WEIGHTS, weightsMem }, { DNNL_ARG_DST, dstMem } });
-#else
-			dnnl::prelu_forward(*fwdDescPRelu).execute(Device.stream, std::unordered_map<int, dnnl::memory>{ {DNNL_ARG_SRC, srcMem}, { DNNL_ARG_WEIGHTS, weightsMem }, { DNNL_ARG_DST, dstMem } });
-#endif
 			Device.stream.wait();
 
 #ifndef DNN_LEAN
@@ -213,11 +211,7 @@ namespace dnn
 			auto diffWeightsMem = reorderBwdDiffWeights ? dnnl::memory(bwdDescPRelu->diff_weights_desc(), Device.engine) : memDiffWeights;
 
 			auto weightsMem = dnnl::memory(bwdDescPRelu->weights_desc(), Device.engine, Biases.data());
-#ifdef DNN_CACHE_PRIMITIVES
 			bwdPRelu->execute(Device.stream, std::unordered_map<int, dnnl::memory>{ {DNNL_ARG_SRC, srcMem}, { DNNL_ARG_WEIGHTS, weightsMem }, { DNNL_ARG_DIFF_DST, diffDstMem }, { DNNL_ARG_DIFF_WEIGHTS, diffWeightsMem }, { DNNL_ARG_DIFF_SRC, diffSrcMem } });
-#else
-			dnnl::prelu_backward(*bwdDescPRelu).execute(Device.stream, std::unordered_map<int, dnnl::memory>{ {DNNL_ARG_SRC, srcMem}, { DNNL_ARG_WEIGHTS, weightsMem }, { DNNL_ARG_DIFF_DST, diffDstMem }, { DNNL_ARG_DIFF_WEIGHTS, diffWeightsMem }, { DNNL_ARG_DIFF_SRC, diffSrcMem } });
-#endif
 			Device.stream.wait();
 
 			if (reorderBwdDiffWeights)
@@ -234,11 +228,7 @@ namespace dnn
 
 			if (SharesInput)
 			{
-#ifdef DNN_CACHE_PRIMITIVES
 				bwdAdd->execute(Device.stream, std::unordered_map<int, dnnl::memory>{ { DNNL_ARG_SRC_0, dnnl::memory(*InputLayerBwd->DiffDstMemDesc, Device.engine, InputLayerBwd->NeuronsD1.data()) }, { DNNL_ARG_SRC_1, memDiffSrc }, { DNNL_ARG_DST, dnnl::memory(*InputLayerBwd->DiffDstMemDesc, Device.engine, InputLayerBwd->NeuronsD1.data()) } });
-#else
-				dnnl::binary(*bwdAddDesc).execute(Device.stream, std::unordered_map<int, dnnl::memory>{ { DNNL_ARG_SRC_0, dnnl::memory(*InputLayerBwd->DiffDstMemDesc, Device.engine, InputLayerBwd->NeuronsD1.data()) }, { DNNL_ARG_SRC_1, memDiffSrc }, { DNNL_ARG_DST, dnnl::memory(*InputLayerBwd->DiffDstMemDesc, Device.engine, InputLayerBwd->NeuronsD1.data()) } });
-#endif
 				Device.stream.wait();
 			}
 
@@ -528,6 +528,208 @@ namespace dnn
 				f(i);
 	}
 
+	// a fixed set of threads, each pinned to its own core, that runs parallel loops apart from the OpenMP pool
+	// so the input pipeline and the compute kernels do not compete for the same threads
+	class WorkerPool
+	{
+	public:
+		WorkerPool() = default;
+		WorkerPool(const WorkerPool&) = delete;
+		WorkerPool& operator=(const WorkerPool&) = delete;
+
+		~WorkerPool()
+		{
+			Stop();
+		}
+
+		size_t Threads() const
+		{
+			return Workers.size();
+		}
+
+		static constexpr size_t NoAffinity = std::numeric_limits<size_t>::max();
+
+		// starts threads workers on the cores firstCore .. firstCore + threads - 1, no threads stops the pool
+		// with NoAffinity the workers are left to the scheduler
+		bool Start(const size_t threads, const size_t firstCore = NoAffinity)
+		{
+			Stop();
+
+			if (threads == 0)
+				return true;
+
+			if (firstCore != NoAffinity && firstCore + threads > std::thread::hardware_concurrency())
+				return false;
+
+			Stopping = false;
+			for (auto i = 0ull; i < threads; i++)
+			{
+				Workers.emplace_back([this] { Work(); });
+
+				if (firstCore != NoAffinity && !Pin(Workers.back(), firstCore + i))
+				{
+					Stop();
+					return false;
+				}
+			}
+
+			return true;
+		}
+
+		void Stop()
+		{
+			{
+				std::lock_guard<std::mutex> lock(Lock);
+				Stopping = true;
+			}
+			Wake.notify_all();
+
+			for (auto& worker : Workers)
+				if (worker.joinable())
+					worker.join();
+
+			Workers.clear();
+		}
+
+		// blocks until f has run for every index in [0, range), the indexes are handed out one at a time
+		template <typename Func>
+		void for_i(const size_t range, const Func& f)
+		{
+			if (range == 0)
+				return;
+
+			if (Workers.empty())
+			{
+				for (auto i = 0ull; i < range; i++)
+					f(i);
+				return;
+			}
+
+			auto job = std::make_shared<Job>();
+			job->Func = [&f](const size_t i) { f(i); };
+			job->Range = range;
+			auto finished = job->Finished.get_future();
+
+			{
+				std::lock_guard<std::mutex> lock(Lock);
+				Jobs.push_back(job);
+			}
+			Wake.notify_all();
+
+			finished.get();
+		}
+
+		// queues f to run once on a worker and returns at once, the future reports when it's done
+		template <typename Func>
+		std::future<void> Post(Func f)
+		{
+			if (Workers.empty())
+			{
+				auto done = std::promise<void>();
+				try
+				{
+					f();
+					done.set_value();
+				}
+				catch (...)
+				{
+					done.set_exception(std::current_exception());
+				}
+				return done.get_future();
+			}
+
+			auto job = std::make_shared<Job>();
+			job->Func = [f = std::move(f)](const size_t) { f(); };
+			job->Range = 1;
+			auto finished = job->Finished.get_future();
+
+			{
+				std::lock_guard<std::mutex> lock(Lock);
+				Jobs.push_back(job);
+			}
+			Wake.notify_one();
+
+			return finished;
+		}
+
+	private:
+		struct Job
+		{
+			std::function<void(size_t)> Func;
+			size_t Range = 0;
+			std::atomic<size_t> Next{ 0 };
+			std::atomic<size_t> Done{ 0 };
+			std::exception_ptr Error = nullptr;
+			std::mutex ErrorLock;
+			std::promise<void> Finished;
+		};
+
+		std::vector<std::thread> Workers;
+		std::deque<std::shared_ptr<Job>> Jobs;
+		std::mutex Lock;
+		std::condition_variable Wake;
+		bool Stopping = false;
+
+		static bool Pin(std::thread& thread, const size_t core)
+		{
+#if defined(_WIN32) || defined(__CYGWIN__) || defined(__MINGW32__)
+			if (core >= 64)
+				return false;
+
+			return ::SetThreadAffinityMask(thread.native_handle(), DWORD_PTR(1) << core) != 0;
+#else
+			cpu_set_t set;
+			CPU_ZERO(&set);
+			CPU_SET(core, &set);
+
+			return ::pthread_setaffinity_np(thread.native_handle(), sizeof(cpu_set_t), &set) == 0;
+#endif
+		}
+
+		void Work()
+		{
+			while (true)
+			{
+				std::shared_ptr<Job> job;
+				{
+					std::unique_lock<std::mutex> lock(Lock);
+					Wake.wait(lock, [this] { return Stopping || !Jobs.empty(); });
+
+					if (Jobs.empty())
+						return;
+
+					job = Jobs.front();
+				}
+
+				for (auto i = job->Next.fetch_add(1); i < job->Range; i = job->Next.fetch_add(1))
+				{
+					try
+					{
+						job->Func(i);
+					}
+					catch (...)
+					{
+						std::lock_guard<std::mutex> lock(job->ErrorLock);
+						if (!job->Error)
+							job->Error = std::current_exception();
+					}
+
+					if (job->Done.fetch_add(1) + 1 == job->Range)
+					{
+						if (job->Error)
+							job->Finished.set_exception(job->Error);
+						else
+							job->Finished.set_value();
+					}
+				}
+
+				std::lock_guard<std::mutex> lock(Lock);
+				if (!Jobs.empty() && Jobs.front() == job)
+					Jobs.pop_front();
+			}
+		}
+	};
+
 	void fast_memzero(void *dest, size_t numbytes)
 	{
   		const auto PAGE_4K = 2 * 1024ll * 1024ll;
@@ -0,0 +1,173 @@
+#pragma once
+#include "Utils.h"
+
+namespace dnn
+{
+	// the shape a set of primitives was created for
+	struct PrimitiveKey
+	{
+		UInt N;
+		UInt D;
+		UInt H;
+		UInt W;
+		dnnl::memory::format_tag Format;
+		dnnl::prop_kind PropKind;
+
+		bool operator<(const PrimitiveKey& other) const
+		{
+			return std::tie(N, D, H, W, Format, PropKind) < std::tie(other.N, other.D, other.H, other.W, other.Format, other.PropKind);
+		}
+	};
+
+	// the budget evicts across the caches of all layers through this interface, always under PrimitiveBudget::Lock
+	class PrimitiveCacheBase
+	{
+	public:
+		virtual ~PrimitiveCacheBase() = default;
+
+		// last use of the least recently used entry other than keep, zero when there is none
+		virtual UInt Oldest(const UInt keep) const = 0;
+		virtual void EvictOldest(const UInt keep) = 0;
+	};
+
+	// bytes held by the primitive caches of all layers together, with one clock so they share a single LRU order
+	struct PrimitiveBudget
+	{
+		static inline std::atomic<UInt> Capacity{ PrimitiveCacheBudget };
+		static inline std::atomic<UInt> Used{ 0 };
+		static inline std::mutex Lock;
+		static inline UInt Clock = 0;
+		static inline std::set<PrimitiveCacheBase*> Caches;
+	};
+
+	// memory a primitive keeps next to its descriptor: the jitted code and the library managed scratchpad
+	template<typename... Descs>
+	static UInt PrimitiveBytes(const Descs&... descs)
+	{
+		return ((UInt(descs.query_s64(dnnl::query::memory_consumption_s64)) + UInt(descs.scratchpad_desc().get_size())) + ... + 0ull);
+	}
+
+	// Keeps the descriptors and primitives of a layer for every shape it has seen, so going back to an earlier
+	// batch size or resolution doesn't recreate them. When the shared budget is exceeded the least recently used
+	// shapes of all layers are dropped, never the one just stored.
+	template<typename T>
+	class PrimitiveCache final : public PrimitiveCacheBase
+	{
+	private:
+		struct Entry
+		{
+			std::shared_ptr<T> Value;
+			UInt Bytes;
+			UInt LastUse;
+		};
+
+		std::map<PrimitiveKey, Entry> Entries;
+
+		auto OldestEntry(const UInt keep) const
+		{
+			auto oldest = Entries.end();
+			for (auto it = Entries.begin(); it != Entries.end(); ++it)
+				if (it->second.LastUse != keep && (oldest == Entries.end() || it->second.LastUse < oldest->second.LastUse))
+					oldest = it;
+
+			return oldest;
+		}
+
+		UInt Oldest(const UInt keep) const override
+		{
+			const auto oldest = OldestEntry(keep);
+
+			return oldest != Entries.end() ? oldest->second.LastUse : 0ull;
+		}
+
+		void EvictOldest(const UInt keep) override
+		{
+			const auto oldest = OldestEntry(keep);
+			if (oldest != Entries.end())
+			{
+				PrimitiveBudget::Used -= oldest->second.Bytes;
+				Entries.erase(oldest);
+			}
+		}
+
+	public:
+		using value_type = T;
+
+		PrimitiveCache()
+		{
+			std::lock_guard<std::mutex> lock(PrimitiveBudget::Lock);
+			PrimitiveBudget::Caches.insert(this);
+		}
+
+		PrimitiveCache(const PrimitiveCache&) = delete;
+		PrimitiveCache& operator=(const PrimitiveCache&) = delete;
+
+		~PrimitiveCache()
+		{
+			Clear();
+
+			std::lock_guard<std::mutex> lock(PrimitiveBudget::Lock);
+			PrimitiveBudget::Caches.erase(this);
+		}
+
+		std::shared_ptr<T> Get(const PrimitiveKey& key)
+		{
+			std::lock_guard<std::mutex> lock(PrimitiveBudget::Lock);
+
+			const auto entry = Entries.find(key);
+			if (entry == Entries.end())
+				return nullptr;
+
+			entry->second.LastUse = ++PrimitiveBudget::Clock;
+
+			return entry->second.Value;
+		}
+
+		void Put(const PrimitiveKey& key, const std::shared_ptr<T>& value, const UInt bytes)
+		{
+			std::lock_guard<std::mutex> lock(PrimitiveBudget::Lock);
+
+			auto& entry = Entries[key];
+			PrimitiveBudget::Used -= entry.Bytes;
+			entry = Entry{ value, bytes, ++PrimitiveBudget::Clock };
+			PrimitiveBudget::Used += bytes;
+
+			const auto stored = PrimitiveBudget::Clock;
+			while (PrimitiveBudget::Used > PrimitiveBudget::Capacity)
+			{
+				PrimitiveCacheBase* victim = nullptr;
+				auto oldest = std::numeric_limits<UInt>::max();
+				for (const auto cache : PrimitiveBudget::Caches)
+				{
+					const auto lastUse = cache->Oldest(stored);
+					if (lastUse != 0ull && lastUse < oldest)
+					{
+						oldest = lastUse;
+						victim = cache;
+					}
+				}
+
+				if (!victim)
+					break;
+
+				victim->EvictOldest(stored);
+			}
+		}
+
+		void Clear()
+		{
+			std::lock_guard<std::mutex> lock(PrimitiveBudget::Lock);
+
+			for (const auto& entry : Entries)
+				PrimitiveBudget::Used -= entry.second.Bytes;
+			Entries.clear();
+		}
+
+		auto Size()
+		{
+			std::lock_guard<std::mutex> lock(PrimitiveBudget::Lock);
+
+			return Entries.size();
+		}
+	};
+}
@@ -6,12 +6,13 @@ namespace dnn
 	class Shuffle final : public Layer
 	{
 	private:
-		std::unique_ptr<dnnl::shuffle_forward::primitive_desc> fwdDesc;
-		std::unique_ptr<dnnl::shuffle_backward::primitive_desc> bwdDesc;
-#ifdef DNN_CACHE_PRIMITIVES
-		std::unique_ptr<dnnl::shuffle_forward> fwd;
-		std::unique_ptr<dnnl::shuffle_backward> bwd;
-#endif
+		std::shared_ptr<dnnl::shuffle_forward::primitive_desc> fwdDesc;
+		std::shared_ptr<dnnl::shuffle_backward::primitive_desc> bwdDesc;
+		std::shared_ptr<dnnl::shuffle_forward> fwd;
+		std::shared_ptr<dnnl::shuffle_backward> bwd;
+		PrimitiveCache<std::tuple<decltype(fwdDesc), decltype(bwdDesc), decltype(fwd), decltype(bwd)>> primitives;
+		ExecutionPlan fwdPlan;
+		ExecutionPlan bwdPlan;
 
 	public:
 	    const UInt Groups;
@@ -77,26 +78,60 @@ namespace dnn
 				DiffDstMemDesc = std::make_unique<dnnl::memory::desc>(dnnl::memory::desc(dnnl::memory::dims({ dnnl::memory::dim(batchSize), dnnl::memory::dim(C), dnnl::memory::dim(H), dnnl::memory::dim(W) }), dnnl::memory::data_type::f32, ChosenFormat));
 			}
 
-			fwdDesc = std::make_unique<dnnl::shuffle_forward::primitive_desc>(dnnl::shuffle_forward::primitive_desc(Device.engine, dnnl::prop_kind::forward_training, *InputLayer->DstMemDesc, *DstMemDesc, 1, int(GroupSize)));
-			bwdDesc = std::make_unique<dnnl::shuffle_backward::primitive_desc>(dnnl::shuffle_backward::primitive_desc(Device.engine, *InputLayer->DiffDstMemDesc, *DiffDstMemDesc, 1, int(GroupSize), *fwdDesc));
+			const auto key = PrimitiveKey{ batchSize, InputLayer->D, InputLayer->H, InputLayer->W, InputLayer->ChosenFormat, FwdPropKind() };
+			if (const auto cached = primitives.Get(key))
+				std::tie(fwdDesc, bwdDesc, fwd, bwd) = *cached;
+			else
+			{
+				fwdDesc = std::make_unique<dnnl::shuffle_forward::primitive_desc>(dnnl::shuffle_forward::primitive_desc(Device.engine, FwdPropKind(), *InputLayer->DstMemDesc, *DstMemDesc, 1, int(GroupSize)));
+				fwd = std::make_shared<dnnl::shuffle_forward>(dnnl::shuffle_forward(*fwdDesc));
 
-#ifdef DNN_CACHE_PRIMITIVES
-			fwd = std::make_unique<dnnl::shuffle_forward>(dnnl::shuffle_forward(*fwdDesc));
-			bwd = std::make_unique<dnnl::shuffle_backward>(dnnl::shuffle_backward(*bwdDesc));
-#endif
+				if (!Inference)
+				{
+					bwdDesc = std::make_unique<dnnl::shuffle_backward::primitive_desc>(dnnl::shuffle_backward::primitive_desc(Device.engine, *InputLayer->DiffDstMemDesc, *DiffDstMemDesc, 1, int(GroupSize), *fwdDesc));
+					bwd = std::make_shared<dnnl::shuffle_backward>(dnnl::shuffle_backward(*bwdDesc));
+				}
+				else
+				{
+					bwdDesc.reset();
+					bwd.reset();
+				}
+
+				primitives.Put(key, std::make_shared<decltype(primitives)::value_type>(fwdDesc, bwdDesc, fwd, bwd), Inference ? PrimitiveBytes(*fwdDesc) : PrimitiveBytes(*fwdDesc, *bwdDesc));
+			}
+
+			fwdPlan.Reset();
+			bwdPlan.Reset();
+
+			BuildForwardPlan();
+			if (!Inference)
+				BuildBackwardPlan();
 		}
 
-		void ForwardProp(const UInt batchSize, const bool training) final override
+		UInt PlanScratchSize(const bool backward) const final override
+		{
+			return backward ? bwdPlan.ScratchSize() : fwdPlan.ScratchSize();
+		}
+
+		void BuildForwardPlan()
 		{
-			auto srcMem = dnnl::memory(*InputLayer->DstMemDesc, Device.engine, InputLayer->Neurons.data());
-			auto dstMem = dnnl::memory(*DstMemDesc, Device.engine, Neurons.data());
+			const auto srcMem = fwdPlan.Bind(*InputLayer->DstMemDesc, Device.engine, [this] { return InputLayer->Neurons.data(); });
+			const auto dstMem = fwdPlan.Bind(*DstMemDesc, Device.engine, [this] { return Neurons.data(); });
 
-#ifdef DNN_CACHE_PRIMITIVES
-			fwd->execute(Device.stream, std::unordered_map<int, dnnl::memory>{ {DNNL_ARG_SRC, srcMem}, { DNNL_ARG_DST, dstMem } });
-#else
-			dnnl::shuffle_forward(*fwdDesc).execute(Device.stream, std::unordered_map<int, dnnl::memory>{ {DNNL_ARG_SRC, srcMem}, { DNNL_ARG_DST, dstMem } });
-#endif
-			Device.stream.wait();
+			fwdPlan.Add(*fwd, { { DNNL_ARG_SRC, srcMem }, { DNNL_ARG_DST, dstMem } });
+		}
+
+		void BuildBackwardPlan()
+		{
+			const auto diffDstMem = bwdPlan.Bind(*DiffDstMemDesc, Device.engine, [this] { return NeuronsD1.data(); });
+			const auto diffSrcMem = bwdPlan.Bind(*InputLayerBwd->DiffDstMemDesc, Device.engine, [this] { return InputLayerBwd->NeuronsD1.data(); });
+
+			bwdPlan.Add(*bwd, { { DNNL_ARG_DIFF_DST, diffDstMem }, { DNNL_ARG_DIFF_SRC, diffSrcMem } });
+		}
+
+		void ForwardProp(const UInt batchSize, const bool training) final override
+		{
+			fwdPlan.Run(Device.stream, FwdScratch);
 
 #ifndef DNN_LEAN
 			if (training)
@@ -114,15 +149,7 @@ namespace dnn
 			DNN_UNREF_PAR(batchSize);
 #endif // DNN_LEAN
 
-			auto diffDstMem = dnnl::memory(*DiffDstMemDesc, Device.engine, NeuronsD1.data());
-			auto diffSrcMem = dnnl::memory(*InputLayerBwd->DiffDstMemDesc, Device.engine, InputLayerBwd->NeuronsD1.data());
-
-#ifdef DNN_CACHE_PRIMITIVES
-			bwd->execute(Device.stream, std::unordered_map<int, dnnl::memory>{ {DNNL_ARG_DIFF_DST, diffDstMem}, { DNNL_ARG_DIFF_SRC, diffSrcMem } });
-#else
-			dnnl::shuffle_backward(*bwdDesc).execute(Device.stream, std::unordered_map<int, dnnl::memory>{ {DNNL_ARG_DIFF_DST, diffDstMem}, { DNNL_ARG_DIFF_SRC, diffSrcMem } });
-#endif
-			Device.stream.wait();
+			bwdPlan.Run(Device.stream, BwdScratch);
 
 #ifdef DNN_LEAN
 			ReleaseGradient();
@@ -3,7 +3,13 @@
 #if defined(_WIN32) || defined(__CYGWIN__) || defined(__MINGW32__)
 #include "stdafx.h"
 #else
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/sysinfo.h>
+#include <unistd.h>
 #endif
 
 #ifdef NDEBUG
@@ -58,7 +64,9 @@
 //#include <bit>
 #include <cfenv>
 #include <cmath>
+#include <condition_variable>
 #include <cstring>
+#include <deque>
 #include <exception>
 #include <execution>
 #include <filesystem>
@@ -80,6 +88,7 @@
 #include <stdexcept>
 #include <string>
 #include <thread>
+#include <tuple>
 #include <unordered_map>
 #include <vector>
 #include <utility>
@@ -120,10 +129,13 @@
 
 namespace dnn
 {
+	constexpr auto CacheTestInputs = false;		// replay the deterministic test inputs across epochs
 	constexpr auto DefaultDatasetMeanStdDev = false;
 	constexpr auto Inplace = true;
 	constexpr auto Kahan = true;
-	constexpr auto PlainOptimizerWeights = true;
+	constexpr auto PackedDatasets = false;		// keep a memory-mapped packed copy of every loaded dataset
+	constexpr auto PlainOptimizerWeights = false;	// reorder the weights and optimizer states to plain format around every update
+	constexpr auto PrimitiveCacheBudget = 1073741824ull;	// bytes of primitives the layers keep around for shapes they may revisit
 	constexpr auto SingleMeanVariancePass = true;
 
 	constexpr auto TestActivations = false;
@@ -182,20 +194,59 @@ namespace dnn
 	typedef Vec16fb VecFloatBool;
 	constexpr auto VectorSize = 16ull;
 	constexpr auto BlockedFmt = dnnl::memory::format_tag::nChw16c;
+	typedef Vec64uc VecByte;
+	constexpr auto VectorByteSize = 64ull;
 #elif defined(DNN_AVX2) || defined(DNN_AVX)
 	typedef Vec8f VecFloat;
 	typedef Vec8fb VecFloatBool;
 	constexpr auto VectorSize = 8ull;
 	constexpr auto BlockedFmt = dnnl::memory::format_tag::nChw8c;
+	typedef Vec32uc VecByte;
+	constexpr auto VectorByteSize = 32ull;
 #elif defined(DNN_SSE42) || defined(DNN_SSE41)
 	typedef Vec4f VecFloat;
 	typedef Vec4fb VecFloatBool;
 	constexpr auto VectorSize = 4ull;
 	constexpr auto BlockedFmt = dnnl::memory::format_tag::nChw4c;
+	typedef Vec16uc VecByte;
+	constexpr auto VectorByteSize = 16ull;
 #endif
 	const auto VecZero = VecFloat(Float(0));
 
-	
+	// widens VectorSize consecutive bytes to floats
+	static DNN_INLINE VecFloat LoadByteVecFloat(const Byte* data) NOEXCEPT
+	{
+		Vec16uc bytes;
+#if defined(DNN_AVX512BW) || defined(DNN_AVX512)
+		bytes.load(data);
+		return to_float(Vec16i(extend(extend(bytes))));
+#elif defined(DNN_AVX2) || defined(DNN_AVX)
+		bytes.load_partial(8, data);
+		return to_float(Vec8i(extend_low(extend(bytes))));
+#elif defined(DNN_SSE42) || defined(DNN_SSE41)
+		bytes.load_partial(4, data);
+		return to_float(Vec4i(extend_low(extend_low(bytes))));
+#endif
+	}
+
+	// truncates and saturates VectorSize floats to consecutive bytes
+	static DNN_INLINE void StoreVecFloatByte(Byte* data, const VecFloat& value) NOEXCEPT
+	{
+		const auto clamped = max(min(value, VecFloat(Float(255))), VecZero);
+#if defined(DNN_AVX512BW) || defined(DNN_AVX512)
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(data), _mm512_cvtepi32_epi8(_mm512_cvttps_epi32(clamped)));
+#elif defined(DNN_AVX2) || defined(DNN_AVX)
+		const __m256i integers = _mm256_cvttps_epi32(clamped);
+		const __m128i words = _mm_packs_epi32(_mm256_castsi256_si128(integers), _mm256_extractf128_si256(integers, 1));
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(data), _mm_packus_epi16(words, words));
+#elif defined(DNN_SSE42) || defined(DNN_SSE41)
+		const __m128i words = _mm_packs_epi32(_mm_cvttps_epi32(clamped), _mm_cvttps_epi32(clamped));
+		const auto bytes = _mm_cvtsi128_si32(_mm_packus_epi16(words, words));
+		std::memcpy(data, &bytes, 4);
+#endif
+	}
+
+
 	/*
 	static inline int div_up(int value, int divisor) {	return (value + divisor - 1) / divisor;	}
 	// Round value down to a multiple of factor.
@@ -539,6 +590,110 @@ namespace dnn
 	}
 #endif
 
+	// Counter-based Philox4x32-10 generator: the stream is fully determined by (seed, epoch, sample, op), independent of threads and draw order of other streams
+	class Philox final
+	{
+	public:
+		typedef std::uint32_t result_type;
+
+	private:
+		std::array<std::uint32_t, 4> Counter;
+		std::array<std::uint32_t, 2> Key;
+		std::array<std::uint32_t, 4> Block;
+		UInt Position;
+
+		void Generate() noexcept
+		{
+			Block = Rounds(Counter, Key);
+			Position = 0ull;
+			Counter[0]++;
+		}
+
+	public:
+		static constexpr std::array<std::uint32_t, 4> Rounds(std::array<std::uint32_t, 4> ctr, std::array<std::uint32_t, 2> key) noexcept
+		{
+			for (auto round = 0; round < 10; round++)
+			{
+				const auto p0 = std::uint64_t(0xD2511F53u) * ctr[0];
+				const auto p1 = std::uint64_t(0xCD9E8D57u) * ctr[2];
+				ctr = { std::uint32_t(p1 >> 32) ^ ctr[1] ^ key[0], std::uint32_t(p1), std::uint32_t(p0 >> 32) ^ ctr[3] ^ key[1], std::uint32_t(p0) };
+				key[0] += 0x9E3779B9u;
+				key[1] += 0xBB67AE85u;
+			}
+
+			return ctr;
+		}
+
+		static constexpr bool KnownAnswer(const std::array<std::uint32_t, 4> ctr, const std::array<std::uint32_t, 2> key, const std::array<std::uint32_t, 4> expected) noexcept
+		{
+			const auto block = Rounds(ctr, key);
+			for (auto i = 0ull; i < 4ull; i++)
+				if (block[i] != expected[i])
+					return false;
+
+			return true;
+		}
+
+		Philox(const UInt seed, const UInt epoch = 0ull, const UInt sample = 0ull, const UInt op = 0ull) noexcept :
+			Counter({ 0u, std::uint32_t(op), std::uint32_t(sample), std::uint32_t(epoch) }),
+			Key({ std::uint32_t(seed), std::uint32_t(std::uint64_t(seed) >> 32) }),
+			Block({ 0u, 0u, 0u, 0u }),
+			Position(4ull)
+		{
+		}
+
+		static constexpr result_type min() noexcept
+		{
+			return 0u;
+		}
+
+		static constexpr result_type max() noexcept
+		{
+			return std::numeric_limits<result_type>::max();
+		}
+
+		result_type operator()() noexcept
+		{
+			if (Position == 4ull)
+				Generate();
+
+			return Block[Position++];
+		}
+
+		// [0,1)
+		Float Uniform() noexcept
+		{
+			return Float((*this)() >> 8) * Float(1.0 / 16777216.0);
+		}
+	};
+
+	// Random123 known-answer vectors for philox4x32-10
+	static_assert(Philox::KnownAnswer({ 0x00000000u, 0x00000000u, 0x00000000u, 0x00000000u }, { 0x00000000u, 0x00000000u }, { 0x6627e8d5u, 0xe169c58du, 0xbc57ac4cu, 0x9b00dbd8u }), "Philox4x32-10 known-answer test failed");
+	static_assert(Philox::KnownAnswer({ 0xffffffffu, 0xffffffffu, 0xffffffffu, 0xffffffffu }, { 0xffffffffu, 0xffffffffu }, { 0x408f276du, 0x41c83b0eu, 0xa20bc7c6u, 0x6d5451fdu }), "Philox4x32-10 known-answer test failed");
+	static_assert(Philox::KnownAnswer({ 0x243f6a88u, 0x85a308d3u, 0x13198a2eu, 0x03707344u }, { 0xa4093822u, 0x299f31d0u }, { 0xd16cfe09u, 0x94fdccebu, 0x5001e420u, 0x24126ea1u }), "Philox4x32-10 known-answer test failed");
+
+	// when set, the random helpers below draw from this counter-based stream instead of their thread_local generators
+	inline thread_local Philox* AugmentationStream = nullptr;
+
+	struct AugmentationScope
+	{
+		Philox* Previous;
+
+		AugmentationScope(Philox& stream) noexcept :
+			Previous(AugmentationStream)
+		{
+			AugmentationStream = &stream;
+		}
+
+		~AugmentationScope()
+		{
+			AugmentationStream = Previous;
+		}
+
+		AugmentationScope(const AugmentationScope&) = delete;
+		AugmentationScope& operator=(const AugmentationScope&) = delete;
+	};
+
 	static auto BernoulliVecFloat(const Float p = Float(0.5)) NOEXCEPT
 	{
 #ifndef NDEBUG
@@ -581,6 +736,9 @@ namespace dnn
 		if (p < 0 || p > 1)
 			throw std::invalid_argument("Parameter out of range in Bernoulli function");
 #endif
+		if (AugmentationStream)
+			return static_cast<T>(AugmentationStream->Uniform() < p);
+
 		static thread_local auto generator = std::mt19937(Seed<unsigned>());
 		return static_cast<T>(std::bernoulli_distribution(static_cast<double>(p))(generator));
 	}
@@ -593,6 +751,18 @@ namespace dnn
 		if (min > max)
 			throw std::invalid_argument("Parameter out of range in UniformInt function");
 #endif
+		if (AugmentationStream)
+		{
+			const auto range = std::uint64_t(max) - std::uint64_t(min);
+			if (range <= 0xFFFFFFFFull)
+				return static_cast<T>(min + static_cast<T>((std::uint64_t((*AugmentationStream)()) * (range + 1ull)) >> 32));
+
+			// wider ranges take two draws
+			const auto hi = std::uint64_t((*AugmentationStream)());
+			const auto draw = (hi << 32) | std::uint64_t((*AugmentationStream)());
+			return static_cast<T>(std::uint64_t(min) + (range == std::numeric_limits<std::uint64_t>::max() ? draw : draw % (range + 1ull)));
+		}
+
 		static thread_local auto generator = std::mt19937(Seed<unsigned>());
 		return std::uniform_int_distribution<T>(min, max)(generator);
 	}
@@ -605,6 +775,9 @@ namespace dnn
 		if (min > max)
 			throw std::invalid_argument("Parameter out of range in UniformReal function");
 #endif
+		if (AugmentationStream)
+			return min + (max - min) * static_cast<T>(AugmentationStream->Uniform());
+
 		static thread_local auto generator = std::mt19937(Seed<unsigned>());
 		return std::uniform_real_distribution<T>(min, max)(generator);
 	}
@@ -833,6 +1006,15 @@ namespace dnn
 				}
 			}
 		}
+		// points at a slice of memory owned by someone else
+		void view(T* ptr, const dnnl::memory::desc& md) NOEXCEPT
+		{
+			AlignedMemory::release();
+
+			dataPtr = ptr;
+			nelems = md.get_size() / sizeof(T);
+			description = md;
+		}
 		inline auto memory() noexcept { return arrPtr.get(); }
 		inline auto data() noexcept { return dataPtr; }
 		inline auto data() const noexcept { return dataPtr; }
@@ -894,6 +1076,13 @@ namespace dnn
 		{
 			AlignedMemory::resizeMem(dnnl::memory::desc(dnnl::memory::dims({ dnnl::memory::dim(n), dnnl::memory::dim(c), dnnl::memory::dim(d), dnnl::memory::dim(h), dnnl::memory::dim(w) }), dtype, format), engine, value);
 		}
+		void swap(AlignedMemory& other) noexcept
+		{
+			std::swap(arrPtr, other.arrPtr);
+			std::swap(dataPtr, other.dataPtr);
+			std::swap(nelems, other.nelems);
+			std::swap(description, other.description);
+		}
 		inline T& operator[] (size_type i) NOEXCEPT { return dataPtr[i]; }
 		inline const T& operator[] (size_type i) const NOEXCEPT { return dataPtr[i]; }
 		inline auto empty() const noexcept { return nelems == 0; }
@@ -997,6 +1186,9 @@ namespace dnn
 	auto BetaDistribution(const T a, const T b) NOEXCEPT
 	{
 		static_assert(std::is_floating_point<T>::value, "Only Floating point type supported in BetaDistribution function");
+		if (AugmentationStream)
+			return dnn::beta_distribution<T>(a, b)(*AugmentationStream);
+
 		static thread_local auto generator = std::mt19937(Seed<unsigned>());
 
 		return dnn::beta_distribution<T>(a, b)(generator);
@@ -136,6 +136,41 @@ extern "C" DNN_API bool DNNSetShuffleCount(const UInt count)
 	return false;
 }
 
+// threads workers pinned to the cores firstCore .. firstCore + threads - 1 assemble the batches, zero threads hands it back to the OpenMP pool
+// refused while a task runs, the pool is joined and restarted
+extern "C" DNN_API bool DNNSetInputWorkers(const UInt threads, const UInt firstCore)
+{
+	if (dataprovider && (!model || model->TaskState.load() == TaskStates::Stopped))
+		return dataprovider->InputWorkers.Start(threads, firstCore);
+
+	return false;
+}
+
+extern "C" DNN_API bool DNNSetInputQueueDepth(const UInt depth)
+{
+	if (dataprovider && (!model || model->TaskState.load() == TaskStates::Stopped))
+	{
+		if (depth > 0ull)
+		{
+			dataprovider->InputQueueDepth = depth;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+extern "C" DNN_API bool DNNSetDecodedCacheSize(const UInt size)
+{
+	if (dataprovider)
+	{
+		dataprovider->DecodedCacheSize = size;
+		return true;
+	}
+
+	return false;
+}
+
 extern "C" DNN_API void DNNDataproviderDispose()
 {
 	if (dataprovider)
@@ -275,6 +310,67 @@ extern "C" DNN_API bool DNNSetFormat(const bool plain)
 	return false;
 }
 
+extern "C" DNN_API bool DNNSetInference(const bool inference)
+{
+	if (model)
+		return model->SetInference(inference);
+
+	return false;
+}
+
+// refused while a task runs
+extern "C" DNN_API bool DNNSetConcurrentBranches(const bool concurrent)
+{
+	if (model)
+		return model->SetConcurrentBranches(concurrent);
+
+	return false;
+}
+
+// refused while a task runs or in inference mode
+extern "C" DNN_API bool DNNCheckMemoryPlan(const UInt batchSize)
+{
+	if (model)
+		return model->CheckMemoryPlan(batchSize);
+
+	return false;
+}
+
+// refused while a task runs or while the gradients are clipped
+extern "C" DNN_API bool DNNSetOverlapUpdates(const bool overlap)
+{
+	if (model)
+		return model->SetOverlapUpdates(overlap);
+
+	return false;
+}
+
+// refused while a task runs or while the gradients are clipped
+extern "C" DNN_API bool DNNSetFlatParameters(const bool flat)
+{
+	if (model)
+		return model->SetFlatParameters(flat);
+
+	return false;
+}
+
+// needs the flat parameters without overlapped updates, 0 turns clipping off
+extern "C" DNN_API bool DNNSetGradientClipping(const Float maxNorm)
+{
+	if (model)
+		return model->SetGradientClipping(maxNorm);
+
+	return false;
+}
+
+extern "C" DNN_API bool DNNSetTestBatchSize(const UInt batchSize)
+{
+	if (model)
+		return model->SetTestBatchSize(batchSize);
+
+	return false;
+}
+
 extern "C" DNN_API void DNNGetConfusionMatrix(const UInt costLayerIndex, UInt* confusionMatrix)
 {
 	if (model && costLayerIndex < model->CostLayers.size())
@@ -326,6 +422,12 @@ extern "C" DNN_API void DNNDisableLocking(const bool disable)
 		model->DisableLocking = disable;
 }
 
+extern "C" DNN_API void DNNSetAugmentationSeed(const UInt seed)
+{
+	if (model)
+		model->AugmentationSeed = seed;
+}
+
 extern "C" DNN_API void DNNResetWeights()
 {
 	if (model)
@@ -1015,6 +1117,14 @@ extern "C" DNN_API int DNNSaveWeights(const char* fileName, const bool persistOp
 	return -10;
 }
 
+extern "C" DNN_API bool DNNFoldBatchNorm(const char* definitionFile, const char* weightsFile, CheckMsg& checkMsg)
+{
+	if (model)
+		return FoldBatchNorm(*model, std::string(definitionFile), std::string(weightsFile), checkMsg);
+
+	return false;
+}
+
 extern "C" DNN_API int DNNLoadLayerWeights(const char* fileName, const UInt layerIndex, const bool persistOptimizer)
 {
 	if (model)
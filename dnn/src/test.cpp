@@ -59,6 +59,7 @@ DNN_API int DNNRead(const char* definition, dnn::CheckMsg& checkMsg);
 DNN_API void DNNDataprovider(const char* directory);
 DNN_API int DNNLoadWeights(const char* fileName, const bool persistOptimizer);
 DNN_API int DNNSaveWeights(const char* fileName, const bool persistOptimizer);
+DNN_API bool DNNFoldBatchNorm(const char* definitionFile, const char* weightsFile, dnn::CheckMsg& checkMsg);
 DNN_API int DNNLoadLayerWeights(const char* fileName, const UInt layerIndex, const bool persistOptimizer);
 DNN_API int DNNSaveLayerWeights(const char* fileName, const UInt layerIndex, const bool persistOptimizer);
 DNN_API void DNNGetLayerWeights(const UInt layerIndex, Float* weights, Float* biases);
@@ -66,6 +67,13 @@ DNN_API void DNNSetCostIndex(const UInt index);
 DNN_API void DNNGetCostInfo(const UInt costIndex, dnn::CostInfo* info);
 DNN_API void DNNGetImage(const UInt layer, const Byte fillColor, Byte* image);
 DNN_API bool DNNSetFormat(const bool plain);
+DNN_API bool DNNSetInference(const bool inference);
+DNN_API bool DNNSetConcurrentBranches(const bool concurrent);
+DNN_API bool DNNCheckMemoryPlan(const UInt batchSize);
+DNN_API bool DNNSetOverlapUpdates(const bool overlap);
+DNN_API bool DNNSetFlatParameters(const bool flat);
+DNN_API bool DNNSetGradientClipping(const Float maxNorm);
+DNN_API bool DNNSetTestBatchSize(const UInt batchSize);
 DNN_API dnn::Optimizers GetOptimizer();
 DNN_API bool DNNClearLog();
 //DNN_API void DNNPrintModel(const char* fileName);
@@ -177,6 +185,87 @@ void GetTrainingProgress(int seconds = 5, UInt trainingSamples = 50000, UInt tes
     delete info;
 }
 
+// Tests the model in inference mode, folds its batch norms into the layers in front of them and tests the folded model:
+// both should make the same errors and, up to rounding, have the same loss
+bool CheckFoldedInference(const dnn::TrainingRate& rate, const UInt trainSamples, const UInt testSamples)
+{
+    const auto test = [&](dnn::TestingInfo& info)
+    {
+        DNNAddTrainingRate(rate, true, 1, trainSamples);
+        DNNTesting();
+        do
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(250));
+            DNNGetTestingInfo(&info);
+        }
+        while (info.State != States::Completed);
+        DNNStop();
+    };
+
+    if (!DNNSetInference(true))
+        return false;
+
+    auto unfolded = dnn::TestingInfo();
+    test(unfolded);
+
+    const auto definitionFile = path + std::string("folded.txt");
+    const auto weightsFile = path + std::string("folded.bin");
+    CheckMsg msg;
+    if (!DNNFoldBatchNorm(definitionFile.c_str(), weightsFile.c_str(), msg) || DNNLoad(definitionFile.c_str(), msg) != 1)
+    {
+        std::cout << std::string("Could not fold the model: ") << msg.Message << std::endl;
+        return false;
+    }
+
+    DNNResetWeights();
+    if (DNNLoadWeights(weightsFile.c_str(), false) != 0 || !DNNSetInference(true))
+        return false;
+
+    auto folded = dnn::TestingInfo();
+    test(folded);
+
+    const auto errors = folded.TestErrors > unfolded.TestErrors ? folded.TestErrors - unfolded.TestErrors : unfolded.TestErrors - folded.TestErrors;
+    const auto same = errors <= testSamples / 1000ull && std::abs(folded.AvgTestLoss - unfolded.AvgTestLoss) <= Float(0.001) * std::max(Float(1), std::abs(unfolded.AvgTestLoss));
+    
+    std::cout << std::string("Folded inference: ") << std::to_string(folded.TestErrors) << std::string(" errors, loss ") << FloatToStringFixed(folded.AvgTestLoss, 5) << std::string("  unfolded: ") << std::to_string(unfolded.TestErrors) << std::string(" errors, loss ") << FloatToStringFixed(unfolded.AvgTestLoss, 5) << (same ? std::string("  ok") : std::string("  MISMATCH")) << std::endl;
+
+    return same;
+}
+
+
+// Trains a batch of the branching scripts with and without the memory plan, the gradients should be bit-identical.
+// mobilenetv3 splits its depthwise convolutions Inception style and concatenates the branches.
+bool CheckMemoryPlans(const scripts::ScriptParameters& parameters)
+{
+    auto same = true;
+
+    for (const auto script : { scripts::Scripts::densenet, scripts::Scripts::shufflenetv2, scripts::Scripts::mobilenetv3 })
+    {
+        auto p = parameters;
+        p.Script = script;
+        p.Groups = 2;
+        p.Iterations = 2;
+        p.Dropout = Float(0);
+
+        CheckMsg msg;
+        if (DNNRead(scripts::ScriptsCatalog::Generate(p).c_str(), msg) != 1)
+        {
+            std::cout << std::string("Could not read ") << p.GetName() << std::string(": ") << msg.Message << std::endl;
+            return false;
+        }
+        DNNResetWeights();
+
+        for (const auto concurrent : { false, true })
+        {
+            const auto planned = DNNSetConcurrentBranches(concurrent) && DNNCheckMemoryPlan(32ull);
+            std::cout << std::string("Memory plan ") << p.GetName() << (concurrent ? std::string(" concurrent") : std::string(" sequential")) << (planned ? std::string("  ok") : std::string("  MISMATCH")) << std::endl;
+            same = same && planned;
+        }
+    }
+
+    return same;
+}
+
 
 #ifdef _WIN32
 int __cdecl wmain(int argc, wchar_t* argv[])
@@ -366,11 +455,20 @@ int main(int argc, char* argv[])
             DNNAddTrainingRateSGDR(rate, true, gotoEpoch, gotoCycle, info->TrainSamplesCount);
             DNNTraining();
             GetTrainingProgress(5, info->TrainSamplesCount, info->TestSamplesCount);
+            DNNStop();
+
+            const auto folded = CheckFoldedInference(rate, info->TrainSamplesCount, info->TestSamplesCount);
+            const auto planned = CheckMemoryPlans(p);
             
             delete info;
                    
-            DNNStop();
             DNNModelDispose();
+
+            if (!folded || !planned)
+            {
+                DNNDataproviderDispose();
+                return EXIT_FAILURE;
+            }
         }
         else
             std::cout << std::endl << std::string("Could not load dataset") << std::endl;